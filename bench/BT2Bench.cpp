@@ -0,0 +1,108 @@
+#include "BT2Bench.h"
+
+volatile uint32_t benchSink = 0;
+int benchFailures = 0;
+RENOGY_COMMANDS benchPendingReads[MAXIMUM_BT2_DEVICES];
+
+static BenchReader * benchCaptureReader = NULL;
+
+
+void benchCheck(boolean condition, const char * what) {
+	if (condition) { return; }
+	printf("CHECK FAILED: %s\n", what);
+	benchFailures++;
+}
+
+void benchReport(const char * name, double nsPerOp, const char * note) {
+	if (nsPerOp > 0) {
+		printf("%-68s %10.1f ns/op  %s\n", name, nsPerOp, note);
+	} else {
+		printf("%-68s %16s  %s\n", name, "", note);
+	}
+}
+
+uint16_t benchReferenceChecksum(const uint8_t * data, int len) {
+	uint16_t crc = 0xFFFF;
+	for (int i = 0; i < len; i++) {
+		crc ^= data[i];
+		for (int bit = 0; bit < 8; bit++) { crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1; }
+	}
+	return crc;
+}
+
+int benchBuildResponse(uint8_t * frame, uint16_t startRegister, uint16_t numberOfRegisters, uint16_t seed) {
+	frame[0] = 0xFF;
+	frame[1] = 0x03;
+	frame[2] = numberOfRegisters * 2;
+	for (int i = 0; i < numberOfRegisters; i++) {
+		uint16_t value = (uint16_t)((startRegister + i) * 31 + seed);
+		frame[3 + i * 2] = (value >> 8) & 0xFF;
+		frame[4 + i * 2] = value & 0xFF;
+	}
+	int length = 3 + numberOfRegisters * 2;
+	uint16_t checksum = benchReferenceChecksum(frame, length);
+	frame[length++] = checksum & 0xFF;
+	frame[length++] = (checksum >> 8) & 0xFF;
+	return length;
+}
+
+void benchConnectDevices(BenchReader & reader, int numberOfDevices) {
+	reader.setDeviceTableSize(numberOfDevices);
+	for (int i = 0; i < numberOfDevices; i++) {
+		uint8_t peerAddress[6] = { 0x10, 0x20, 0x30, 0x40, 0x50, (uint8_t)(0x60 + i) };
+		reader.addTargetBT2Device(peerAddress);
+	}
+	reader.begin();
+	for (int i = 0; i < numberOfDevices; i++) {
+		char peerName[24];
+		snprintf(peerName, sizeof(peerName), "BT-TH-BENCH%03d", i);
+		Bluefruit.nativeConnect(BENCH_CONNECTION_HANDLE + i, reader.deviceTable[i].peerAddress, peerName);
+		reader.connectCallback(BENCH_CONNECTION_HANDLE + i);
+	}
+}
+
+void benchNotifyFrame(BenchReader & reader, int deviceIndex, const uint8_t * frame, int frameLength) {
+	uint8_t packet[20];
+	for (int offset = 0; offset < frameLength; offset += 20) {
+		int len = min(20, frameLength - offset);
+		memcpy(packet, &frame[offset], len);
+		reader.notifyCallback(&reader.deviceTable[deviceIndex].rxCharacteristic, packet, len);
+	}
+}
+
+static void benchCaptureReadCommand(BLEClientCharacteristic * chr, const uint8_t * data, uint16_t len) {
+	if (len != 8 || data[1] != 0x03) { return; }
+	if (chr->valueHandle() != 0xD1 + Bluefruit.nativeHandleOffset) { return; }	// stale cached handles go nowhere
+	for (int i = 0; i < benchCaptureReader->deviceTableSize; i++) {
+		if (chr != &benchCaptureReader->deviceTable[i].txCharacteristic) { continue; }
+		benchPendingReads[i].startRegister = data[2] * 256 + data[3];
+		benchPendingReads[i].numberOfRegisters = data[4] * 256 + data[5];
+	}
+}
+
+void benchCaptureReads(BenchReader & reader) {
+	benchCaptureReader = &reader;
+	memset(benchPendingReads, 0, sizeof(benchPendingReads));
+	BLEClientCharacteristic::nativeWriteHook = benchCaptureReadCommand;
+}
+
+void benchReconnect(BenchReader & reader, int deviceIndex) {
+	reader.disconnectCallback(BENCH_CONNECTION_HANDLE + deviceIndex, 0x13);
+	reader.service();
+	benchPendingReads[deviceIndex].numberOfRegisters = 0;
+	char peerName[24];
+	snprintf(peerName, sizeof(peerName), "BT-TH-BENCH%03d", deviceIndex);
+	Bluefruit.nativeConnect(BENCH_CONNECTION_HANDLE + deviceIndex, reader.deviceTable[deviceIndex].peerAddress, peerName);
+	reader.connectCallback(BENCH_CONNECTION_HANDLE + deviceIndex);
+}
+
+void benchFillDevice(BenchReader & reader, int deviceIndex, BT2ReadPlan & plan, uint16_t seed) {
+	uint8_t frame[DEFAULT_DATA_BUFFER_LENGTH];
+	for (int c = 0; c < plan.getCommandCount(); c++) {
+		const RENOGY_COMMANDS * command = plan.getCommand(c);
+		int frameLength = benchBuildResponse(frame, command->startRegister, command->numberOfRegisters, seed);
+		reader.sendReadCommand(deviceIndex, command->startRegister, command->numberOfRegisters);
+		benchNotifyFrame(reader, deviceIndex, frame, frameLength);
+	}
+	reader.drainFrames(&reader.deviceTable[deviceIndex]);
+}
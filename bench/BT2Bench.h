@@ -0,0 +1,102 @@
+#ifndef BT2_BENCH_H
+#define BT2_BENCH_H
+
+/**	Host microbenchmarks for the BT2Reader hot paths.  Built by the [env:native] PlatformIO
+ * environment against the BluefruitNative stand-in; run with "pio run -e native -t exec".
+ * Each benchmark prints ns/op so a change to the library can be compared before and after.
+ */
+
+#include "BT2Reader.h"
+#include <chrono>
+
+#define BENCH_CONNECTION_HANDLE			1
+#define BENCH_LINK_LATENCY_MILLIS		100						// simulated BT2 round trip for the polling benches
+
+/** Exposes the protected internals of BT2Reader that the benchmarks time directly */
+class BenchReader : public BT2Reader {
+public:
+	using BT2Reader::deviceTable;
+	using BT2Reader::getCalculatedModbusChecksum;
+	using BT2Reader::updateModbusChecksum;
+	using BT2Reader::getIsReceivedDataValid;
+	using BT2Reader::getRegisterValueIndex;
+	using BT2Reader::getRegisterDescriptionIndex;
+	using BT2Reader::loadIdentityCache;
+	using BT2Reader::deviceTableSize;
+	using BT2Reader::parseAdvertisement;
+	using BT2Reader::getAddressHash;
+	using BT2Reader::getIsScanRejected;
+	using BT2Reader::scanRejects;
+	using BT2Reader::gattHandles;
+	using BT2Reader::rememberGattHandles;
+	using BT2Reader::recordNotification;
+	using BT2Reader::drainFrames;
+	using BT2Reader::putFormatNumber;
+	using BT2Reader::getRoundedMilli;
+	using BT2Reader::log;
+};
+
+extern volatile uint32_t benchSink;				// keeps results alive so the optimizer can't drop the work
+extern int benchFailures;
+
+void benchCheck(boolean condition, const char * what);
+void benchReport(const char * name, double nsPerOp, const char * note = "");
+
+/** Runs fn() iterations times and reports the mean cost of one call */
+template <typename F> double benchRun(const char * name, uint32_t iterations, F fn, const char * note = "") {
+	for (uint32_t i = 0; i < iterations / 10 + 1; i++) { fn(); }
+	auto start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < iterations; i++) { fn(); }
+	auto elapsed = std::chrono::steady_clock::now() - start;
+	double nsPerOp = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / iterations;
+	benchReport(name, nsPerOp, note);
+	return nsPerOp;
+}
+
+/** Bitwise Modbus CRC-16, independent of the library's table so the two can be cross-checked */
+uint16_t benchReferenceChecksum(const uint8_t * data, int len);
+
+/** Builds the BT2's response to a read of numberOfRegisters from startRegister; returns its length */
+int benchBuildResponse(uint8_t * frame, uint16_t startRegister, uint16_t numberOfRegisters, uint16_t seed);
+
+/** Connects simulated BT2 devices with handles BENCH_CONNECTION_HANDLE onwards */
+void benchConnectDevices(BenchReader & reader, int numberOfDevices);
+
+/** Feeds a response frame to the reader in 20 byte notifications, as the BT2 sends it */
+void benchNotifyFrame(BenchReader & reader, int deviceIndex, const uint8_t * frame, int frameLength);
+
+extern RENOGY_COMMANDS benchPendingReads[MAXIMUM_BT2_DEVICES];	// the last read each device was sent; clear numberOfRegisters once answered
+
+/** Stands in for the BT2s: installs a write hook recording each read command sent to reader's devices in
+ * benchPendingReads.  Like the BT2, it only hears writes to the current Tx handle
+ */
+void benchCaptureReads(BenchReader & reader);
+
+/** Drops device deviceIndex's link and connects it again; the old link's read is never answered */
+void benchReconnect(BenchReader & reader, int deviceIndex);
+
+/** Reads every command of plan on the device, answered by benchBuildResponse() with seed */
+void benchFillDevice(BenchReader & reader, int deviceIndex, BT2ReadPlan & plan, uint16_t seed);
+
+void benchCoreHotPaths();
+void benchReadPlan();
+void benchRequestQueue();
+void benchParallelPolling();
+void benchTypedValues();
+void benchHistory();
+void benchSubscriptions();
+void benchPollSchedule();
+void benchIdentityCache();
+void benchGattCache();
+void benchAdvertStorm();
+void benchLinkStats();
+void benchFrameHandoff();
+void benchStaticReaderStorage();
+void benchRegisterProfiles();
+void benchProfileDetection();
+void benchSnapshots();
+void benchFormatter();
+void benchAlarmEvents();
+void benchEnergyIntegration();
+
+#endif
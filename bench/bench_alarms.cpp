@@ -0,0 +1,149 @@
+#include "BT2Bench.h"
+
+static int benchAlarmCallbackEvents = 0;
+static uint32_t benchAlarmCallbackMillis = 0;
+
+static void benchCountAlarm(const BT2_ALARM_EVENT * event) {
+	benchAlarmCallbackEvents++;
+	benchAlarmCallbackMillis = event->millis;
+}
+
+/** Answers a read of RENOGY_CHARGING_MODE, RENOGY_ERROR_FLAGS_1 and RENOGY_ERROR_FLAGS_2 with these values */
+static void benchNotifyAlarmRegisters(BenchReader & reader, int index, uint16_t chargingMode, uint16_t flags1, uint16_t flags2) {
+	uint8_t frame[DEFAULT_DATA_BUFFER_LENGTH];
+	uint16_t values[3] = { chargingMode, flags1, flags2 };
+	int frameLength = benchBuildResponse(frame, RENOGY_CHARGING_MODE, 3, 0);
+	for (int i = 0; i < 3; i++) {
+		frame[3 + i * 2] = values[i] >> 8;
+		frame[4 + i * 2] = values[i] & 0xFF;
+	}
+	uint16_t checksum = benchReferenceChecksum(frame, frameLength - 2);
+	frame[frameLength - 2] = checksum & 0xFF;
+	frame[frameLength - 1] = checksum >> 8;
+	reader.sendReadCommand(index, RENOGY_CHARGING_MODE, 3);
+	benchNotifyFrame(reader, index, frame, frameLength);
+}
+
+static int benchTakeAlarms(BenchReader & reader, BT2_ALARM_EVENT * events, int size) {
+	int count = 0;
+	BT2_ALARM_EVENT event;
+	while (reader.getNextAlarmEvent(&event)) {
+		if (count < size) { events[count] = event; }
+		count++;
+	}
+	return count;
+}
+
+/** What a sketch does without events: look up every named flag and option of the profile after each read and
+ * compare it with what it saw last time
+ */
+static uint16_t benchScannedValues[3];
+static int benchScanForAlarms(BenchReader & reader, int index) {
+	int changes = 0;
+	const BT2_REGISTER_PROFILE * profile = reader.getRegisterProfile(index);
+	for (int i = 0; i < profile->bitFlagSize; i++) {
+		int slot = profile->bitFlags[i].registerAddress - RENOGY_CHARGING_MODE;
+		uint16_t value = reader.getRegisterValue(index, profile->bitFlags[i].registerAddress);
+		uint16_t bit = 1 << profile->bitFlags[i].bit;
+		if ((value ^ benchScannedValues[slot]) & bit) { changes++; benchScannedValues[slot] ^= bit; }
+	}
+	for (int i = 0; i < profile->optionSize; i++) {
+		if (profile->options[i].registerAddress != RENOGY_CHARGING_MODE) { continue; }
+		uint16_t value = reader.getRegisterValue(index, RENOGY_CHARGING_MODE);
+		if (value == profile->options[i].option && value != benchScannedValues[0]) { changes++; benchScannedValues[0] = value; }
+	}
+	return changes;
+}
+
+/** Error flag and charging mode transitions on a DCC charger: the events each read produces, and what a read of
+ * the alarm registers costs with events on, off, and with the sketch scanning the flags itself
+ */
+void benchAlarmEvents() {
+	static BenchReader reader;
+	benchConnectDevices(reader, 1);
+	benchNotifyAlarmRegisters(reader, 0, 2, 0, 0);
+	reader.drainFrames(&reader.deviceTable[0]);
+	BT2_ALARM_EVENT events[BT2_ALARM_QUEUE_LENGTH + 8];
+	benchCheck(benchTakeAlarms(reader, events, 0) == 0, "no events until beginAlarms()");
+	uint32_t flags2 = 0;
+	benchRun("notify + decode alarm registers, events off", 500000, [&]() { benchNotifyAlarmRegisters(reader, 0, 5, 0, 0); reader.drainFrames(&reader.deviceTable[0]); });
+	benchRun("notify + decode alarm registers, sketch scans the flags", 500000, [&]() {
+		benchNotifyAlarmRegisters(reader, 0, 5, 0, flags2 ^= 1 << 9);
+		benchSink += benchScanForAlarms(reader, 0);
+	});
+
+	reader.beginAlarms();
+	reader.setRegisterProfile(0, &BT2_REGISTER_MAP_ROVER::profile);
+	reader.setRegisterProfile(0, &BT2_REGISTER_MAP_DCC::profile);								// forget the first read
+	benchNotifyAlarmRegisters(reader, 0, 2, 0x0001 | 1 << 11, 1 << 9);							// bit 0 of flags 1 has no name
+	int count = benchTakeAlarms(reader, events, BT2_ALARM_QUEUE_LENGTH);
+	benchCheck(count == 3 && events[0].registerAddress == RENOGY_CHARGING_MODE && events[0].id == 2 && events[0].raised
+		&& strcmp(events[0].name, "MPPT charging (solar)") == 0, "first read raises the charging mode");
+	benchCheck(events[1].registerAddress == RENOGY_ERROR_FLAGS_1 && events[1].id == 11 && events[1].raised
+		&& strcmp(events[1].name, "Aux batt low temperature") == 0, "first read raises the flags already set");
+	benchCheck(events[2].registerAddress == RENOGY_ERROR_FLAGS_2 && events[2].id == 9 && strcmp(events[2].name, "Solar input overvoltage") == 0
+		&& events[2].deviceIndex == 0, "only named bits raise events");
+
+	benchNotifyAlarmRegisters(reader, 0, 2, 0x0001 | 1 << 11, 1 << 9);
+	benchCheck(benchTakeAlarms(reader, events, BT2_ALARM_QUEUE_LENGTH) == 0, "a read with nothing new is silent");
+	benchNotifyAlarmRegisters(reader, 0, 2, 0x0002 | 1 << 11, 1 << 9);
+	benchCheck(benchTakeAlarms(reader, events, BT2_ALARM_QUEUE_LENGTH) == 0, "unnamed bits are ignored");
+	uint8_t frame[DEFAULT_DATA_BUFFER_LENGTH];
+	for (int k = 0; k < MAXIMUM_FRAME_RUNS; k++) {												// pushes the alarm registers out of frameRuns
+		nativeAdvanceMillis(1);
+		int frameLength = benchBuildResponse(frame, RENOGY_AUX_BATT_VOLTAGE + k, 1, 0);
+		reader.sendReadCommand(0, RENOGY_AUX_BATT_VOLTAGE + k, 1);
+		benchNotifyFrame(reader, 0, frame, frameLength);
+		reader.drainFrames(&reader.deviceTable[0]);
+	}
+	benchNotifyAlarmRegisters(reader, 0, 2, 0x0002 | 1 << 11, 1 << 9);
+	benchCheck(benchTakeAlarms(reader, events, BT2_ALARM_QUEUE_LENGTH) == 0, "a fault isn't raised again once its frame run is forgotten");
+
+	nativeAdvanceMillis(1000);
+	benchNotifyAlarmRegisters(reader, 0, 5, 1 << 11 | 1 << 4, 0);
+	count = benchTakeAlarms(reader, events, BT2_ALARM_QUEUE_LENGTH);
+	benchCheck(count == 4 && !events[0].raised && events[0].id == 2 && events[1].raised && strcmp(events[1].name, "Float charging (Solar/Alternator)") == 0,
+		"charging mode change clears the old mode and raises the new");
+	benchCheck(events[2].registerAddress == RENOGY_ERROR_FLAGS_1 && events[2].id == 4 && events[2].raised
+		&& events[3].registerAddress == RENOGY_ERROR_FLAGS_2 && events[3].id == 9 && !events[3].raised
+		&& events[3].millis == millis(), "flag raised and flag cleared, timestamped");
+
+	for (int i = 0; i < BT2_ALARM_QUEUE_LENGTH; i++) {
+		benchNotifyAlarmRegisters(reader, 0, 5, 1 << 11 | 1 << 4, i & 0x01 ? 0 : 1 << 7);
+		reader.drainFrames(&reader.deviceTable[0]);
+	}
+	count = benchTakeAlarms(reader, events, BT2_ALARM_QUEUE_LENGTH);
+	benchCheck(count == BT2_ALARM_QUEUE_LENGTH && reader.getAlarmEventsDropped() == 0, "queue holds BT2_ALARM_QUEUE_LENGTH events");
+	for (int i = 0; i < BT2_ALARM_QUEUE_LENGTH + 6; i++) {
+		benchNotifyAlarmRegisters(reader, 0, 5, 1 << 11 | 1 << 4, i & 0x01 ? 0 : 1 << 7);
+		reader.drainFrames(&reader.deviceTable[0]);
+	}
+	count = benchTakeAlarms(reader, events, BT2_ALARM_QUEUE_LENGTH);
+	benchCheck(count == BT2_ALARM_QUEUE_LENGTH && reader.getAlarmEventsDropped() == 6 && !events[BT2_ALARM_QUEUE_LENGTH - 1].raised,
+		"a full queue drops the oldest and keeps the latest");
+
+	reader.beginAlarms(benchCountAlarm);
+	benchNotifyAlarmRegisters(reader, 0, 5, 1 << 11 | 1 << 4, 1 << 12);
+	reader.service();
+	benchCheck(benchAlarmCallbackEvents == 1 && benchAlarmCallbackMillis == millis(), "callback runs from the service() that decodes the frame");
+
+	reader.beginAlarms();
+	reader.setRegisterProfile(0, &BT2_REGISTER_MAP_ROVER::profile);
+	benchNotifyAlarmRegisters(reader, 0, 5, 0, 0);
+	benchTakeAlarms(reader, events, BT2_ALARM_QUEUE_LENGTH);
+	benchNotifyAlarmRegisters(reader, 0, 0x8005, 0, 0);
+	benchCheck(benchTakeAlarms(reader, events, BT2_ALARM_QUEUE_LENGTH) == 0, "a Rover's load output switching on isn't an option change");
+	benchNotifyAlarmRegisters(reader, 0, 0x8002, 0, 0);
+	count = benchTakeAlarms(reader, events, BT2_ALARM_QUEUE_LENGTH);
+	benchCheck(count == 2 && events[0].id == 5 && !events[0].raised && events[0].name != NULL && events[1].id == 2 && events[1].raised
+		&& events[1].name != NULL, "Rover option events carry the masked value and its name");
+	reader.setRegisterProfile(0, &BT2_REGISTER_MAP_DCC::profile);
+	benchRun("notify + decode alarm registers, events on, no change", 500000, [&]() { benchNotifyAlarmRegisters(reader, 0, 5, 0, 0); reader.drainFrames(&reader.deviceTable[0]); });
+	benchRun("notify + decode alarm registers, events on, 1 flag flips", 500000, [&]() {
+		benchNotifyAlarmRegisters(reader, 0, 5, 0, flags2 ^= 1 << 9);
+		BT2_ALARM_EVENT event;
+		while (reader.getNextAlarmEvent(&event)) { benchSink += event.id; }
+	});
+	BT2_ALARM_EVENT event;
+	benchRun("getNextAlarmEvent(), empty queue", 2000000, [&]() { benchSink += reader.getNextAlarmEvent(&event); });
+}
@@ -0,0 +1,142 @@
+#include "BT2Bench.h"
+
+/** Times the per-frame work the library does today: checksum, register slot lookup,
+ * notification assembly and decode, and printRegister formatting
+ */
+void benchCoreHotPaths() {
+	static BenchReader reader;
+	benchConnectDevices(reader, 1);
+	DEVICE * device = &reader.deviceTable[0];
+
+	char storeNote[96];
+	snprintf(storeNote, sizeof(storeNote), "%d registers: %d bytes/device as REGISTER_VALUE array, %d bytes/device now",
+		REGISTER_VALUE_SIZE, (int)(REGISTER_VALUE_SIZE * sizeof(REGISTER_VALUE)),
+		(int)(REGISTER_VALUE_SIZE * sizeof(uint16_t) + sizeof(device->frameRuns)));
+	benchReport("register store", 0, storeNote);
+
+	uint8_t frame[DEFAULT_DATA_BUFFER_LENGTH];
+	int frameLength = benchBuildResponse(frame, 0xE001, 0x21, 7);
+	benchCheck(reader.getCalculatedModbusChecksum(frame) == benchReferenceChecksum(frame, frameLength - 2), "table checksum matches bitwise checksum");
+
+	benchRun("getCalculatedModbusChecksum (0x21 registers, 69 bytes)", 2000000, [&]() {
+		benchSink += reader.getCalculatedModbusChecksum(frame);
+	});
+	benchRun("byte-at-a-time MODBUS_TABLE_A001 (same 69 bytes)", 2000000, [&]() {
+		uint16_t crc = 0xFFFF;
+		for (int i = 0; i < frameLength - 2; i++) { crc = (crc >> 8) ^ MODBUS_TABLE_A001[(crc ^ frame[i]) & 0xFF]; }
+		benchSink += crc;
+	});
+	uint16_t incremental = 0xFFFF;
+	for (int offset = 0; offset < frameLength - 2; offset += 20) {
+		incremental = reader.updateModbusChecksum(incremental, &frame[offset], min(20, frameLength - 2 - offset));
+	}
+	benchCheck(incremental == benchReferenceChecksum(frame, frameLength - 2), "incremental checksum over 20 byte notifications matches");
+
+	uint16_t addresses[64];
+	int numberOfAddresses = 0;
+	for (uint16_t a = 0x0100; a <= 0x0122 && numberOfAddresses < 64; a++) { addresses[numberOfAddresses++] = a; }
+	for (uint16_t a = 0xE001; a <= 0xE021 && numberOfAddresses < 64; a++) { addresses[numberOfAddresses++] = a; }
+	int expectedSlot = 0;
+	int numberOfDescriptions = sizeof(registerDescription) / sizeof(registerDescription[0]);
+	for (int i = 0; i < numberOfDescriptions; i++) {
+		benchCheck(reader.getRegisterDescriptionIndex(device, registerDescription[i].address) == i, "description index for every described register");
+		for (int k = 0; k < registerDescription[i].bytesUsed / 2; k++) {
+			benchCheck(reader.getRegisterValueIndex(device, registerDescription[i].address + k) == expectedSlot++, "value slot for every register");
+		}
+	}
+	benchCheck(reader.getRegisterValueIndex(device, 0x010A) == -1 && reader.getRegisterValueIndex(device, 0xE001) == -1, "gaps in the register map are not found");
+
+	int next = 0;
+	benchRun("getRegisterValueIndex (0x0100-0x0122, 0xE001-0xE021)", 5000000, [&]() {
+		benchSink += reader.getRegisterValueIndex(device, addresses[next]);
+		next = (next + 1) % numberOfAddresses;
+	});
+	benchRun("getRegisterDescriptionIndex (same addresses)", 5000000, [&]() {
+		benchSink += reader.getRegisterDescriptionIndex(device, addresses[next]);
+		next = (next + 1) % numberOfAddresses;
+	});
+
+	nativeAdvanceMillis(10);
+	reader.sendReadCommand(0, 0x0100, 7);
+	int solarLength = benchBuildResponse(frame, 0x0100, 7, 3);
+	benchNotifyFrame(reader, 0, frame, solarLength);
+	benchCheck(reader.getIsNewDataAvailable(0), "frame 0x0100 x 7 completes");
+	benchCheck(reader.getRegisterValue(0, RENOGY_ALTERNATOR_POWER) == (uint16_t)(RENOGY_ALTERNATOR_POWER * 31 + 3), "register decoded from frame");
+	REGISTER_VALUE alternatorPower = reader.getRegister(0, RENOGY_ALTERNATOR_POWER);
+	benchCheck(alternatorPower.registerAddress == RENOGY_ALTERNATOR_POWER && alternatorPower.lastUpdateMillis > 0 
+		&& reader.getRegister(0, RENOGY_SOLAR_POWER).lastUpdateMillis == 0, "frame run timestamps cover just the registers read");
+
+	frameLength = benchBuildResponse(frame, 0x0100, 0x23, 5);
+	benchRun("sendReadCommand + notifyCallback (0x0100 x 0x23, 4 notifications)", 500000, [&]() {
+		reader.sendReadCommand(0, 0x0100, 0x23);
+		benchNotifyFrame(reader, 0, frame, frameLength);
+		benchSink += reader.getIsNewDataAvailable(0);
+	});
+	benchCheck(reader.getRegisterValue(0, RENOGY_ERROR_FLAGS_2) == (uint16_t)(RENOGY_ERROR_FLAGS_2 * 31 + 5), "last register of 0x23 frame decoded");
+
+	uint8_t noisy[DEFAULT_DATA_BUFFER_LENGTH * 2];
+	frameLength = benchBuildResponse(frame, 0x0100, 7, 21);
+	const uint8_t noise[] = { 0x12, 0xFF, 0x77, 0xFF, 0x03, 0x0E };		// a bad function code, then a false start with a plausible length
+	memcpy(noisy, noise, sizeof(noise));
+	memcpy(&noisy[sizeof(noise)], frame, frameLength);
+	int noisyLength = sizeof(noise) + frameLength;
+	reader.sendReadCommand(0, 0x0100, 7);
+	benchNotifyFrame(reader, 0, noisy, noisyLength);
+	benchCheck(device->frameStatus == BT2_FRAME_COMPLETE && reader.getRegisterValue(0, RENOGY_AUX_BATT_SOC) == (uint16_t)(RENOGY_AUX_BATT_SOC * 31 + 21),
+		"parser resynchronizes past noise and a false start");
+	benchRun("sendReadCommand + notifyCallback (0x0100 x 7 behind a false start)", 500000, [&]() {
+		reader.sendReadCommand(0, 0x0100, 7);
+		benchNotifyFrame(reader, 0, noisy, noisyLength);
+		benchSink += device->frameStatus;
+	});
+
+	reader.sendReadCommand(0, 0x0100, 7);
+	benchNotifyFrame(reader, 0, frame, frameLength - 1);
+	benchCheck(device->frameStatus == BT2_FRAME_PENDING, "truncated frame stays pending");
+	reader.sendReadCommand(0, 0x0100, 8);
+	benchNotifyFrame(reader, 0, frame, frameLength);
+	benchCheck(device->frameStatus == BT2_FRAME_PENDING, "response with the wrong length is rejected");
+	uint8_t exception[5] = { 0xFF, MODBUS_READ_EXCEPTION, 0x02, 0, 0 };
+	uint16_t checksum = benchReferenceChecksum(exception, 3);
+	exception[3] = checksum & 0xFF;
+	exception[4] = checksum >> 8;
+	reader.sendReadCommand(0, 0x0100, 7);
+	benchNotifyFrame(reader, 0, exception, 5);
+	benchCheck(device->frameStatus == BT2_FRAME_EXCEPTION, "Modbus exception response recognized");
+	benchCheck(reader.getCalculatedModbusChecksum(exception) == checksum && reader.getIsReceivedDataValid(exception),
+		"exception frames are checksummed over their 3 bytes");
+
+	uint8_t oversized[3 + 60 * 2 + 2];
+	int oversizedLength = benchBuildResponse(oversized, 0x0100, 60, 0);
+	uint32_t commandsSent = device->stats.commandsSent;
+	Serial.setOutput(NULL);
+	reader.sendReadCommand(0, 0x0100, 60);
+	reader.sendReadCommand(0, 0x0100, 0);
+	Serial.setOutput(stdout);
+	benchCheck(device->stats.commandsSent == commandsSent, "sendReadCommand refuses no registers, or more than fit in a frame");
+	reader.sendReadCommand(0, 0x0100, 7);
+	device->registersRequested = 60;														// as if the command had gone out
+	benchNotifyFrame(reader, 0, oversized, oversizedLength);
+	benchCheck(device->frameStatus == BT2_FRAME_PENDING && device->dataReceivedLength <= DEFAULT_DATA_BUFFER_LENGTH,
+		"a response longer than dataReceived is refused at its length byte");
+
+	frameLength = benchBuildResponse(frame, 0xE001, 0x21, 9);
+	benchRun("sendReadCommand + notifyCallback (0xE001 x 0x21, 4 notifications)", 500000, [&]() {
+		reader.sendReadCommand(0, 0xE001, 0x21);
+		benchNotifyFrame(reader, 0, frame, frameLength);
+		benchSink += reader.getIsNewDataAvailable(0);
+	});
+
+	Serial.setOutput(NULL);
+	uint32_t bytesBefore = Serial.bytesWritten;
+	for (int i = 1; i < numberOfDescriptions; i++) { reader.printRegister(device, registerDescription[i].address); }
+	char note[32];
+	snprintf(note, sizeof(note), "%.1f bytes/register", (double)(Serial.bytesWritten - bytesBefore) / (numberOfDescriptions - 1));
+
+	int nextDescription = 1;
+	benchRun("printRegister (every described register)", 200000, [&]() {
+		benchSink += reader.printRegister(device, registerDescription[nextDescription].address);
+		nextDescription = nextDescription + 1 < numberOfDescriptions ? nextDescription + 1 : 1;
+	}, note);
+	Serial.setOutput(stdout);
+}
@@ -0,0 +1,144 @@
+#include "BT2Bench.h"
+
+static BenchReader * benchDetectionReader = NULL;
+static const char * benchDetectionModels[2];
+
+/** A response whose RENOGY_PRODUCT_MODEL registers, if it covers them, hold model padded with spaces */
+static int benchBuildModelResponse(uint8_t * frame, uint16_t startRegister, uint16_t numberOfRegisters, const char * model) {
+	int frameLength = benchBuildResponse(frame, startRegister, numberOfRegisters, 0);
+	for (int i = 0; i < 16; i++) {
+		int offset = 3 + 2 * (RENOGY_PRODUCT_MODEL - startRegister) + i;
+		if (offset < 3 || offset >= frameLength - 2) { continue; }
+		frame[offset] = (i < (int)strlen(model) ? model[i] : ' ');
+	}
+	uint16_t checksum = benchReferenceChecksum(frame, frameLength - 2);
+	frame[frameLength - 2] = checksum & 0xFF;
+	frame[frameLength - 1] = checksum >> 8;
+	return frameLength;
+}
+
+/** Runs service() for rounds link round trips, answering every read as the device benchDetectionModels names,
+ * or not at all if that's NULL.  Returns the reads sent to device 0
+ */
+static int benchAnswerDetectionReads(int rounds, int * productModelReads) {
+	uint8_t frame[DEFAULT_DATA_BUFFER_LENGTH];
+	int reads = 0;
+	for (int round = 0; round < rounds; round++) {
+		benchDetectionReader->service();
+		nativeAdvanceMillis(BENCH_LINK_LATENCY_MILLIS);
+		for (int i = 0; i < 2; i++) {
+			RENOGY_COMMANDS * read = &benchPendingReads[i];
+			if (read->numberOfRegisters == 0) { continue; }
+			if (i == 0) { reads++; }
+			if (read->startRegister == RENOGY_PRODUCT_MODEL && read->numberOfRegisters == 8 && productModelReads != NULL) { productModelReads[i]++; }
+			int frameLength = benchBuildModelResponse(frame, read->startRegister, read->numberOfRegisters, benchDetectionModels[i] != NULL ? benchDetectionModels[i] : "");
+			read->numberOfRegisters = 0;
+			if (benchDetectionModels[i] != NULL) { benchNotifyFrame(*benchDetectionReader, i, frame, frameLength); }
+		}
+	}
+	benchDetectionReader->service();
+	return reads;
+}
+
+/** A Rover and a DCC50S behind one reader that starts out treating both as DCC chargers: what detection costs
+ * on connect, and what it saves per refresh once the Rover is read with its own profile and plan
+ */
+void benchProfileDetection() {
+	static BenchReader reader;
+	benchDetectionReader = &reader;
+	benchConnectDevices(reader, 2);
+	benchCaptureReads(reader);
+	benchDetectionModels[0] = "RNG-CTRL-RVR40";
+	benchDetectionModels[1] = "RBC50D1S-G1";
+
+	static BT2ReadPlan dccPlan;
+	dccPlan.addRegisterMap(&BT2_REGISTER_MAP_DCC::profile);
+	dccPlan.build();
+	static BT2ReadPlan roverPlan;
+	roverPlan.addRegisterMap(&BT2_REGISTER_MAP_ROVER::profile);
+	roverPlan.build();
+	static const BT2_MODEL_PROFILE models[] = {
+		{"RBC", &BT2_REGISTER_MAP_DCC::profile, &dccPlan},
+		{"RNG-CTRL-RVR", &BT2_REGISTER_MAP_ROVER::profile, &roverPlan},
+	};
+	reader.setReadPlan(&dccPlan);
+	int undetectedReads = benchAnswerDetectionReads(60, NULL);
+
+	reader.subscribe(0, RENOGY_AUX_BATT_VOLTAGE, 100);
+	reader.subscribe(0, RENOGY_ERROR_FLAGS_2);										// the Rover doesn't have it
+	reader.beginProfileDetection(models, 2);
+	int productModelReads[2] = {0, 0};
+	benchAnswerDetectionReads(3, productModelReads);							// the plan read in flight, then the model
+	benchCheck(productModelReads[0] == 1 && productModelReads[1] == 1, "product model read on every connected device");
+	benchCheck(reader.getIsProfileDetected(0) && reader.getRegisterProfile(0) == &BT2_REGISTER_MAP_ROVER::profile
+		&& reader.deviceTable[0].readPlan == &roverPlan, "Rover bound to its profile and read plan");
+	benchCheck(reader.getIsProfileDetected(1) && reader.getRegisterProfile(1) == &BT2_REGISTER_MAP_DCC::profile, "DCC50S keeps the DCC profile");
+	benchCheck(strcmp(reader.getProductModel(0), "RNG-CTRL-RVR40") == 0, "product model survives the rebind");
+	int detectedReads = benchAnswerDetectionReads(60, productModelReads);
+	benchCheck(reader.getNextChangedRegister(0) == RENOGY_AUX_BATT_VOLTAGE && reader.getNextChangedRegister(0) == -1,
+		"a subscription follows its address into the detected profile, one the profile lacks is dropped");
+	benchCheck(productModelReads[0] == 1 && productModelReads[1] == 1, "product model read once per connection");
+	benchCheck(reader.getRegister(0, RENOGY_TOTAL_GENERATION).registerAddress == RENOGY_TOTAL_GENERATION
+		&& reader.getRegister(0, RENOGY_AUX_BATT_VOLTAGE).registerAddress == RENOGY_AUX_BATT_VOLTAGE, "Rover plan fills the Rover's registers");
+
+	char note[128];
+	snprintf(note, sizeof(note), "%d reads of %d registers per refresh as DCC, %d reads of %d as Rover; detection costs 1 read per connect",
+		dccPlan.getCommandCount(), dccPlan.getRegistersRead(), roverPlan.getCommandCount(), roverPlan.getRegistersRead());
+	benchReport("Rover polled through profile detection", 0, note);
+	snprintf(note, sizeof(note), "%.1f s/refresh as DCC, %.1f s/refresh after detection",
+		6.0 / ((double)undetectedReads / dccPlan.getCommandCount()), 6.0 / ((double)detectedReads / roverPlan.getCommandCount()));
+	benchReport("Rover refresh time, 100ms link", 0, note);
+
+	benchDetectionModels[0] = "RNG-CTRL-XYZ";
+	reader.setRegisterProfile(0, &BT2_REGISTER_MAP_DCC::profile);
+	benchReconnect(reader, 0);
+	benchAnswerDetectionReads(3, NULL);
+	benchCheck(!reader.getIsProfileDetected(0) && reader.getRegisterProfile(0) == &BT2_REGISTER_MAP_DCC::profile, "unknown model keeps its profile");
+
+	benchDetectionModels[0] = NULL;
+	benchReconnect(reader, 0);
+	memset(productModelReads, 0, sizeof(productModelReads));
+	benchAnswerDetectionReads(3, productModelReads);
+	for (int attempt = 0; attempt < PROFILE_DETECTION_ATTEMPTS; attempt++) {
+		nativeAdvanceMillis(DEFAULT_REQUEST_TIMEOUT);
+		benchAnswerDetectionReads(1, productModelReads);
+	}
+	benchCheck(productModelReads[0] == PROFILE_DETECTION_ATTEMPTS && reader.deviceTable[0].profileDetection == BT2_PROFILE_DETECTION_DONE
+		&& benchPendingReads[0].startRegister != RENOGY_PRODUCT_MODEL, "a silent device gives up detection and goes back to polling");
+
+	reader.beginIdentityCache();
+	reader.clearIdentityCache(0);
+	benchDetectionModels[0] = "RNG-CTRL-RVR40";
+	benchReconnect(reader, 0);
+	benchAnswerDetectionReads(60, NULL);										// reads the identity, which saves it
+	reader.setRegisterProfile(0, &BT2_REGISTER_MAP_DCC::profile);
+	reader.setReadPlan(0, &dccPlan);
+	benchReconnect(reader, 0);
+	memset(productModelReads, 0, sizeof(productModelReads));
+	benchAnswerDetectionReads(1, productModelReads);
+	benchCheck(productModelReads[0] == 0 && reader.getIsProfileDetected(0) && reader.getRegisterProfile(0) == &BT2_REGISTER_MAP_ROVER::profile,
+		"cached identity detects the profile without a read");
+
+	static StaticBT2Reader<1> staticReader;										// DCC to start with, sized for any profile
+	staticReader.setDeviceTableSize(1);
+	uint8_t peerAddress[6] = { 0x10, 0x20, 0x30, 0x40, 0x52, 0x60 };
+	staticReader.addTargetBT2Device(peerAddress);
+	staticReader.begin();
+	staticReader.beginProfileDetection(models, 2);
+	DEVICE * device = staticReader.getDevice(0);
+	Bluefruit.nativeConnect(BENCH_CONNECTION_HANDLE + 2, device->peerAddress, "BT-TH-STATIC01");
+	staticReader.connectCallback(BENCH_CONNECTION_HANDLE + 2);
+	staticReader.service();
+	uint8_t frame[DEFAULT_DATA_BUFFER_LENGTH];
+	int frameLength = benchBuildModelResponse(frame, RENOGY_PRODUCT_MODEL, 8, "RNG-CTRL-RVR40");
+	for (int offset = 0; offset < frameLength; offset += 20) {
+		staticReader.notifyCallback(&device->rxCharacteristic, &frame[offset], min(20, frameLength - offset));
+	}
+	staticReader.service();
+	benchCheck(staticReader.getIsProfileDetected(0) && staticReader.getRegisterProfile(0) == &BT2_REGISTER_MAP_ROVER::profile,
+		"StaticBT2Reader<1> binds a detected Rover");
+	Bluefruit.disconnect(BENCH_CONNECTION_HANDLE + 2);
+	staticReader.disconnectCallback(BENCH_CONNECTION_HANDLE + 2, 0x13);
+
+	BLEClientCharacteristic::nativeWriteHook = NULL;
+}
@@ -0,0 +1,95 @@
+#include "BT2Bench.h"
+
+#define BENCH_ENERGY_START				RENOGY_ALTERNATOR_CURRENT
+#define BENCH_ENERGY_REGISTERS			(RENOGY_TODAY_POWER - RENOGY_ALTERNATOR_CURRENT + 1)
+
+/** Answers a read of RENOGY_ALTERNATOR_CURRENT through RENOGY_TODAY_POWER with these raw values, and decodes it */
+static void benchNotifyEnergyRegisters(BenchReader & reader, int index, uint16_t alternatorPower, uint16_t solarPower, uint16_t solarCurrent,
+	uint16_t todayAmpHours, uint16_t todayWattHours) {
+	uint8_t frame[DEFAULT_DATA_BUFFER_LENGTH];
+	int frameLength = benchBuildResponse(frame, BENCH_ENERGY_START, BENCH_ENERGY_REGISTERS, 0);
+	const uint16_t registers[6] = { RENOGY_ALTERNATOR_CURRENT, RENOGY_ALTERNATOR_POWER, RENOGY_SOLAR_CURRENT, RENOGY_SOLAR_POWER,
+		RENOGY_TODAY_AMP_HOURS, RENOGY_TODAY_POWER };
+	const uint16_t values[6] = { (uint16_t)(alternatorPower * 100 / 14), alternatorPower, solarCurrent, solarPower, todayAmpHours, todayWattHours };
+	for (int i = 0; i < 6; i++) {
+		frame[3 + (registers[i] - BENCH_ENERGY_START) * 2] = values[i] >> 8;
+		frame[4 + (registers[i] - BENCH_ENERGY_START) * 2] = values[i] & 0xFF;
+	}
+	uint16_t checksum = benchReferenceChecksum(frame, frameLength - 2);
+	frame[frameLength - 2] = checksum & 0xFF;
+	frame[frameLength - 1] = checksum >> 8;
+	reader.sendReadCommand(index, BENCH_ENERGY_START, BENCH_ENERGY_REGISTERS);
+	benchNotifyFrame(reader, index, frame, frameLength);
+	reader.drainFrames(&reader.deviceTable[index]);
+}
+
+static boolean benchGetIsNear(int64_t value, int64_t expected, int64_t tolerance) { return (value >= expected - tolerance && value <= expected + tolerance); }
+
+/** A DCC charger and a Rover read once a second across a millis() wrap: solar ramps from 100W to 500W at a steady
+ * 5A, the alternator holds 200W.  The integrated totals against the exact ones, what summing power * elapsed from
+ * lastUpdateMillis gives instead, gaps, and the drift against RENOGY_TODAY_POWER and RENOGY_TODAY_AMP_HOURS
+ */
+void benchEnergyIntegration() {
+	static BenchReader reader;
+	benchConnectDevices(reader, 2);
+	reader.setRegisterProfile(1, &BT2_REGISTER_MAP_ROVER::profile);
+	BT2_ENERGY energy;
+	benchNotifyEnergyRegisters(reader, 0, 200, 100, 500, 2, 10);
+	benchRun("notify + decode energy registers, energy off", 500000, [&]() { benchNotifyEnergyRegisters(reader, 0, 200, 100, 500, 2, 10); });
+
+	reader.beginEnergy();
+	nativeAdvanceMillis(0xFFFFFFFF - millis() - 20000);							// wraps 20s into the ramp
+	uint32_t startMillis = millis();
+	int64_t rectangleWattMillis = 0;											// what a sketch summing power * elapsed gets
+	uint16_t previousPower = 0;
+	uint32_t previousMillis = 0;
+	for (int k = 0; k <= 40; k++) {
+		uint16_t solarPower = 100 + 10 * k;
+		benchNotifyEnergyRegisters(reader, 0, 200, solarPower, 500, 2, k < 40 ? 10 : 15);
+		benchNotifyEnergyRegisters(reader, 1, 200, solarPower, 500, 2, 10);
+		uint32_t updateMillis = reader.getRegister(0, RENOGY_SOLAR_POWER).lastUpdateMillis;
+		if (k > 0) { rectangleWattMillis += (int64_t)previousPower * (uint32_t)(updateMillis - previousMillis); }
+		previousPower = solarPower;
+		previousMillis = updateMillis;
+		if (k < 40) { nativeAdvanceMillis(1000); }
+	}
+	benchCheck(millis() < startMillis, "readings span a millis() wrap");
+	reader.getEnergy(0, &energy);
+	benchCheck(benchGetIsNear(energy.milliwattHours[BT2_ENERGY_SOLAR], 3333, 2), "solar ramp integrates to 3333mWh across the wrap");
+	benchCheck(benchGetIsNear(energy.milliampHours[BT2_ENERGY_SOLAR], 55556 / 1000, 1) && benchGetIsNear(energy.milliwattHours[BT2_ENERGY_ALTERNATOR], 2222, 2),
+		"steady current and power integrate exactly");
+	benchCheck(energy.hasDailyCounters && benchGetIsNear(energy.driftMilliwattHours, 5555 - 5000, 3) && energy.gaps == 0,
+		"drift is integrated Wh minus the counter's increase");
+	int64_t rectangleMilliwattHours = rectangleWattMillis / 3600;
+
+	BT2_ENERGY rover;
+	reader.getEnergy(1, &rover);
+	benchCheck(benchGetIsNear(rover.milliwattHours[BT2_ENERGY_SOLAR], 3333, 2) && rover.milliwattHours[BT2_ENERGY_ALTERNATOR] == 0
+		&& rover.milliampHours[BT2_ENERGY_ALTERNATOR] == 0, "a Rover integrates solar and not its load output");
+
+	nativeAdvanceMillis(BT2_ENERGY_MAX_GAP_MILLIS + 1);
+	benchNotifyEnergyRegisters(reader, 0, 200, 500, 500, 2, 15);
+	BT2_ENERGY afterGap;
+	reader.getEnergy(0, &afterGap);
+	benchCheck(afterGap.gaps == BT2_ENERGY_SOURCES * 2 && afterGap.milliwattHours[BT2_ENERGY_SOLAR] == energy.milliwattHours[BT2_ENERGY_SOLAR],
+		"a gap is counted, not integrated");
+
+	nativeAdvanceMillis(1000);
+	benchNotifyEnergyRegisters(reader, 0, 200, 500, 500, 0, 0);
+	reader.getEnergy(0, &energy);
+	benchCheck(energy.driftMilliwattHours == 0 && energy.driftMilliampHours == 0, "the counters going back to zero start a new baseline");
+	reader.resetEnergy(0);
+	reader.getEnergy(0, &energy);
+	benchCheck(energy.milliwattHours[BT2_ENERGY_SOLAR] == 0 && energy.gaps == 0 && !energy.hasDailyCounters, "resetEnergy() zeroes the totals");
+	nativeAdvanceMillis(3600);
+	benchNotifyEnergyRegisters(reader, 0, 200, 500, 500, 0, 0);
+	reader.getEnergy(0, &energy);
+	benchCheck(benchGetIsNear(energy.milliwattHours[BT2_ENERGY_SOLAR], 500, 1), "integration carries on from the last reading after a reset");
+
+	char note[128];
+	snprintf(note, sizeof(note), "ramp: exact 3333mWh, integrated %lumWh, power * elapsed %ldmWh",
+		(unsigned long)afterGap.milliwattHours[BT2_ENERGY_SOLAR], (long)rectangleMilliwattHours);
+	benchReport("energy of a 100W to 500W ramp read once a second", 0, note);
+	benchRun("notify + decode energy registers, energy on", 500000, [&]() { benchNotifyEnergyRegisters(reader, 0, 200, 500, 500, 0, 0); });
+	benchRun("getEnergy()", 2000000, [&]() { reader.getEnergy(0, &energy); benchSink += energy.milliwattHours[0]; });
+}
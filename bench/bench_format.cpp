@@ -0,0 +1,138 @@
+#include "BT2Bench.h"
+
+#define BENCH_DUMP_LENGTH				16384
+
+static BenchReader benchFormatReader;
+
+/** Every register of both devices through printRegister(), as a sketch dumping them would */
+static void benchPrintEveryRegister() {
+	for (int i = 0; i < 2; i++) {
+		const BT2_REGISTER_PROFILE * profile = benchFormatReader.getRegisterProfile(i);
+		for (int d = 0; d < profile->descriptionSize; d++) {
+			if (profile->descriptions[d].address != INVALID_REGISTER) { benchFormatReader.printRegister(&benchFormatReader.deviceTable[i], profile->descriptions[d].address); }
+		}
+	}
+}
+
+/** Runs fn with Serial going to a memory buffer; returns what it wrote, and the writes it took */
+template <typename F> static int benchCaptureSerial(char * buffer, int size, uint32_t * writeCalls, F fn) {
+	FILE * stream = fmemopen(buffer, size, "w");
+	uint32_t writes = Serial.writeCalls;
+	Serial.setOutput(stream);
+	fn();
+	Serial.setOutput(stdout);
+	long length = ftell(stream);
+	fclose(stream);
+	if (writeCalls != NULL) { *writeCalls = Serial.writeCalls - writes; }
+	return (int)length;
+}
+
+/** Braces, brackets and quotes balance, and nothing follows the closing brace but the newline */
+static boolean benchGetIsJsonLine(const char * line, int length) {
+	int depth = 0;
+	boolean quoted = false;
+	for (int i = 0; i < length; i++) {
+		if (quoted) {
+			if (line[i] == '\\') { i++; }
+			else if (line[i] == '"') { quoted = false; }
+			else if ((uint8_t)line[i] < 32) { return false; }
+			continue;
+		}
+		if (line[i] == '"') { quoted = true; }
+		else if (line[i] == '{' || line[i] == '[') { depth++; }
+		else if (line[i] == '}' || line[i] == ']') { depth--; }
+		if (depth == 0 && i < length - 2) { return false; }
+	}
+	return (depth == 0 && !quoted && line[0] == '{' && line[length - 1] == '\n');
+}
+
+/** A DCC charger and a Rover dumped through printRegister(), formatDevices() and printDevice(): the text is the
+ * same to the byte, and the writes it takes go from one per field to one per device
+ */
+void benchFormatter() {
+	BenchReader & reader = benchFormatReader;
+	benchConnectDevices(reader, 2);
+	reader.setRegisterProfile(1, &BT2_REGISTER_MAP_ROVER::profile);
+	static BT2ReadPlan dccPlan;
+	dccPlan.addRegisterMap(&BT2_REGISTER_MAP_DCC::profile);
+	dccPlan.build();
+	static BT2ReadPlan roverPlan;
+	roverPlan.addRegisterMap(&BT2_REGISTER_MAP_ROVER::profile);
+	roverPlan.build();
+	benchFillDevice(reader, 0, dccPlan, 0);
+	benchFillDevice(reader, 1, roverPlan, 0);
+
+	static char printed[BENCH_DUMP_LENGTH];
+	static char formatted[BENCH_DUMP_LENGTH];
+	uint32_t printWrites;
+	uint32_t deviceWrites;
+	int printedLength = benchCaptureSerial(printed, sizeof(printed), &printWrites, benchPrintEveryRegister);
+	int formattedLength = reader.formatDevices(formatted, sizeof(formatted));
+	benchCheck(formattedLength == printedLength && memcmp(printed, formatted, printedLength) == 0, "formatDevices() text is printRegister() text");
+	int deviceLength = benchCaptureSerial(printed, sizeof(printed), &deviceWrites, [&]() { reader.printDevice(0); reader.printDevice(1); });
+	benchCheck(deviceLength == formattedLength && memcmp(printed, formatted, deviceLength) == 0, "printDevice() writes the same text");
+	benchCheck(strstr(formatted, "Fault codes (0121):  22FF") != NULL && strstr(formatted, "Bit  9:Solar input overvoltage TRUE") != NULL,
+		"bit flags decoded");
+
+	char small[64];
+	benchCheck(reader.formatDevice(0, small, sizeof(small)) == reader.formatDevice(0, formatted, sizeof(formatted)) && strlen(small) == sizeof(small) - 1
+		&& memcmp(small, formatted, sizeof(small) - 1) == 0, "short buffer is cut off and terminated, and still reports the full length");
+
+	int jsonLength = reader.formatDevices(formatted, sizeof(formatted), BT2_FORMAT_JSON);
+	char * secondLine = strchr(formatted, '\n') + 1;
+	benchCheck(jsonLength < (int)sizeof(formatted) && benchGetIsJsonLine(formatted, secondLine - formatted)
+		&& benchGetIsJsonLine(secondLine, formatted + jsonLength - secondLine), "JSON mode is a line per device");
+	benchCheck(strstr(secondLine, "{\"address\":\"0101\",\"name\":\"Battery voltage\",\"value\":796.7}") != NULL
+		&& strstr(secondLine, "\"profile\":\"Rover\"") != NULL, "JSON values are scaled");
+	benchCheck(strstr(secondLine, "\"flags\":[\"Anti-reverse MOSFET short circuit\",\"Solar input overvoltage\"") != NULL, "JSON lists the flags that are set");
+
+	uint8_t frame[DEFAULT_DATA_BUFFER_LENGTH];
+	int frameLength = benchBuildResponse(frame, RENOGY_CHARGING_MODE, 1, 5 - RENOGY_CHARGING_MODE * 31);	// value 5
+	reader.sendReadCommand(1, RENOGY_CHARGING_MODE, 1);
+	benchNotifyFrame(reader, 1, frame, frameLength);
+	reader.formatDevice(1, formatted, sizeof(formatted), BT2_FORMAT_JSON);
+	benchCheck(strstr(formatted, "\"value\":5,\"option\":\"Float charging\"}") != NULL, "option name found by value");
+	reader.formatDevice(1, formatted, sizeof(formatted));
+	benchCheck(strstr(formatted, "Charging state (0120): Option 5 (Float charging)\r\n") != NULL, "option name in text");
+	frameLength = benchBuildResponse(frame, RENOGY_CHARGING_MODE, 1, 0x8005 - RENOGY_CHARGING_MODE * 31);		// load on
+	reader.sendReadCommand(1, RENOGY_CHARGING_MODE, 1);
+	benchNotifyFrame(reader, 1, frame, frameLength);
+	reader.formatDevice(1, formatted, sizeof(formatted));
+	benchCheck(strstr(formatted, "Charging state (0120): Option 5 (Float charging)\r\n") != NULL, "Rover load bit is masked off the option");
+	reader.formatDevice(1, formatted, sizeof(formatted), BT2_FORMAT_JSON);
+	benchCheck(strstr(formatted, "\"value\":32773,\"option\":\"Float charging\"}") != NULL, "JSON keeps the raw option value");
+
+	char number[32];
+	char expected[32];
+	boolean numbersMatch = true;
+	for (int32_t raw = -32768; raw < 65536 && numbersMatch; raw++) {
+		BT2_FORMAT_BUFFER out = { number, sizeof(number), 0, 0, false };
+		if (raw < 32768) {																// RENOGY_SIGNED, 0.01
+			reader.putFormatNumber(&out, reader.getRoundedMilli((int16_t)raw * 10, 2), 7, 2);
+			snprintf(expected, sizeof(expected), "%7.2f", (float)(int16_t)raw * 0.01f);
+		} else {																		// RENOGY_VOLTS, 0.1
+			reader.putFormatNumber(&out, reader.getRoundedMilli(raw * 100, 1), 5, 1);
+			snprintf(expected, sizeof(expected), "%5.1f", (float)raw * 0.1f);
+		}
+		number[out.length] = 0;
+		numbersMatch = (strcmp(number, expected) == 0);
+	}
+	benchCheck(numbersMatch, "fixed point numbers print as printf prints the floats");
+
+	uint32_t logWrites;
+	benchCaptureSerial(printed, sizeof(printed), NULL, [&]() { reader.setLoggingLevel(BT2READER_VERBOSE); });
+	benchCaptureSerial(printed, sizeof(printed), &logWrites, [&]() { reader.log("%s\x01\n", "a log line with a control character "); });
+	reader.setLoggingLevel(BT2READER_QUIET);
+	benchCheck(logWrites == 1 && strcmp(printed, "BT2Reader: a log line with a control character  [0x01]\n") == 0, "log() is one write");
+
+	char note[128];
+	snprintf(note, sizeof(note), "%d bytes; %lu Serial writes through printRegister(), %lu through printDevice()",
+		formattedLength, (unsigned long)printWrites, (unsigned long)deviceWrites);
+	benchReport("dump of a DCC charger and a Rover", 0, note);
+	Serial.setOutput(NULL);
+	benchRun("printRegister() every register, 2 devices", 20000, benchPrintEveryRegister);
+	benchRun("printDevice() x2", 20000, [&]() { reader.printDevice(0); reader.printDevice(1); });
+	Serial.setOutput(stdout);
+	benchRun("formatDevices(), text", 20000, [&]() { benchSink += reader.formatDevices(formatted, sizeof(formatted)); });
+	benchRun("formatDevices(), JSON", 20000, [&]() { benchSink += reader.formatDevices(formatted, sizeof(formatted), BT2_FORMAT_JSON); });
+}
@@ -0,0 +1,79 @@
+#include "BT2Bench.h"
+
+#define BENCH_CONNECTION_INTERVAL_MILLIS	30
+#define BENCH_READ_MILLIS					60
+
+/** Answers reads until device 0 is ready or the link drops; returns connect-to-ready in ms, 0 if it dropped */
+static uint32_t benchWaitUntilReady(BenchReader & reader) {
+	uint8_t frame[DEFAULT_DATA_BUFFER_LENGTH];
+	for (int round = 0; round < 200; round++) {
+		reader.service();
+		if (reader.getConnectToReadyMillis(0) > 0) { return reader.getConnectToReadyMillis(0); }
+		if (Bluefruit.Connection(BENCH_CONNECTION_HANDLE) == NULL) {
+			reader.disconnectCallback(BENCH_CONNECTION_HANDLE, 0x16);
+			return 0;
+		}
+		nativeAdvanceMillis(BENCH_READ_MILLIS);
+		if (benchPendingReads[0].numberOfRegisters == 0) { continue; }
+		int frameLength = benchBuildResponse(frame, benchPendingReads[0].startRegister, benchPendingReads[0].numberOfRegisters, 0);
+		benchPendingReads[0].numberOfRegisters = 0;
+		benchNotifyFrame(reader, 0, frame, frameLength);
+	}
+	return 0;
+}
+
+/** Connect-to-ready with full discovery against cached handles, at a 30ms connection interval
+ */
+void benchGattCache() {
+	static BenchReader reader;
+	benchCaptureReads(reader);
+	Bluefruit.nativeRoundTripMillis = BENCH_CONNECTION_INTERVAL_MILLIS;
+	static BT2ReadPlan plan;
+	plan.addRegisters(RENOGY_AUX_BATT_SOC, 10);
+	plan.build();
+
+	uint32_t roundTrips = Bluefruit.nativeRoundTrips;
+	benchConnectDevices(reader, 1);											// first connection discovers
+	uint32_t coldRoundTrips = Bluefruit.nativeRoundTrips - roundTrips;
+	reader.setReadPlan(&plan);
+	uint32_t cold = benchWaitUntilReady(reader);
+
+	roundTrips = Bluefruit.nativeRoundTrips;
+	uint32_t writes = Bluefruit.nativeGattWrites;
+	benchReconnect(reader, 0);
+	uint32_t warmRoundTrips = Bluefruit.nativeRoundTrips - roundTrips;
+	benchCheck(reader.getIsGattFromCache(0) && Bluefruit.nativeGattWrites == writes + 1, "reconnect binds cached handles and writes the CCCD");
+	uint32_t warm = benchWaitUntilReady(reader);
+	benchCheck(warm > 0 && !reader.getIsGattFromCache(0), "cached handles proven by the first response");
+
+	char note[128];
+	snprintf(note, sizeof(note), "discovery %lums (%lu round trips), cached %lums (%lu) at %dms interval",
+		(unsigned long)cold, (unsigned long)coldRoundTrips, (unsigned long)warm, (unsigned long)warmRoundTrips, BENCH_CONNECTION_INTERVAL_MILLIS);
+	benchReport("connect to ready", 0, note);
+	benchCheck(warm < cold && warmRoundTrips == 0, "cached handles skip discovery");
+
+	Bluefruit.nativeHandleOffset = 2;										// the BT2's firmware moved its attributes
+	Serial.setOutput(NULL);
+	benchReconnect(reader, 0);
+	uint32_t stale = benchWaitUntilReady(reader);
+	Serial.setOutput(stdout);
+	benchCheck(stale == 0, "stale handles time out and drop the link");
+	Bluefruit.nativeConnect(BENCH_CONNECTION_HANDLE, reader.deviceTable[0].peerAddress, "BT-TH-BENCH000");
+	reader.connectCallback(BENCH_CONNECTION_HANDLE);
+	benchCheck(!reader.getIsGattFromCache(0) && benchWaitUntilReady(reader) > 0, "reconnect after stale handles rediscovers");
+
+	uint32_t now = millis();
+	for (int i = 0; i < MAXIMUM_BT2_DEVICES; i++) {							// a full cache, slot 5 used longest ago
+		memset(reader.gattHandles[i].peerAddress, 0xA0 + i, 6);
+		reader.gattHandles[i].lastUsedMillis = now - (i == 5 ? 90000 : 1000 * i);
+	}
+	reader.rememberGattHandles(&reader.deviceTable[0]);
+	benchCheck(memcmp(reader.gattHandles[5].peerAddress, reader.deviceTable[0].peerAddress, 6) == 0
+		&& reader.gattHandles[0].peerAddress[0] == 0xA0, "a full cache replaces the least recently used entry");
+
+	reader.setReadPlan(NULL);
+	reader.service();
+	Bluefruit.nativeHandleOffset = 0;
+	Bluefruit.nativeRoundTripMillis = 0;
+	BLEClientCharacteristic::nativeWriteHook = NULL;
+}
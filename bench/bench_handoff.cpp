@@ -0,0 +1,91 @@
+#include "BT2Bench.h"
+#include <atomic>
+#include <thread>
+
+#define BENCH_HANDOFF_FRAMES			100000
+
+/** Every register in the frame carries the same sequence number, so a reader that sees two different values in
+ * one frame's registers has seen a half-written frame
+ */
+static int benchBuildSequenceFrame(uint8_t * frame, uint16_t sequence) {
+	frame[0] = 0xFF;
+	frame[1] = 0x03;
+	frame[2] = 0x23 * 2;
+	for (int i = 0; i < 0x23; i++) {
+		frame[3 + i * 2] = sequence >> 8;
+		frame[4 + i * 2] = sequence & 0xFF;
+	}
+	int length = 3 + 0x23 * 2;
+	uint16_t checksum = benchReferenceChecksum(frame, length);
+	frame[length++] = checksum & 0xFF;
+	frame[length++] = checksum >> 8;
+	return length;
+}
+
+/** A producer thread plays the BLE task, sending reads and feeding notifications as fast as it can, while this
+ * thread plays loop(), reading the first and last register of the 0x0100 block and checking they match
+ */
+void benchFrameHandoff() {
+	static BenchReader reader;
+	BLEClientCharacteristic::nativeWriteHook = NULL;
+	benchConnectDevices(reader, 1);
+	DEVICE * device = &reader.deviceTable[0];
+	constexpr int first = findRegisterValueIndex(RENOGY_AUX_BATT_SOC);
+	constexpr int last = findRegisterValueIndex(0x0100 + 0x22);
+
+	std::atomic<boolean> done(false);
+	std::thread producer([&]() {
+		uint8_t frame[DEFAULT_DATA_BUFFER_LENGTH];
+		for (uint32_t i = 1; i <= BENCH_HANDOFF_FRAMES; i++) {
+			int frameLength = benchBuildSequenceFrame(frame, (uint16_t)i);
+			reader.sendReadCommand(0, 0x0100, 0x23);
+			benchNotifyFrame(reader, 0, frame, frameLength);
+			if (i % 2 == 0) { std::this_thread::yield(); }					// frames come ~100ms apart on a real link
+		}
+		done = true;
+	});
+
+	uint32_t reads = 0;
+	uint32_t torn = 0;
+	uint32_t framesSeen = 0;
+	uint16_t lastSequence = 0;
+	while (!done) {
+		reader.drainFrames(device);
+		uint16_t a = device->registerValues[first];
+		uint16_t b = device->registerValues[last];
+		torn += (a != b);
+		if (a != lastSequence) { framesSeen++; lastSequence = a; }
+		reads++;
+		if (reads % 64 == 0) { std::this_thread::yield(); }
+	}
+	producer.join();
+	reader.drainFrames(device);
+
+	BT2_STATS stats;
+	reader.getStats(0, &stats);
+	char note[128];
+	snprintf(note, sizeof(note), "%lu frames, %lu reads, %lu torn, %lu dropped with the ring full",
+		(unsigned long)stats.framesCompleted, (unsigned long)reads, (unsigned long)torn, (unsigned long)stats.framesDropped);
+	benchReport("notifyCallback thread -> loop() handoff", 0, note);
+	benchCheck(torn == 0, "loop() never sees a half-written frame");
+	benchCheck(stats.framesCompleted == BENCH_HANDOFF_FRAMES && framesSeen > 0, "every frame completes across threads");
+	benchCheck(device->registerValues[first] == (uint16_t)BENCH_HANDOFF_FRAMES || stats.framesDropped > 0, "last frame decoded unless dropped");
+
+	static BT2RegisterHistory history;											// loop() lagging: two frames drained together
+	reader.addHistory(0, RENOGY_AUX_BATT_SOC, &history);
+	uint8_t frame[DEFAULT_DATA_BUFFER_LENGTH];
+	uint32_t receivedMillis[2];
+	for (int i = 0; i < 2; i++) {
+		int frameLength = benchBuildSequenceFrame(frame, (uint16_t)(i + 1));
+		reader.sendReadCommand(0, 0x0100, 0x23);
+		benchNotifyFrame(reader, 0, frame, frameLength);
+		receivedMillis[i] = millis();
+		nativeAdvanceMillis(1000);
+	}
+	nativeAdvanceMillis(5000);
+	uint32_t updateMillis = reader.getRegister(0, RENOGY_AUX_BATT_SOC).lastUpdateMillis;
+	int sample = 0;
+	boolean stamped = true;
+	history.forEachSample([&](uint32_t sampleMillis, uint16_t value) { stamped = stamped && sample < 2 && sampleMillis == receivedMillis[sample++]; });
+	benchCheck(updateMillis == receivedMillis[1] && stamped && sample == 2, "frames keep the time they arrived, not the time they were drained");
+}
@@ -0,0 +1,105 @@
+#include "BT2Bench.h"
+#include <math.h>
+
+/** Sample series a BT2 actually produces, polled once a second with BLE jitter */
+static uint16_t benchHistoryValue(int series, uint32_t i) {
+	switch (series) {
+		case 0: return 133;															// battery voltage at float
+		case 1: return (uint16_t)(400 + 300 * sin(i / 600.0) + (rand() % 5));	// solar watts over a cloudy hour
+		default: return (uint16_t)rand();										// worst case, uncorrelated
+	}
+}
+
+static uint32_t benchHistoryMillis(uint32_t i, uint32_t startMillis) {
+	return startMillis + i * 1000 + (rand() % 41) - 20;
+}
+
+void benchHistory() {
+	static BT2RegisterHistory history;
+	const char * seriesNames[3] = { "constant", "solar power", "random" };
+	char note[80];
+	snprintf(note, sizeof(note), "%d bytes RAM per register, %d data", (int)sizeof(BT2RegisterHistory), BT2_HISTORY_BLOCKS * BT2_HISTORY_BLOCK_BYTES);
+	benchReport("sizeof(BT2RegisterHistory)", 0, note);
+
+	for (int series = 0; series < 3; series++) {
+		srand(series + 1);
+		history.clear();
+		uint32_t startMillis = 0xFFFFFFFF - 30000;								// crosses millis() rollover
+		uint32_t sampleMillis[4096];
+		uint16_t values[4096];
+		uint32_t appended = 0;
+		while (history.getSampleCount() == appended && appended < 4096) {		// until the ring first drops a block
+			sampleMillis[appended] = benchHistoryMillis(appended, startMillis);
+			values[appended] = benchHistoryValue(series, appended);
+			history.append(sampleMillis[appended], values[appended]);
+			appended++;
+		}
+		uint32_t held = history.getSampleCount();
+		uint32_t first = appended - held;
+		uint32_t mismatches = 0;
+		uint32_t position = first;
+		uint32_t now = sampleMillis[appended - 1];								// when the last sample was appended, not its decoded time
+		history.forEachSample([&](uint32_t t, uint16_t v) {
+			if (position >= appended || (uint32_t)abs((int32_t)(t - sampleMillis[position])) > BT2_HISTORY_TICK_MILLIS / 2 || v != values[position]) { mismatches++; }
+			if (position < appended) { sampleMillis[position] = t; }			// compare windows on decoded time from here on
+			position++;
+		});
+		benchCheck(mismatches == 0 && position == appended, "history decodes what was appended");
+
+		uint32_t windowMillis = 60000;
+		uint32_t samples = 0;
+		uint16_t minimum = 0xFFFF;
+		uint16_t maximum = 0;
+		double total = 0;
+		for (uint32_t i = first; i < appended; i++) {
+			if ((int32_t)(now - sampleMillis[i]) > (int32_t)windowMillis) { continue; }
+			samples++;
+			minimum = min(minimum, values[i]);
+			maximum = max(maximum, values[i]);
+			total += values[i];
+		}
+		BT2_HISTORY_SUMMARY summary;
+		boolean found = history.getSummary(now, windowMillis, &summary);
+		benchCheck(found && summary.samples == samples && summary.minimum == minimum && summary.maximum == maximum
+				&& fabs(summary.mean - total / samples) < 0.01, "window min/max/mean");
+
+		snprintf(note, sizeof(note), "%lu samples in %d bytes, %.2f bytes/sample (raw 6)", (unsigned long)held, history.getBytesUsed(), (double)history.getBytesUsed() / held);
+		char name[64];
+		snprintf(name, sizeof(name), "history capacity, %s", seriesNames[series]);
+		benchReport(name, 0, note);
+	}
+
+	history.clear();
+	history.append(1000, 10);
+	history.append(1051, 20);														// stored as 1100
+	BT2_HISTORY_SUMMARY rounded;
+	benchCheck(history.getSummary(1060, 60000, &rounded) && rounded.samples == 2, "a sample rounded past now is still in the window");
+
+	srand(2);
+	history.clear();
+	uint32_t i = 0;
+	benchRun("BT2RegisterHistory::append (solar power)", 5000000, [&]() {
+		history.append(benchHistoryMillis(i, 0), (uint16_t)(400 + (i & 0x3F)));
+		i++;
+	});
+	BT2_HISTORY_SUMMARY summary;
+	benchRun("BT2RegisterHistory::getSummary (full ring)", 200000, [&]() {
+		history.getSummary(benchHistoryMillis(i, 0), 0xFFFFFFFF, &summary);
+		benchSink += summary.samples;
+	});
+
+	static BenchReader reader;
+	static BT2RegisterHistory solarWatts;
+	benchConnectDevices(reader, 1);
+	benchCheck(reader.addHistory(0, RENOGY_SOLAR_POWER, &solarWatts) && !reader.addHistory(0, 0x7FFF, &history), "addHistory");
+	uint8_t frame[DEFAULT_DATA_BUFFER_LENGTH];
+	int frameLength = benchBuildResponse(frame, 0x0100, 10, 0);
+	for (int j = 0; j < 3; j++) {
+		reader.sendReadCommand(0, 0x0100, 10);
+		benchNotifyFrame(reader, 0, frame, frameLength);
+		reader.service();														// frames are decoded on the loop() side
+		nativeAdvanceMillis(1000);
+	}
+	benchCheck(reader.getHistory(0, RENOGY_SOLAR_POWER) == &solarWatts && solarWatts.getSampleCount() == 3
+			&& solarWatts.getSummary(millis(), 10000, &summary) && summary.minimum == reader.getRegisterValue(0, RENOGY_SOLAR_POWER), "history recorded from frames");
+}
@@ -0,0 +1,103 @@
+#include "BT2Bench.h"
+#include <InternalFileSystem.h>
+#include <unistd.h>
+
+/** Connects device 0 and answers its poll schedule until the 0x0100 block arrives; returns the milliseconds taken
+ */
+static uint32_t benchTimeToFirstLiveSample(BenchReader & reader) {
+	Bluefruit.nativeConnect(BENCH_CONNECTION_HANDLE, reader.deviceTable[0].peerAddress, "BT-TH-BENCH000");
+	reader.connectCallback(BENCH_CONNECTION_HANDLE);
+	uint8_t frame[DEFAULT_DATA_BUFFER_LENGTH];
+	for (int round = 1; round < 100; round++) {
+		reader.service();
+		nativeAdvanceMillis(BENCH_LINK_LATENCY_MILLIS);
+		if (benchPendingReads[0].numberOfRegisters == 0) { continue; }
+		uint16_t start = benchPendingReads[0].startRegister;
+		int frameLength = benchBuildResponse(frame, start, benchPendingReads[0].numberOfRegisters, 0);
+		benchPendingReads[0].numberOfRegisters = 0;
+		benchNotifyFrame(reader, 0, frame, frameLength);
+		if (start <= RENOGY_SOLAR_POWER && start >= RENOGY_AUX_BATT_SOC) { return round * BENCH_LINK_LATENCY_MILLIS; }
+	}
+	return 0;
+}
+
+/** Answers reads for the given time, as benchTimeToFirstLiveSample does */
+static void benchAnswerReads(BenchReader & reader, uint32_t millis) {
+	uint8_t frame[DEFAULT_DATA_BUFFER_LENGTH];
+	for (uint32_t elapsed = 0; elapsed < millis; elapsed += BENCH_LINK_LATENCY_MILLIS) {
+		reader.service();
+		nativeAdvanceMillis(BENCH_LINK_LATENCY_MILLIS);
+		if (benchPendingReads[0].numberOfRegisters == 0) { continue; }
+		int frameLength = benchBuildResponse(frame, benchPendingReads[0].startRegister, benchPendingReads[0].numberOfRegisters, 0);
+		benchPendingReads[0].numberOfRegisters = 0;
+		benchNotifyFrame(reader, 0, frame, frameLength);
+	}
+	reader.service();
+}
+
+void benchIdentityCache() {
+	char root[] = "/tmp/bt2bench-internalfs-XXXXXX";
+	if (mkdtemp(root) == NULL) {
+		benchCheck(false, "temporary directory for InternalFS");
+		return;
+	}
+	InternalFS.nativeSetRoot(root);
+
+	static BenchReader reader;
+	benchConnectDevices(reader, 1);
+	reader.disconnectCallback(BENCH_CONNECTION_HANDLE, 0x13);
+	benchCaptureReads(reader);
+	static BT2PollSchedule schedule;
+	schedule.addDefaultGroups();
+	reader.setPollSchedule(&schedule);
+	benchCheck(reader.beginIdentityCache(), "beginIdentityCache");
+
+	uint32_t cold = benchTimeToFirstLiveSample(reader);
+	benchAnswerReads(reader, 2000);
+	benchCheck(!reader.getIsIdentityFromCache(0), "cold start reads identity");
+	char model[17];
+	strcpy(model, reader.getProductModel(0));
+	reader.disconnectCallback(BENCH_CONNECTION_HANDLE, 0x13);
+	benchAnswerReads(reader, 100);
+
+	memset(reader.deviceTable[0].registerValues, 0, REGISTER_VALUE_SIZE * sizeof(uint16_t));
+	memset(reader.deviceTable[0].frameRuns, 0, sizeof(reader.deviceTable[0].frameRuns));
+	uint32_t warm = benchTimeToFirstLiveSample(reader);
+	benchCheck(reader.getIsIdentityFromCache(0) && strcmp(reader.getProductModel(0), model) == 0 && reader.getRegisterValue(0, RENOGY_AUX_BATT_TYPE) != 0,
+		"warm start serves identity from cache");
+	benchAnswerReads(reader, BT2_CACHE_REVALIDATE_MILLIS + 1000);
+	benchCheck(!reader.getIsIdentityFromCache(0), "cached identity revalidated in the background");
+
+	char note[80];
+	snprintf(note, sizeof(note), "cold %lums, warm %lums (%dms link)", (unsigned long)cold, (unsigned long)warm, BENCH_LINK_LATENCY_MILLIS);
+	benchReport("connect to first live sample, identity cache", 0, note);
+	benchCheck(warm < cold, "warm start gets live data sooner");
+
+	char path[32];
+	snprintf(path, sizeof(path), "/bt2/%02x%02x%02x%02x%02x%02x.bin", 0x60, 0x50, 0x40, 0x30, 0x20, 0x10);
+	Adafruit_LittleFS_Namespace::File file(InternalFS);
+	file.open(path, FILE_O_WRITE);
+	file.write((const uint8_t *)"x", 1);									// appended, so the CRC no longer matches
+	file.close();
+	reader.disconnectCallback(BENCH_CONNECTION_HANDLE, 0x13);
+	benchAnswerReads(reader, 100);
+	Serial.setOutput(NULL);
+	Bluefruit.nativeConnect(BENCH_CONNECTION_HANDLE, reader.deviceTable[0].peerAddress, "BT-TH-BENCH000");
+	reader.connectCallback(BENCH_CONNECTION_HANDLE);
+	Serial.setOutput(stdout);
+	benchCheck(!reader.getIsIdentityFromCache(0), "corrupt cache file is ignored");
+	benchAnswerReads(reader, 2000);											// re-read and rewritten
+
+	benchRun("loadIdentityCache", 20000, [&]() { benchSink += reader.loadIdentityCache(&reader.deviceTable[0]); });
+
+	reader.clearIdentityCache(0);
+	benchCheck(!InternalFS.exists(path), "clearIdentityCache");
+	reader.disconnectCallback(BENCH_CONNECTION_HANDLE, 0x13);
+	reader.setPollSchedule(NULL);
+	benchAnswerReads(reader, 100);
+	BLEClientCharacteristic::nativeWriteHook = NULL;
+	char directory[64];
+	InternalFS.nativeGetPath("/bt2", directory, sizeof(directory));
+	rmdir(directory);
+	rmdir(root);
+}
@@ -0,0 +1,30 @@
+#include "BT2Bench.h"
+
+int main() {
+	printf("BT2Reader native benchmarks\n");
+	printf("---------------------------\n");
+
+	benchCoreHotPaths();
+	benchReadPlan();
+	benchRequestQueue();
+	benchParallelPolling();
+	benchTypedValues();
+	benchHistory();
+	benchSubscriptions();
+	benchPollSchedule();
+	benchIdentityCache();
+	benchGattCache();
+	benchAdvertStorm();
+	benchLinkStats();
+	benchFrameHandoff();
+	benchStaticReaderStorage();
+	benchRegisterProfiles();
+	benchProfileDetection();
+	benchSnapshots();
+	benchFormatter();
+	benchAlarmEvents();
+	benchEnergyIntegration();
+
+	printf("\n%s\n", benchFailures == 0 ? "All checks passed" : "CHECKS FAILED");
+	return (benchFailures == 0 ? 0 : 1);
+}
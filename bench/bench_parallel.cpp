@@ -0,0 +1,63 @@
+#include "BT2Bench.h"
+
+static BenchReader * benchParallelReader = NULL;
+
+/** One link round trip: service() sends a read to every idle device, then every BT2 answers
+ */
+static int benchParallelRound(int numberOfDevices) {
+	uint8_t frame[DEFAULT_DATA_BUFFER_LENGTH];
+	int answered = 0;
+	benchParallelReader->service();
+	for (int i = 0; i < numberOfDevices; i++) {
+		if (benchPendingReads[i].numberOfRegisters == 0) { continue; }
+		int frameLength = benchBuildResponse(frame, benchPendingReads[i].startRegister, benchPendingReads[i].numberOfRegisters, i);
+		benchPendingReads[i].numberOfRegisters = 0;
+		benchNotifyFrame(*benchParallelReader, i, frame, frameLength);
+		answered++;
+	}
+	return answered;
+}
+
+/** Polls a read plan on 8 simulated devices with a 100ms link round trip and reports per-device frames/s
+ */
+void benchParallelPolling() {
+	static BenchReader reader;
+	benchParallelReader = &reader;
+	benchConnectDevices(reader, MAXIMUM_BT2_DEVICES);
+	benchCaptureReads(reader);
+
+	static BT2ReadPlan plan;
+	plan.addRegisterMap();
+	plan.build();
+	reader.setReadPlan(&plan);
+
+	uint32_t rounds = 0;
+	uint32_t framesAnswered = 0;
+	nativeAdvanceMillis(1000);
+	benchParallelRound(MAXIMUM_BT2_DEVICES);
+	for (int second = 0; second < 3; second++) {
+		for (int i = 0; i < 1000 / BENCH_LINK_LATENCY_MILLIS; i++) {
+			nativeAdvanceMillis(BENCH_LINK_LATENCY_MILLIS);
+			framesAnswered += benchParallelRound(MAXIMUM_BT2_DEVICES);
+			rounds++;
+		}
+	}
+	benchParallelReader->service();
+
+	char note[80];
+	float totalFramesPerSecond = 0;
+	for (int i = 0; i < MAXIMUM_BT2_DEVICES; i++) { totalFramesPerSecond += reader.getFramesPerSecond(i); }
+	snprintf(note, sizeof(note), "%d devices: %.1f frames/s each, %.1f total (%dms link)", MAXIMUM_BT2_DEVICES,
+		reader.getFramesPerSecond(0), totalFramesPerSecond, BENCH_LINK_LATENCY_MILLIS);
+	benchReport("read plan polling, one read in flight per device", 0, note);
+	benchCheck(framesAnswered == rounds * MAXIMUM_BT2_DEVICES, "every device has a read in flight every round");
+	benchCheck(reader.getFramesPerSecond(MAXIMUM_BT2_DEVICES - 1) > 9.0f, "each device sustains one frame per link round trip");
+
+	benchRun("service + 8 device round (8 frames from the register map plan)", 20000, [&]() {
+		benchSink += benchParallelRound(MAXIMUM_BT2_DEVICES);
+	});
+
+	reader.setReadPlan(NULL);
+	benchParallelRound(MAXIMUM_BT2_DEVICES);
+	BLEClientCharacteristic::nativeWriteHook = NULL;
+}
@@ -0,0 +1,157 @@
+#include "BT2Bench.h"
+
+/** Broken tables the register map checks must reject; BT2_REGISTER_MAP static_asserts on the same functions
+ */
+constexpr REGISTER_DESCRIPTION benchUnsortedMap[] = { {0x0101, 2, "b", RENOGY_DECIMAL, 1}, {0x0100, 2, "a", RENOGY_DECIMAL, 1} };
+constexpr REGISTER_DESCRIPTION benchOverlappingMap[] = { {0x0100, 4, "a", RENOGY_DECIMAL, 1}, {0x0101, 2, "b", RENOGY_DECIMAL, 1} };
+constexpr REGISTER_DESCRIPTION benchWideFlagsMap[] = { {RENOGY_ERROR_FLAGS_1, 4, "a", RENOGY_BIT_FLAGS, 1} };
+constexpr RENOGY_BIT_FLAG_TABLE benchScatteredFlags[] = { {RENOGY_ERROR_FLAGS_1, 0, "a"}, {RENOGY_ERROR_FLAGS_2, 0, "b"}, {RENOGY_ERROR_FLAGS_1, 1, "c"} };
+constexpr RENOGY_BIT_FLAG_TABLE benchUndescribedFlags[] = { {RENOGY_SOLAR_POWER, 0, "a"} };
+constexpr RENOGY_OPTIONS_TABLE benchRepeatedOptions[] = { {RENOGY_AUX_BATT_TYPE, 8, "a"}, {RENOGY_AUX_BATT_TYPE, 8, "b"} };
+
+static_assert(!getIsRegisterMapSorted(benchUnsortedMap, 2), "unsorted register map accepted");
+static_assert(!getIsRegisterMapSorted(benchOverlappingMap, 2), "overlapping register map accepted");
+static_assert(!getIsRegisterMapWellFormed(benchWideFlagsMap, 1), "two register bit flags accepted");
+static_assert(!getIsBitFlagTableValid(benchScatteredFlags, 3, registerDescription, REGISTER_DESCRIPTION_SIZE), "ungrouped bit flags accepted");
+static_assert(!getIsBitFlagTableValid(benchUndescribedFlags, 1, registerDescription, REGISTER_DESCRIPTION_SIZE), "bit flags on a non flag register accepted");
+static_assert(!getIsOptionTableValid(benchRepeatedOptions, 2, registerDescription, REGISTER_DESCRIPTION_SIZE), "repeated option accepted");
+static_assert(BT2_REGISTER_MAP_ROVER::findValueIndex(RENOGY_TOTAL_GENERATION) >= 0 && BT2_REGISTER_MAP_ROVER::findValueIndex(0x010A) < 0, "Rover index");
+
+static uint8_t benchLastCommandAddress = 0;
+
+static void benchCaptureCommand(BLEClientCharacteristic * chr, const uint8_t * data, uint16_t len) { benchLastCommandAddress = data[0]; }
+
+/** Rewrites a benchBuildResponse frame as coming from another Modbus address */
+static void benchSetFrameAddress(uint8_t * frame, int frameLength, uint8_t address) {
+	frame[0] = address;
+	uint16_t checksum = benchReferenceChecksum(frame, frameLength - 2);
+	frame[frameLength - 2] = checksum & 0xFF;
+	frame[frameLength - 1] = checksum >> 8;
+}
+
+static boolean benchGetIsPlanCovering(BT2ReadPlan & plan, const BT2_REGISTER_PROFILE * profile) {
+	for (int i = 0; i < profile->descriptionSize; i++) {
+		uint16_t address = profile->descriptions[i].address;
+		if (address == INVALID_REGISTER) { continue; }
+		boolean covered = false;
+		for (int c = 0; c < plan.getCommandCount(); c++) {
+			const RENOGY_COMMANDS * command = plan.getCommand(c);
+			if ((uint16_t)(address - command->startRegister) + profile->descriptions[i].bytesUsed / 2 <= command->numberOfRegisters) { covered = true; }
+		}
+		if (!covered) { return false; }
+	}
+	return true;
+}
+
+/** What each profile costs per device and per refresh, reading a Rover and a smart battery through their profiles,
+ * and frame decode cost bound to DCC against Rover
+ */
+void benchRegisterProfiles() {
+	const BT2_REGISTER_PROFILE * profiles[] = { &BT2_REGISTER_MAP_DCC::profile, &BT2_REGISTER_MAP_ROVER::profile,
+		&BT2_REGISTER_MAP_SMART_BATTERY::profile, &BT2_REGISTER_MAP_INVERTER::profile };
+	for (const BT2_REGISTER_PROFILE * profile : profiles) {
+		BT2ReadPlan plan;
+		benchCheck(plan.addRegisterMap(profile), "read plan has room for the profile");
+		plan.build();
+		benchCheck(benchGetIsPlanCovering(plan, profile), "read plan covers every register in the profile");
+		benchCheck(countRegisterValueSlots(profile->descriptions, profile->descriptionSize) == profile->valueSize, "profile value slots");
+		char name[64];
+		char note[96];
+		snprintf(name, sizeof(name), "profile %s", profile->name);
+		snprintf(note, sizeof(note), "%d registers, %d value bytes/device, %d reads/%d registers per refresh", profile->descriptionSize,
+			profile->valueSize * (int)sizeof(uint16_t), plan.getCommandCount(), plan.getRegistersRead());
+		benchReport(name, 0, note);
+	}
+
+	static BenchReader reader;
+	benchConnectDevices(reader, 2);
+	DEVICE * rover = &reader.deviceTable[0];
+	benchCheck(reader.setRegisterProfile(0, &BT2_REGISTER_MAP_ROVER::profile) && reader.getRegisterProfile(0) == &BT2_REGISTER_MAP_ROVER::profile
+		&& reader.getRegisterProfile(1) == &BT2_REGISTER_MAP_DCC::profile, "setRegisterProfile binds one device");
+	uint8_t frame[DEFAULT_DATA_BUFFER_LENGTH];
+	int frameLength = benchBuildResponse(frame, 0x0100, 0x22, 5);
+	reader.sendReadCommand(0, 0x0100, 0x22);
+	benchNotifyFrame(reader, 0, frame, frameLength);
+	uint16_t loadPower = frame[3 + 2 * (RENOGY_LOAD_POWER - 0x0100)] * 256 + frame[4 + 2 * (RENOGY_LOAD_POWER - 0x0100)];
+	int generation = 3 + 2 * (RENOGY_TOTAL_GENERATION - 0x0100);
+	int64_t totalGeneration = ((uint32_t)frame[generation] << 24) | (frame[generation + 1] << 16) | (frame[generation + 2] << 8) | frame[generation + 3];
+	benchCheck(reader.getRegisterValue(0, RENOGY_LOAD_POWER) == loadPower && reader.getWatts(0, RENOGY_LOAD_POWER) == loadPower, "Rover load power");
+	benchCheck(reader.getScaledValue(0, RENOGY_TOTAL_GENERATION) == getSaturatedMilli(totalGeneration * 1000) && reader.getRawValue(0, RENOGY_TOTAL_GENERATION) == totalGeneration,
+		"Rover 32 bit total");
+	uint8_t largeFrame[DEFAULT_DATA_BUFFER_LENGTH];
+	int largeLength = benchBuildResponse(largeFrame, RENOGY_TOTAL_GENERATION, 2, 0);
+	const uint8_t largeTotal[4] = { 0xB2, 0xD0, 0x5E, 0x00 };							// 3,000,000,000 Wh
+	memcpy(&largeFrame[3], largeTotal, 4);
+	uint16_t largeChecksum = benchReferenceChecksum(largeFrame, largeLength - 2);
+	largeFrame[largeLength - 2] = largeChecksum & 0xFF;
+	largeFrame[largeLength - 1] = largeChecksum >> 8;
+	reader.sendReadCommand(0, RENOGY_TOTAL_GENERATION, 2);
+	benchNotifyFrame(reader, 0, largeFrame, largeLength);
+	benchCheck(reader.getRawValue(0, RENOGY_TOTAL_GENERATION) == 3000000000LL && reader.getScaledValue(0, RENOGY_TOTAL_GENERATION) == INT32_MAX
+		&& reader.getScaledValue<RENOGY_TOTAL_GENERATION, BT2_REGISTER_MAP_ROVER>(0) == INT32_MAX, "a counter past 2^31 is whole raw and saturates scaled");
+	benchCheck(reader.getRegister(0, 0x010A).registerAddress == INVALID_REGISTER, "register outside the profile isn't stored");
+	benchCheck(reader.getScaledValue<RENOGY_AUX_BATT_VOLTAGE>(0) == reader.getScaledValue<RENOGY_AUX_BATT_VOLTAGE, BT2_REGISTER_MAP_ROVER>(0)
+		&& reader.getScaledValue<RENOGY_AUX_BATT_VOLTAGE>(0) == reader.getMillivolts(0, RENOGY_AUX_BATT_VOLTAGE), "compile time getter follows the bound profile");
+	Serial.setOutput(NULL);
+	benchCheck(reader.printRegister(rover, RENOGY_FAULT_FLAGS) == 1 && reader.printRegister(rover, RENOGY_TOTAL_CHARGE_AMP_HOURS) == 2, "Rover registers print");
+	Serial.setOutput(stdout);
+
+	benchCheck(reader.setRegisterProfile(1, &BT2_REGISTER_MAP_SMART_BATTERY::profile), "bind a smart battery");
+	BLEClientCharacteristic::nativeWriteHook = benchCaptureCommand;
+	reader.sendReadCommand(1, RENOGY_BATTERY_CURRENT, 2);
+	BLEClientCharacteristic::nativeWriteHook = NULL;
+	benchCheck(benchLastCommandAddress == MODBUS_ADDRESS_SMART_BATTERY, "battery commands go to its Modbus address");
+	frameLength = benchBuildResponse(frame, RENOGY_BATTERY_CURRENT, 2, 0);
+	frame[3] = 0xFF; frame[4] = 0x38;														// -2.00 A
+	benchNotifyFrame(reader, 1, frame, frameLength);										// still from 0xFF: ignored
+	benchCheck(!reader.getIsNewDataAvailable(1), "a frame from the wrong Modbus address is ignored");
+	benchSetFrameAddress(frame, frameLength, MODBUS_ADDRESS_SMART_BATTERY);
+	benchNotifyFrame(reader, 1, frame, frameLength);
+	benchCheck(reader.getIsNewDataAvailable(1) && reader.getScaledValue(1, RENOGY_BATTERY_CURRENT) == -2000
+		&& reader.getMilliamps(1, RENOGY_BATTERY_CURRENT) == -2000 && reader.getMillivolts(1, RENOGY_BATTERY_CURRENT) == 0, "signed battery current is in milliamps");
+	char formatted[1024];
+	reader.formatDevice(1, formatted, sizeof(formatted));
+	benchCheck(strstr(formatted, "Battery current (Amps) (") != NULL && strstr(formatted, "): -2.00 Amps\r\n") != NULL, "signed current prints in Amps");
+
+	static BT2RegisterHistory batteryCurrent;
+	reader.addHistory(1, RENOGY_BATTERY_CURRENT, &batteryCurrent);
+	reader.subscribe(1, RENOGY_BATTERY_CURRENT, 500);
+	int changes = 0;
+	for (int k = 0; k < 4; k++) {															// +0.01 A, -0.01 A, ...
+		frameLength = benchBuildResponse(frame, RENOGY_BATTERY_CURRENT, 2, 0);
+		frame[3] = (k & 0x01) ? 0xFF : 0x00; frame[4] = (k & 0x01) ? 0xFF : 0x01;
+		benchSetFrameAddress(frame, frameLength, MODBUS_ADDRESS_SMART_BATTERY);
+		reader.sendReadCommand(1, RENOGY_BATTERY_CURRENT, 2);
+		benchNotifyFrame(reader, 1, frame, frameLength);
+		changes += reader.getIsRegisterChanged(1, RENOGY_BATTERY_CURRENT);
+		nativeAdvanceMillis(1000);
+	}
+	benchCheck(changes == 1, "a signed register moving across zero stays inside its deadband");
+	BT2_HISTORY_SUMMARY currentSummary;
+	benchCheck(batteryCurrent.getSummary(millis(), 60000, &currentSummary) && currentSummary.samples == 4 && currentSummary.minimum == -1
+		&& currentSummary.maximum == 1 && currentSummary.mean == 0, "a signed register's history summary is signed");
+
+	static StaticBT2Reader<1, BT2_REGISTER_MAP_SMART_BATTERY, BT2_REGISTER_MAP_SMART_BATTERY::valueSize> batteryReader;
+	batteryReader.begin();
+	benchCheck(batteryReader.getRegisterProfile(0) == &BT2_REGISTER_MAP_SMART_BATTERY::profile, "StaticBT2Reader binds its REGISTER_MAP");
+	Serial.setOutput(NULL);
+	benchCheck(!batteryReader.setRegisterProfile(0, &BT2_REGISTER_MAP_ROVER::profile), "a trimmed StaticBT2Reader refuses a larger profile");
+	Serial.setOutput(stdout);
+	char note[96];
+	snprintf(note, sizeof(note), "%d bytes, against %d for StaticBT2Reader<1>, which holds any profile", (int)sizeof(batteryReader), (int)sizeof(StaticBT2Reader<1>));
+	benchReport("sizeof(StaticBT2Reader<1>) trimmed to a smart battery", 0, note);
+
+	benchCheck(reader.setRegisterProfile(1, &BT2_REGISTER_MAP_DCC::profile), "bind back to DCC");
+	frameLength = benchBuildResponse(frame, 0x0100, 0x22, 7);
+	benchRun("notify + decode 0x0100 x 34, DCC profile", 500000, [&]() {
+		reader.sendReadCommand(1, 0x0100, 0x22);
+		benchNotifyFrame(reader, 1, frame, frameLength);
+		reader.drainFrames(&reader.deviceTable[1]);
+	});
+	benchRun("notify + decode 0x0100 x 34, Rover profile", 500000, [&]() {
+		reader.sendReadCommand(0, 0x0100, 0x22);
+		benchNotifyFrame(reader, 0, frame, frameLength);
+		reader.drainFrames(rover);
+	});
+	benchRun("getScaledValue(RENOGY_SOLAR_POWER), Rover profile", 5000000, [&]() { benchSink += reader.getScaledValue(0, RENOGY_SOLAR_POWER); });
+}
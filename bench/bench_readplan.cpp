@@ -0,0 +1,53 @@
+#include "BT2Bench.h"
+
+static boolean getIsPlanCovering(BT2ReadPlan & plan, uint16_t registerAddress) {
+	for (int i = 0; i < plan.getCommandCount(); i++) {
+		const RENOGY_COMMANDS * command = plan.getCommand(i);
+		if (registerAddress >= command->startRegister && registerAddress < command->startRegister + command->numberOfRegisters) { return true; }
+	}
+	return false;
+}
+
+/** Compares the round trips needed for a full refresh with the Renogy app's command list and with a built read plan
+ */
+void benchReadPlan() {
+	BT2ReadPlan plan;
+	int appCommands = sizeof(renogyCommands) / sizeof(renogyCommands[0]);
+	int appRegisters = 0;
+	for (int i = 0; i < appCommands; i++) {
+		plan.addRegisters(renogyCommands[i].startRegister, renogyCommands[i].numberOfRegisters);
+		appRegisters += renogyCommands[i].numberOfRegisters;
+	}
+	plan.build();
+	char note[96];
+	snprintf(note, sizeof(note), "renogyCommands: %d reads/%d registers -> %d reads/%d registers", 
+		appCommands, appRegisters, plan.getCommandCount(), plan.getRegistersRead());
+	for (int i = 0; i < appCommands; i++) {
+		for (int k = 0; k < renogyCommands[i].numberOfRegisters; k++) {
+			benchCheck(getIsPlanCovering(plan, renogyCommands[i].startRegister + k), "read plan covers every renogyCommands register");
+		}
+	}
+	benchRun("BT2ReadPlan::build (renogyCommands)", 1000000, [&]() { benchSink += plan.build(); }, note);
+
+	plan.clear();
+	plan.addRegisterMap();
+	plan.build();
+	snprintf(note, sizeof(note), "registerDescription: %d reads/%d registers", plan.getCommandCount(), plan.getRegistersRead());
+	for (int i = 1; i < REGISTER_DESCRIPTION_SIZE; i++) {
+		benchCheck(getIsPlanCovering(plan, registerDescription[i].address), "read plan covers every described register");
+	}
+	benchRun("BT2ReadPlan::addRegisterMap + build", 500000, [&]() {
+		plan.clear();
+		plan.addRegisterMap();
+		benchSink += plan.build();
+	}, note);
+
+	plan.clear();
+	plan.setGapTolerance(0);
+	plan.setMaximumRegistersPerRead(4);
+	plan.addRegisters(0x0100, 3);
+	plan.addRegisters(0x0102, 2);
+	plan.addRegisters(0x0105, 6);
+	benchCheck(plan.build() == 3 && plan.getCommand(1)->startRegister == 0x0105 && plan.getCommand(2)->numberOfRegisters == 2,
+		"overlaps merge, gaps respected, long ranges split");
+}
@@ -0,0 +1,53 @@
+#include "BT2Bench.h"
+
+static int benchCompletions = 0;
+static uint8_t benchLastStatus = BT2_REQUEST_UNKNOWN;
+
+static void benchRequestCallback(int deviceIndex, const BT2_REQUEST * request) {
+	benchCompletions++;
+	benchLastStatus = request->status;
+}
+
+/** Times a queued read through service(): queue, send, four notifications, completion callback
+ */
+void benchRequestQueue() {
+	static BenchReader reader;
+	benchConnectDevices(reader, 1);
+
+	uint8_t frame[DEFAULT_DATA_BUFFER_LENGTH];
+	int frameLength = benchBuildResponse(frame, 0x0100, 0x23, 11);
+
+	int requestId = reader.queueReadCommand(0, 0x0100, 0x23, benchRequestCallback, 1000);
+	benchCheck(reader.getRequestStatus(requestId) == BT2_REQUEST_QUEUED, "request queued");
+	reader.service();
+	benchCheck(reader.getRequestStatus(requestId) == BT2_REQUEST_SENT, "service() sends the request");
+	benchNotifyFrame(reader, 0, frame, frameLength);
+	reader.service();
+	benchCheck(benchCompletions == 1 && benchLastStatus == BT2_REQUEST_COMPLETE && reader.getRequestStatus(requestId) == BT2_REQUEST_COMPLETE,
+		"service() completes the request and runs its callback");
+
+	frame[10] ^= 0x01;
+	reader.queueReadCommand(0, 0x0100, 0x23, benchRequestCallback, 1000);
+	reader.service();
+	benchNotifyFrame(reader, 0, frame, frameLength);
+	reader.service();
+	benchCheck(benchLastStatus == BT2_REQUEST_CHECKSUM_ERROR, "corrupt frame completes with BT2_REQUEST_CHECKSUM_ERROR");
+	frame[10] ^= 0x01;
+
+	requestId = reader.queueReadCommand(0, 0x0100, 0x23, benchRequestCallback, 1000);
+	reader.service();
+	nativeAdvanceMillis(1001);
+	reader.service();
+	benchCheck(benchLastStatus == BT2_REQUEST_TIMEOUT && reader.getQueuedRequestCount(0) == 0, "unanswered request times out");
+	benchCheck(reader.queueReadCommand(0, 0x0100, 0) == -1 && reader.queueReadCommand(0, 0x0100, MAXIMUM_REGISTERS_PER_READ + 1) == -1
+		&& reader.getQueuedRequestCount(0) == 0, "reads of no registers, or more than fit in a frame, are refused");
+
+	benchRun("service() with nothing queued", 5000000, [&]() { reader.service(); });
+	benchRun("queueReadCommand + service + notifyCallback + service (0x23)", 500000, [&]() {
+		reader.queueReadCommand(0, 0x0100, 0x23, benchRequestCallback, 1000);
+		reader.service();
+		benchNotifyFrame(reader, 0, frame, frameLength);
+		reader.service();
+	});
+	benchCheck(reader.getQueuedRequestCount(0) == 0 && benchLastStatus == BT2_REQUEST_COMPLETE, "back-to-back requests all complete");
+}
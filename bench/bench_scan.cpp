@@ -0,0 +1,174 @@
+#include "BT2Bench.h"
+
+#define BENCH_ADVERTS					4096
+#define BENCH_ADVERT_DEVICES			4
+#define BENCH_ADVERTISERS				48			// distinct non-BT2 addresses in the storm
+
+/** A scan window in a busy place: mostly phones and beacons repeating every few hundred ms, a few named devices
+ * answering active scans, and every 32nd report a BT2 advertising FFD0 with Renogy's manufacturer ID
+ */
+struct BENCH_ADVERT {
+	ble_gap_evt_adv_report_t report;
+	uint8_t data[31];
+};
+
+static BENCH_ADVERT benchAdverts[BENCH_ADVERTS];
+
+static int benchAddField(uint8_t * data, int index, uint8_t type, const uint8_t * field, int fieldLength) {
+	data[index] = fieldLength + 1;
+	data[index + 1] = type;
+	memcpy(&data[index + 2], field, fieldLength);
+	return index + fieldLength + 2;
+}
+
+static void benchBuildAdverts() {
+	const uint8_t flags[1] = { 0x06 };
+	const uint8_t phone[12] = { 0x4C, 0x00, 0x10, 0x07, 0x3B, 0x1F, 0xA2, 0x55, 0x60, 0x18, 0x01, 0x02 };
+	const uint8_t beaconUuid[2] = { 0xAA, 0xFE };
+	const uint8_t beaconData[14] = { 0xAA, 0xFE, 0x10, 0x00, 0x03, 'e', 'x', 'a', 'm', 'p', 'l', 'e', 0x07, 0x00 };
+	const uint8_t bt2Uuid[2] = { 0xD0, 0xFF };
+	const uint8_t bt2Data[8] = { 0xE0, 0x7D, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66 };
+	for (int i = 0; i < BENCH_ADVERTS; i++) {
+		BENCH_ADVERT * advert = &benchAdverts[i];
+		memset(advert, 0, sizeof(BENCH_ADVERT));
+		uint8_t address[6] = { (uint8_t)(i % BENCH_ADVERTISERS), 0, 0x5A, 0xC3, 0x81, 0xD4 };
+		int length = benchAddField(advert->data, 0, BLE_GAP_AD_TYPE_FLAGS, flags, 1);
+		if (i % 32 == 0) {
+			address[2] = 0x50;												// the BT2s from benchScanTarget, and others
+			address[0] = (uint8_t)((i / 32) % (BENCH_ADVERT_DEVICES * 2));
+			address[1] = 0;
+			length = benchAddField(advert->data, length, BLE_GAP_AD_TYPE_16BIT_SERVICE_UUID_COMPLETE, bt2Uuid, 2);
+			length = benchAddField(advert->data, length, BLE_GAP_AD_TYPE_MANUFACTURER_SPECIFIC_DATA, bt2Data, 8);
+		} else if (i % 4 == 1) {
+			advert->report.type.scan_response = 1;
+			char name[16];
+			snprintf(name, sizeof(name), "Phone %d", i % 97);
+			length = benchAddField(advert->data, 0, BLE_GAP_AD_TYPE_COMPLETE_LOCAL_NAME, (const uint8_t *)name, strlen(name));
+		} else if (i % 4 == 2) {
+			length = benchAddField(advert->data, length, BLE_GAP_AD_TYPE_16BIT_SERVICE_UUID_COMPLETE, beaconUuid, 2);
+			length = benchAddField(advert->data, length, 0x16, beaconData, sizeof(beaconData));
+		} else {
+			length = benchAddField(advert->data, length, BLE_GAP_AD_TYPE_MANUFACTURER_SPECIFIC_DATA, phone, sizeof(phone));
+		}
+		memcpy(advert->report.peer_addr.addr, address, 6);
+		advert->report.data.p_data = advert->data;
+		advert->report.data.len = length;
+	}
+}
+
+static void benchScanTarget(uint8_t * address, int device) {
+	uint8_t target[6] = { (uint8_t)device, 0, 0x50, 0xC3, 0x81, 0xD4 };
+	memcpy(address, target, 6);
+}
+
+/** scanCallback as it was: a service UUID search, then a second walk for the manufacturer data or name, then
+ * memcmp/strcmp over every slot.  Returns the slot that would be connected, or -1
+ */
+static int benchLegacyScan(BenchReader & reader, ble_gap_evt_adv_report_t * report) {
+	if (!report->type.scan_response) {
+		if (!Bluefruit.Scanner.checkReportForService(report, reader.deviceTable[0].txService)) { return -1; }
+		uint8_t buffer[20];
+		int len = Bluefruit.Scanner.parseReportByType(report, BLE_GAP_AD_TYPE_MANUFACTURER_SPECIFIC_DATA, buffer, 20);
+		if (len == 0 || (buffer[1] * 256 + buffer[0] != 0x7DE0)) { return -1; }
+		for (int i = 0; i < reader.deviceTableSize; i++) {
+			if (memcmp(report->peer_addr.addr, reader.deviceTable[i].peerAddress, 6) == 0) { return i; }
+		}
+		return -1;
+	}
+	uint8_t buffer[20];
+	int len = Bluefruit.Scanner.parseReportByType(report, BLE_GAP_AD_TYPE_COMPLETE_LOCAL_NAME, buffer, 19);
+	if (len == 0) { return -1; }
+	buffer[len] = 0;
+	for (int i = 0; i < reader.deviceTableSize; i++) {
+		if (strcmp((char *)buffer, reader.deviceTable[i].peerName) == 0
+			|| memcmp(report->peer_addr.addr, reader.deviceTable[i].peerAddress, 6) == 0) { return i; }
+	}
+	return -1;
+}
+
+/** ns per advertising report through scanCallback, against the legacy multi-pass sequence
+ */
+void benchAdvertStorm() {
+	static BenchReader reader;
+	reader.setDeviceTableSize(BENCH_ADVERT_DEVICES);
+	for (int i = 0; i < BENCH_ADVERT_DEVICES; i++) {
+		uint8_t address[6];
+		benchScanTarget(address, i);
+		reader.addTargetBT2Device(address);
+	}
+	reader.begin();
+	benchBuildAdverts();
+
+	int legacyMatches = 0;
+	for (int i = 0; i < BENCH_ADVERTS; i++) { legacyMatches += (benchLegacyScan(reader, &benchAdverts[i].report) >= 0); }
+	uint32_t connectRequests = Bluefruit.Central.connectRequests;
+	Serial.setOutput(NULL);
+	for (int i = 0; i < BENCH_ADVERTS; i++) { reader.scanCallback(&benchAdverts[i].report); }
+	Serial.setOutput(stdout);
+	benchCheck(legacyMatches > 0 && (int)(Bluefruit.Central.connectRequests - connectRequests) == legacyMatches, "scanCallback connects exactly the targeted BT2s");
+
+	int index = 0;
+	double legacy = benchRun("advert storm, legacy scan", 1000000, [&]() {
+		benchSink += benchLegacyScan(reader, &benchAdverts[index++ & (BENCH_ADVERTS - 1)].report);
+	}, "48 advertisers + BT2s, 1 report in 32 a BT2");
+	Serial.setOutput(NULL);
+	double firstSight = benchRun("advert storm, scanCallback, no reject cache", 1000000, [&]() {
+		BENCH_ADVERT * advert = &benchAdverts[index++ & (BENCH_ADVERTS - 1)];
+		reader.scanRejects[reader.getAddressHash(advert->report.peer_addr.addr) & (SCAN_REJECT_CACHE_SIZE - 1)].expiresMillis = 0;
+		benchSink += reader.scanCallback(&advert->report);
+	}, "every report a cache miss");
+	double current = benchRun("advert storm, scanCallback", 1000000, [&]() {
+		benchSink += reader.scanCallback(&benchAdverts[index++ & (BENCH_ADVERTS - 1)].report);
+	});
+	Serial.setOutput(stdout);
+	char note[64];
+	snprintf(note, sizeof(note), "%.1fx fewer ns per report", legacy / current);
+	benchReport("advert storm", 0, note);
+	benchSink += (uint32_t)firstSight;
+
+	// repeat reports from a phone hit the reject cache until it ages out or the device table changes
+	uint32_t phone = reader.getAddressHash(benchAdverts[3].report.peer_addr.addr);
+	uint32_t otherBT2 = reader.getAddressHash(benchAdverts[32 * 5].report.peer_addr.addr);
+	benchCheck(reader.getIsScanRejected(phone) && reader.getIsScanRejected(otherBT2), "phones and untargeted BT2s are rejected with one probe");
+	uint32_t target = reader.getAddressHash(benchAdverts[32 * 1].report.peer_addr.addr);
+	benchCheck(!reader.getIsScanRejected(target), "targeted BT2 is never rejected");
+	nativeAdvanceMillis(BT2_SCAN_REJECT_MILLIS);
+	reader.service();
+	benchCheck(!reader.getIsScanRejected(phone), "rejects age out in service()");
+
+	// 128-bit form of FFD0 and a short local name are recognised too
+	uint8_t data[31];
+	const uint8_t uuid128[16] = {0xFB,0x34,0x9B,0x5F,0x80,0x00,0x00,0x80,0x00,0x10,0x00,0x00,0xD0,0xFF,0x00,0x00};
+	const uint8_t manufacturer[2] = { 0xE0, 0x7D };
+	int length = benchAddField(data, 0, BLE_GAP_AD_TYPE_128BIT_SERVICE_UUID_COMPLETE, uuid128, 16);
+	length = benchAddField(data, length, BLE_GAP_AD_TYPE_MANUFACTURER_SPECIFIC_DATA, manufacturer, 2);
+	length = benchAddField(data, length, BLE_GAP_AD_TYPE_SHORT_LOCAL_NAME, (const uint8_t *)"BT-TH", 5);
+	ble_gap_evt_adv_report_t report;
+	memset(&report, 0, sizeof(report));
+	report.data.p_data = data;
+	report.data.len = length;
+	BT2_ADVERTISEMENT advertisement;
+	reader.parseAdvertisement(&report, &advertisement);
+	benchCheck(advertisement.hasBT2Service && advertisement.manufacturerId == 0x7DE0 && strcmp(advertisement.localName, "BT-TH") == 0, "single pass parse of 128-bit UUID, manufacturer and name");
+	data[0] = 30;																// field runs past the report
+	reader.parseAdvertisement(&report, &advertisement);
+	benchCheck(!advertisement.hasBT2Service && !advertisement.hasManufacturerId, "malformed AD structure ends the walk");
+
+	// an untargeted BT2 is claimed into a free slot, and found again by address
+	static BenchReader open;
+	open.setDeviceTableSize(2);
+	open.begin();
+	Serial.setOutput(NULL);
+	boolean claimed = open.scanCallback(&benchAdverts[32 * 5].report);
+	Serial.setOutput(stdout);
+	benchCheck(claimed && open.getDeviceIndex(benchAdverts[32 * 5].report.peer_addr.addr) == 0, "untargeted BT2 claims a slot in the address index");
+	benchCheck(open.getDeviceIndex(benchAdverts[32 * 6].report.peer_addr.addr) == -1, "unknown address misses the index");
+	Serial.setOutput(NULL);
+	open.scanCallback(&benchAdverts[32 * 6].report);
+	open.scanCallback(&benchAdverts[32 * 7].report);							// table full: BT2 7 is rejected
+	uint32_t lateBT2 = open.getAddressHash(benchAdverts[32 * 7].report.peer_addr.addr);
+	benchCheck(open.getIsScanRejected(lateBT2), "BT2 with no slot left is rejected");
+	open.disconnectCallback(BLE_CONN_HANDLE_INVALID, 0x13);					// frees slot 0's address
+	Serial.setOutput(stdout);
+	benchCheck(!open.getIsScanRejected(lateBT2), "freed slot clears the reject cache");
+}
@@ -0,0 +1,96 @@
+#include "BT2Bench.h"
+
+static BenchReader * benchScheduleReader = NULL;
+static uint16_t benchAcceptedStart = 0xFFFF;								// if set, every other read gets a Modbus exception
+
+struct BENCH_SCHEDULE_COUNTS {
+	uint32_t frames;
+	uint32_t liveFrames;													// reads covering 0x0100 - 0x0109
+	uint32_t identityFrames;
+	uint32_t rejectedFrames;
+};
+
+/** Simulates seconds of polling on one device with a 100ms link, where only the 0x0100 block ever changes
+ */
+static BENCH_SCHEDULE_COUNTS benchRunSchedule(int seconds) {
+	BENCH_SCHEDULE_COUNTS counts = {0, 0, 0, 0};
+	uint8_t frame[DEFAULT_DATA_BUFFER_LENGTH];
+	for (int round = 0; round < seconds * 1000 / BENCH_LINK_LATENCY_MILLIS; round++) {
+		nativeAdvanceMillis(BENCH_LINK_LATENCY_MILLIS);
+		benchScheduleReader->service();
+		if (benchPendingReads[0].numberOfRegisters == 0) { continue; }
+		uint16_t start = benchPendingReads[0].startRegister;
+		boolean live = start <= RENOGY_SOLAR_POWER && start + benchPendingReads[0].numberOfRegisters > RENOGY_AUX_BATT_SOC;
+		int frameLength = benchBuildResponse(frame, start, benchPendingReads[0].numberOfRegisters, live ? round : 0);
+		benchPendingReads[0].numberOfRegisters = 0;
+		if (benchAcceptedStart != 0xFFFF && start != benchAcceptedStart) {
+			uint8_t exception[5] = { 0xFF, MODBUS_READ_EXCEPTION, 0x02, 0, 0 };
+			uint16_t checksum = benchReferenceChecksum(exception, 3);
+			exception[3] = checksum & 0xFF;
+			exception[4] = checksum >> 8;
+			benchNotifyFrame(*benchScheduleReader, 0, exception, 5);
+			counts.rejectedFrames++;
+			continue;
+		}
+		benchNotifyFrame(*benchScheduleReader, 0, frame, frameLength);
+		counts.frames++;
+		if (live) { counts.liveFrames++; }
+		if (start == RENOGY_PRODUCT_MODEL) { counts.identityFrames++; }
+	}
+	benchScheduleReader->service();
+	return counts;
+}
+
+/** Compares round robin polling of the register map with the adaptive schedule over the same link
+ */
+void benchPollSchedule() {
+	static BenchReader reader;
+	benchScheduleReader = &reader;
+	benchConnectDevices(reader, 1);
+	benchCaptureReads(reader);
+	const int seconds = 60;
+
+	static BT2ReadPlan plan;
+	plan.addRegisterMap();
+	plan.build();
+	reader.setReadPlan(&plan);
+	BENCH_SCHEDULE_COUNTS roundRobin = benchRunSchedule(seconds);
+	reader.setReadPlan(NULL);
+	benchRunSchedule(1);
+
+	static BT2PollSchedule schedule;
+	schedule.addDefaultGroups();
+	reader.setPollSchedule(&schedule);
+	BENCH_SCHEDULE_COUNTS adaptive = benchRunSchedule(seconds);
+
+	char note[96];
+	snprintf(note, sizeof(note), "%.1f frames/s, 0x0100 block %.1f/s, identity read %lu times",
+		(double)roundRobin.frames / seconds, (double)roundRobin.liveFrames / seconds, (unsigned long)roundRobin.identityFrames);
+	benchReport("round robin read plan, 60s at 100ms link", 0, note);
+	snprintf(note, sizeof(note), "%.1f frames/s, 0x0100 block %.1f/s, identity read %lu times",
+		(double)adaptive.frames / seconds, (double)adaptive.liveFrames / seconds, (unsigned long)adaptive.identityFrames);
+	benchReport("adaptive poll schedule, 60s at 100ms link", 0, note);
+	benchCheck(adaptive.identityFrames == 1, "static group read once per connection");
+	benchCheck(adaptive.frames <= roundRobin.frames && adaptive.liveFrames > 3 * roundRobin.liveFrames, "link time moves to the live block");
+	benchCheck(reader.getPollPeriod(0, 1) == 0 && reader.getPollPeriod(0, 3) > 10000, "periods adapt to volatility");
+
+	reader.disconnectCallback(BENCH_CONNECTION_HANDLE, 0x13);
+	benchRunSchedule(1);
+	Bluefruit.nativeConnect(BENCH_CONNECTION_HANDLE, reader.deviceTable[0].peerAddress, "BT-TH-BENCH000");
+	reader.connectCallback(BENCH_CONNECTION_HANDLE);
+	benchCheck(benchRunSchedule(1).identityFrames == 1, "static group read again after reconnecting");
+
+	static BT2PollSchedule rejected;
+	rejected.addStaticGroup(RENOGY_PRODUCT_MODEL, RENOGY_CONTROLLER_ADDRESS - RENOGY_PRODUCT_MODEL + 1);
+	rejected.addGroup(RENOGY_CHARGING_MODE, 3, 1000, 1000);
+	rejected.addGroup(RENOGY_AUX_BATT_SOC, 10, 500, 500);
+	reader.setPollSchedule(&rejected);
+	benchAcceptedStart = RENOGY_AUX_BATT_SOC;
+	BENCH_SCHEDULE_COUNTS rejecting = benchRunSchedule(10);
+	benchAcceptedStart = 0xFFFF;
+	benchCheck(rejecting.rejectedFrames <= 14 && rejecting.liveFrames >= 15, "groups the device rejects wait their period and don't starve the rest");
+
+	reader.setPollSchedule(NULL);
+	benchRunSchedule(1);
+	BLEClientCharacteristic::nativeWriteHook = NULL;
+}
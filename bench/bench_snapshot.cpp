@@ -0,0 +1,109 @@
+#include "BT2Bench.h"
+
+/** Every register in snapshot matches what the reader holds, and every register in each profile is there */
+static boolean benchGetIsSnapshotExact(BenchReader & reader, const BT2_SNAPSHOT * snapshot) {
+	if (snapshot->deviceCount != reader.deviceTableSize) { return false; }
+	for (int i = 0; i < snapshot->deviceCount; i++) {
+		const BT2_SNAPSHOT_DEVICE * device = &snapshot->devices[i];
+		const BT2_REGISTER_PROFILE * profile = reader.getRegisterProfile(i);
+		int registers = 0;
+		for (int d = 0; d < profile->descriptionSize; d++) {
+			if (profile->descriptions[d].address != INVALID_REGISTER) { registers += profile->descriptions[d].bytesUsed / 2; }
+		}
+		if (device->index != i || device->modbusAddress != profile->modbusAddress || device->registerCount != registers) { return false; }
+		for (int r = 0; r < device->registerCount; r++) {
+			int valueIndex = reader.getRegisterValueIndex(&reader.deviceTable[i], device->registers[r].address);
+			if (valueIndex < 0 || reader.deviceTable[i].registerValues[valueIndex] != device->registers[r].value) { return false; }
+		}
+	}
+	return true;
+}
+
+/** Bytes per full dump through printRegister() against key and delta snapshots, for a DCC charger and a Rover,
+ * then decoding: exact round trip, CRC and sequence checks, and resynchronising on a noisy stream
+ */
+void benchSnapshots() {
+	static BenchReader reader;
+	benchConnectDevices(reader, 2);
+	reader.setRegisterProfile(1, &BT2_REGISTER_MAP_ROVER::profile);
+	static BT2ReadPlan dccPlan;
+	dccPlan.addRegisterMap(&BT2_REGISTER_MAP_DCC::profile);
+	dccPlan.build();
+	static BT2ReadPlan roverPlan;
+	roverPlan.addRegisterMap(&BT2_REGISTER_MAP_ROVER::profile);
+	roverPlan.build();
+	benchFillDevice(reader, 0, dccPlan, 0);
+	benchFillDevice(reader, 1, roverPlan, 0);
+
+	uint32_t textBytes = Serial.bytesWritten;
+	Serial.setOutput(NULL);
+	for (int i = 0; i < 2; i++) {
+		const BT2_REGISTER_PROFILE * profile = reader.getRegisterProfile(i);
+		for (int d = 0; d < profile->descriptionSize; d++) {
+			if (profile->descriptions[d].address != INVALID_REGISTER) { reader.printRegister(&reader.deviceTable[i], profile->descriptions[d].address); }
+		}
+	}
+	Serial.setOutput(stdout);
+	textBytes = Serial.bytesWritten - textBytes;
+
+	static BT2SnapshotEncoder encoder;
+	static BT2SnapshotDecoder decoder;
+	uint8_t keyFrame[BT2_SNAPSHOT_MAXIMUM_LENGTH];
+	uint8_t deltaFrame[BT2_SNAPSHOT_MAXIMUM_LENGTH];
+	int keyLength = reader.encodeSnapshot(keyFrame, sizeof(keyFrame), &encoder);
+	benchCheck(keyLength > 0 && !(keyFrame[4] & BT2_SNAPSHOT_FLAG_DELTA), "first frame is a key frame");
+	benchCheck(decoder.decode(keyFrame, keyLength) == BT2_SNAPSHOT_OK && benchGetIsSnapshotExact(reader, decoder.getSnapshot()), "key frame round trip");
+
+	uint8_t frame[DEFAULT_DATA_BUFFER_LENGTH];
+	int frameLength = benchBuildResponse(frame, RENOGY_AUX_BATT_SOC, 10, 3);	// a poll of the live block, each value moved a little
+	reader.sendReadCommand(0, RENOGY_AUX_BATT_SOC, 10);
+	benchNotifyFrame(reader, 0, frame, frameLength);
+	reader.sendReadCommand(1, RENOGY_AUX_BATT_SOC, 10);
+	benchNotifyFrame(reader, 1, frame, frameLength);
+	int deltaLength = reader.encodeSnapshot(deltaFrame, sizeof(deltaFrame), &encoder);
+	benchCheck(deltaLength > 0 && (deltaFrame[4] & BT2_SNAPSHOT_FLAG_DELTA), "second frame is a delta frame");
+	benchCheck(decoder.decode(deltaFrame, deltaLength) == BT2_SNAPSHOT_OK && benchGetIsSnapshotExact(reader, decoder.getSnapshot()), "delta frame round trip");
+	benchCheck(decoder.getSnapshot()->devices[0].everRead && decoder.getSnapshot()->snapshotMillis - decoder.getSnapshot()->devices[0].frameMillis < 10,
+		"frame timestamp");
+
+	char note[128];
+	snprintf(note, sizeof(note), "%lu bytes as text, %d as a key frame (%.1fx), %d as a delta frame (%.1fx)", (unsigned long)textBytes,
+		keyLength, (double)textBytes / keyLength, deltaLength, (double)textBytes / deltaLength);
+	benchReport("snapshot of a DCC charger and a Rover", 0, note);
+	benchCheck(textBytes >= 5 * (uint32_t)keyLength && textBytes >= 10 * (uint32_t)deltaLength, "at least 5x smaller than text, 10x as a delta");
+
+	BT2SnapshotDecoder lateDecoder;
+	benchCheck(lateDecoder.decode(deltaFrame, deltaLength) == BT2_SNAPSHOT_NEEDS_KEY && !lateDecoder.getHasSnapshot(), "a delta frame needs its key frame");
+	keyFrame[keyLength / 2] ^= 0x01;
+	benchCheck(lateDecoder.decode(keyFrame, keyLength) == BT2_SNAPSHOT_CHECKSUM_ERROR, "corrupt frame fails its CRC");
+	keyFrame[keyLength / 2] ^= 0x01;
+
+	encoder.requestKey();
+	keyLength = reader.encodeSnapshot(keyFrame, sizeof(keyFrame), &encoder);
+	deltaLength = reader.encodeSnapshot(deltaFrame, sizeof(deltaFrame), &encoder);
+	static uint8_t stream[3 * BT2_SNAPSHOT_MAXIMUM_LENGTH];
+	int streamLength = 0;
+	const char noise[] = "boot\r\n\xB2\x01\xFF";
+	memcpy(&stream[streamLength], noise, sizeof(noise) - 1);
+	streamLength += sizeof(noise) - 1;
+	memcpy(&stream[streamLength], keyFrame, keyLength);
+	stream[streamLength + 10] ^= 0x40;															// this copy is damaged
+	streamLength += keyLength;
+	memcpy(&stream[streamLength], keyFrame, keyLength);
+	streamLength += keyLength;
+	memcpy(&stream[streamLength], deltaFrame, deltaLength);
+	streamLength += deltaLength;
+	BT2SnapshotDecoder streamDecoder;
+	int decoded = 0;
+	for (int offset = 0; offset < streamLength; offset += 20) { decoded += streamDecoder.feed(&stream[offset], min(20, streamLength - offset)); }
+	benchCheck(decoded == 2 && streamDecoder.getSnapshot()->sequence == encoder.getSequence() - 1 && benchGetIsSnapshotExact(reader, streamDecoder.getSnapshot()),
+		"stream decoder skips noise and a damaged frame");
+
+	BT2SnapshotEncoder timedEncoder;
+	timedEncoder.setKeyInterval(0);
+	benchRun("encodeSnapshot, key frame, 2 devices", 200000, [&]() { benchSink += reader.encodeSnapshot(keyFrame, sizeof(keyFrame), &timedEncoder); });
+	benchRun("encodeSnapshot, delta frame, 2 devices", 200000, [&]() { benchSink += reader.encodeSnapshot(deltaFrame, sizeof(deltaFrame), &encoder); });
+	encoder.requestKey();
+	keyLength = reader.encodeSnapshot(keyFrame, sizeof(keyFrame), &encoder);
+	benchRun("BT2SnapshotDecoder::decode, key frame", 200000, [&]() { benchSink += decoder.decode(keyFrame, keyLength); });
+}
@@ -0,0 +1,76 @@
+#include "BT2Bench.h"
+#include <new>
+
+/** Counts heap use across the whole bench binary, so begin() can be checked for allocations */
+static uint32_t benchAllocations = 0;
+static uint32_t benchFrees = 0;
+
+void * operator new(size_t size) {
+	benchAllocations++;
+	void * p = malloc(size == 0 ? 1 : size);
+	if (p == NULL) { throw std::bad_alloc(); }
+	return p;
+}
+void * operator new[](size_t size) { return operator new(size); }
+void operator delete(void * p) noexcept { if (p != NULL) { benchFrees++; } free(p); }
+void operator delete[](void * p) noexcept { operator delete(p); }
+void operator delete(void * p, size_t size) noexcept { operator delete(p); }
+void operator delete[](void * p, size_t size) noexcept { operator delete(p); }
+
+#define BENCH_STATIC_DEVICES			4
+
+static StaticBT2Reader<BENCH_STATIC_DEVICES> benchStaticReader;			// a global, as a sketch would have it
+
+/** Allocations made by setDeviceTableSize + begin + first frame + subscribe, and begin() time, heap against static
+ */
+void benchStaticReaderStorage() {
+	uint32_t allocations = benchAllocations;
+	benchStaticReader.setDeviceTableSize(BENCH_STATIC_DEVICES);
+	for (int i = 0; i < BENCH_STATIC_DEVICES; i++) {
+		uint8_t peerAddress[6] = { 0x10, 0x20, 0x30, 0x40, 0x51, (uint8_t)(0x60 + i) };
+		benchStaticReader.addTargetBT2Device(peerAddress);
+	}
+	benchStaticReader.begin();
+	DEVICE * device = benchStaticReader.getDevice(0);
+	Bluefruit.nativeConnect(BENCH_CONNECTION_HANDLE, device->peerAddress, "BT-TH-STATIC00");
+	benchStaticReader.connectCallback(BENCH_CONNECTION_HANDLE);
+	benchStaticReader.subscribe(0, RENOGY_AUX_BATT_VOLTAGE);
+	uint8_t frame[DEFAULT_DATA_BUFFER_LENGTH];
+	int frameLength = benchBuildResponse(frame, 0x0100, 0x23, 3);
+	benchStaticReader.sendReadCommand(0, 0x0100, 0x23);
+	uint8_t packet[20];
+	for (int offset = 0; offset < frameLength; offset += 20) {
+		int len = min(20, frameLength - offset);
+		memcpy(packet, &frame[offset], len);
+		benchStaticReader.notifyCallback(&device->rxCharacteristic, packet, len);
+	}
+	uint16_t expected = frame[3 + 2 * (RENOGY_AUX_BATT_VOLTAGE - 0x0100)] * 256 + frame[4 + 2 * (RENOGY_AUX_BATT_VOLTAGE - 0x0100)];
+	benchCheck(benchStaticReader.getRegisterValue(0, RENOGY_AUX_BATT_VOLTAGE) == expected
+		&& benchStaticReader.getIsRegisterChanged(0, RENOGY_AUX_BATT_VOLTAGE), "StaticBT2Reader reads and subscribes");
+	benchCheck(benchAllocations == allocations, "StaticBT2Reader setup, begin, connect and subscribe allocate nothing");
+	Bluefruit.disconnect(BENCH_CONNECTION_HANDLE);
+	benchStaticReader.disconnectCallback(BENCH_CONNECTION_HANDLE, 0x13);
+
+	static BenchReader heapReader;
+	heapReader.setDeviceTableSize(BENCH_STATIC_DEVICES);
+	heapReader.begin();
+	uint32_t frees = benchFrees;
+	heapReader.setDeviceTableSize(BENCH_STATIC_DEVICES);
+	benchCheck(benchFrees - frees == BENCH_STATIC_DEVICES + 1, "BT2Reader frees its previous table on setDeviceTableSize");
+
+	Serial.setOutput(NULL);
+	benchRun("setDeviceTableSize + begin, BT2Reader (4 devices)", 20000, [&]() {
+		heapReader.setDeviceTableSize(BENCH_STATIC_DEVICES);
+		heapReader.begin();
+	});
+	benchRun("setDeviceTableSize + begin, StaticBT2Reader<4>", 20000, [&]() {
+		benchStaticReader.setDeviceTableSize(BENCH_STATIC_DEVICES);
+		benchStaticReader.begin();
+	});
+	Serial.setOutput(stdout);
+
+	char note[96];
+	snprintf(note, sizeof(note), "%d bytes in .bss, %d per device", (int)sizeof(benchStaticReader),
+		(int)(sizeof(DEVICE) + MAXIMUM_PROFILE_VALUES * sizeof(uint16_t) + sizeof(REGISTER_SUBSCRIPTIONS)));
+	benchReport("sizeof(StaticBT2Reader<4>)", 0, note);
+}
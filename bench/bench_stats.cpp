@@ -0,0 +1,78 @@
+#include "BT2Bench.h"
+
+#define BENCH_STATS_RTT_MILLIS			80
+#define BENCH_STATS_GAP_MILLIS			8			// between notifications, about one connection interval
+
+/** Answers the read in flight after BENCH_STATS_RTT_MILLIS, one notification per connection interval
+ */
+static void benchAnswerSlowly(BenchReader & reader, const uint8_t * frame, int frameLength) {
+	uint8_t packet[20];
+	nativeAdvanceMillis(BENCH_STATS_RTT_MILLIS - BENCH_STATS_GAP_MILLIS * ((frameLength - 1) / 20));
+	for (int offset = 0; offset < frameLength; offset += 20) {
+		if (offset > 0) { nativeAdvanceMillis(BENCH_STATS_GAP_MILLIS); }
+		int len = min(20, frameLength - offset);
+		memcpy(packet, &frame[offset], len);
+		reader.notifyCallback(&reader.deviceTable[0].rxCharacteristic, packet, len);
+	}
+}
+
+/** Drives one device through good frames, a corrupt one, a late extra notification, a timeout and a reconnect,
+ * and checks getStats() saw each of them
+ */
+void benchLinkStats() {
+	static BenchReader reader;
+	benchConnectDevices(reader, 1);
+	uint8_t frame[DEFAULT_DATA_BUFFER_LENGTH];
+	int frameLength = benchBuildResponse(frame, 0x0100, 0x23, 5);			// 75 bytes, 4 notifications
+
+	for (int i = 0; i < 10; i++) {
+		reader.queueReadCommand(0, 0x0100, 0x23, NULL, 1000);
+		reader.service();
+		benchAnswerSlowly(reader, frame, frameLength);
+		reader.service();
+	}
+	reader.queueReadCommand(0, 0x0100, 0x23, NULL, 1000);
+	reader.service();
+	benchAnswerSlowly(reader, frame, frameLength);
+	reader.notifyCallback(&reader.deviceTable[0].rxCharacteristic, frame, 20);		// a duplicate after the frame completed
+	reader.service();
+
+	frame[10] ^= 0x01;
+	reader.queueReadCommand(0, 0x0100, 0x23, NULL, 1000);
+	reader.service();
+	benchAnswerSlowly(reader, frame, frameLength);
+	reader.service();
+	frame[10] ^= 0x01;
+
+	Serial.setOutput(NULL);
+	reader.queueReadCommand(0, 0x0100, 0x23, NULL, 1000);
+	reader.service();
+	nativeAdvanceMillis(1001);
+	reader.service();
+	Serial.setOutput(stdout);
+
+	reader.disconnectCallback(BENCH_CONNECTION_HANDLE, 0x08);
+	Bluefruit.nativeConnect(BENCH_CONNECTION_HANDLE, reader.deviceTable[0].peerAddress, "BT-TH-BENCH000");
+	reader.connectCallback(BENCH_CONNECTION_HANDLE);
+
+	BT2_STATS stats;
+	benchCheck(reader.getStats(0, &stats), "getStats for a valid index");
+	benchCheck(!reader.getStats(1, &stats) && !reader.getStats(-1, &stats), "getStats rejects a bad index");
+	reader.getStats(0, &stats);
+	benchCheck(stats.commandsSent == 13 && stats.framesCompleted == 11, "commands sent and frames completed");
+	benchCheck(stats.roundTripHistogram[2] == 11 && stats.roundTripMinMillis == BENCH_STATS_RTT_MILLIS
+		&& stats.roundTripMaxMillis == BENCH_STATS_RTT_MILLIS, "round trips land in the 75-100ms bucket");
+	benchCheck(stats.frameNotifications == 44 && stats.notifications == 12 * 4 + 1, "notifications per frame");
+	benchCheck(stats.notificationGapMaxMicros >= BENCH_STATS_GAP_MILLIS * 1000
+		&& stats.notificationGapMaxMicros < (BENCH_STATS_GAP_MILLIS + 5) * 1000, "gaps measured within a response only");
+	benchCheck(stats.checksumErrors == 1 && stats.overruns == 1 && stats.timeouts == 1, "checksum error, overrun and timeout counted");
+	benchCheck(stats.connections == 2 && stats.reconnects == 1, "reconnect counted");
+
+	char note[96];
+	snprintf(note, sizeof(note), "%d bytes per device, no heap", (int)sizeof(BT2_STATS));
+	benchReport("sizeof(BT2_STATS)", 0, note);
+	benchRun("recordNotification", 5000000, [&]() { reader.recordNotification(&reader.deviceTable[0]); });
+	reader.resetStats(0);
+	reader.getStats(0, &stats);
+	benchCheck(stats.notifications == 0 && stats.connections == 0, "resetStats clears the counters");
+}
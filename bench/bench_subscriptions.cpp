@@ -0,0 +1,93 @@
+#include "BT2Bench.h"
+
+static uint32_t benchChangeCallbacks = 0;
+
+static void benchChangeCallback(int deviceIndex, uint16_t registerAddress) { benchChangeCallbacks++; }
+
+/** A 0x0100 x 0x23 response from a controller sitting at float: every reading wanders by a count or two */
+static int benchBuildStableFrame(uint8_t * frame, int poll) {
+	uint16_t values[0x23];
+	for (int i = 0; i < 0x23; i++) { values[i] = (uint16_t)((0x0100 + i) * 31); }
+	values[RENOGY_AUX_BATT_VOLTAGE - 0x0100] = 136 + (rand() % 3) - 1;		// 13.6V +/- 0.1V
+	values[RENOGY_SOLAR_VOLTAGE - 0x0100] = 184 + (rand() % 3) - 1;
+	values[RENOGY_SOLAR_CURRENT - 0x0100] = 120 + (rand() % 11) - 5;		// 1.2A +/- 50mA
+	values[RENOGY_SOLAR_POWER - 0x0100] = 22 + (rand() % 5) - 2;
+	values[RENOGY_TODAY_POWER - 0x0100] = 180 + poll / 60;					// climbs 1Wh a minute
+	frame[0] = 0xFF;
+	frame[1] = 0x03;
+	frame[2] = 0x23 * 2;
+	for (int i = 0; i < 0x23; i++) {
+		frame[3 + i * 2] = values[i] >> 8;
+		frame[4 + i * 2] = values[i] & 0xFF;
+	}
+	int length = 3 + 0x23 * 2;
+	uint16_t checksum = benchReferenceChecksum(frame, length);
+	frame[length++] = checksum & 0xFF;
+	frame[length++] = checksum >> 8;
+	return length;
+}
+
+static void benchSendFrame(BenchReader & reader, uint8_t * frame, int frameLength) {
+	reader.sendReadCommand(0, 0x0100, 0x23);
+	benchNotifyFrame(reader, 0, frame, frameLength);
+}
+
+/** Counts what a loop that publishes on every frame sends against one that only publishes subscribed changes
+ */
+void benchSubscriptions() {
+	static BenchReader reader;
+	benchConnectDevices(reader, 1);
+	uint8_t frame[DEFAULT_DATA_BUFFER_LENGTH];
+
+	benchCheck(reader.subscribe(0, RENOGY_AUX_BATT_VOLTAGE, 200) && !reader.subscribe(0, 0x7FFF), "subscribe");
+	srand(1);
+	int frameLength = benchBuildStableFrame(frame, 0);
+	benchSendFrame(reader, frame, frameLength);
+	benchCheck(reader.getNextChangedRegister(0) == RENOGY_AUX_BATT_VOLTAGE && reader.getNextChangedRegister(0) == -1, "first value is a change");
+	frame[3 + 2 * (RENOGY_AUX_BATT_VOLTAGE - 0x0100) + 1] += 1;				// +0.1V, inside the deadband
+	uint16_t checksum = benchReferenceChecksum(frame, frameLength - 2);
+	frame[frameLength - 2] = checksum & 0xFF;
+	frame[frameLength - 1] = checksum >> 8;
+	benchSendFrame(reader, frame, frameLength);
+	benchCheck(!reader.getIsRegisterChanged(0, RENOGY_AUX_BATT_VOLTAGE), "change inside deadband is ignored");
+	frame[3 + 2 * (RENOGY_AUX_BATT_VOLTAGE - 0x0100) + 1] += 2;				// +0.3V from the reported value
+	checksum = benchReferenceChecksum(frame, frameLength - 2);
+	frame[frameLength - 2] = checksum & 0xFF;
+	frame[frameLength - 1] = checksum >> 8;
+	benchSendFrame(reader, frame, frameLength);
+	benchCheck(reader.getIsRegisterChanged(0, RENOGY_AUX_BATT_VOLTAGE) && !reader.getIsRegisterChanged(0, RENOGY_AUX_BATT_VOLTAGE), "change past deadband is reported once");
+
+	for (int i = 0; i < REGISTER_DESCRIPTION_SIZE; i++) {
+		uint16_t address = registerDescription[i].address;
+		if (address < 0x0100 || address >= 0x0123) { continue; }
+		int32_t deadband = 0;
+		switch (registerDescription[i].type) {
+			case RENOGY_VOLTS: deadband = 200; break;
+			case RENOGY_AMPS: deadband = 100; break;
+		}
+		if (address == RENOGY_SOLAR_POWER) { deadband = 5000; }
+		reader.subscribe(0, address, deadband, benchChangeCallback);
+	}
+	reader.service();
+	benchChangeCallbacks = 0;
+	uint32_t registersReceived = 0;
+	const int polls = 3600;
+	for (int poll = 0; poll < polls; poll++) {
+		frameLength = benchBuildStableFrame(frame, poll);
+		benchSendFrame(reader, frame, frameLength);
+		reader.service();
+		for (int i = 0; i < REGISTER_DESCRIPTION_SIZE; i++) {
+			if (registerDescription[i].address >= 0x0100 && registerDescription[i].address < 0x0123) { registersReceived++; }
+		}
+	}
+	char note[96];
+	snprintf(note, sizeof(note), "%lu registers received, %lu changes published (%.1fx fewer)",
+		(unsigned long)registersReceived, (unsigned long)benchChangeCallbacks, (double)registersReceived / max(benchChangeCallbacks, (uint32_t)1));
+	benchReport("subscriptions, 1 hour of 1s polls at float", 0, note);
+	benchCheck(benchChangeCallbacks > 0 && benchChangeCallbacks * 10 < registersReceived, "subscriptions publish an order of magnitude less");
+
+	benchCheck(reader.unsubscribe(0, RENOGY_SOLAR_POWER) && !reader.unsubscribe(0, RENOGY_SOLAR_POWER), "unsubscribe");
+	benchRun("0x23 register frame, every register subscribed", 200000, [&]() { benchSendFrame(reader, frame, frameLength); });
+	for (int i = 0; i < REGISTER_DESCRIPTION_SIZE; i++) { reader.unsubscribe(0, registerDescription[i].address); }
+	benchRun("0x23 register frame, no subscriptions", 200000, [&]() { benchSendFrame(reader, frame, frameLength); });
+}
@@ -0,0 +1,53 @@
+#include "BT2Bench.h"
+
+/** Compares the typed accessors with what a caller had to do before: find the description, then float multiply
+ */
+void benchTypedValues() {
+	static BenchReader reader;
+	benchConnectDevices(reader, 1);
+	DEVICE * device = &reader.deviceTable[0];
+
+	uint8_t frame[DEFAULT_DATA_BUFFER_LENGTH];
+	int frameLength = benchBuildResponse(frame, 0x0100, 10, 0);
+	frame[3 + 2 * 1] = 0x00; frame[4 + 2 * 1] = 133;						// aux battery 13.3 V
+	frame[3 + 2 * 3] = 0x99; frame[4 + 2 * 3] = 0x19;						// controller -25 C, battery +25 C
+	frame[3 + 2 * 8] = 0x04; frame[4 + 2 * 8] = 0xD2;						// solar 12.34 A
+	uint16_t checksum = benchReferenceChecksum(frame, frameLength - 2);
+	frame[frameLength - 2] = checksum & 0xFF;
+	frame[frameLength - 1] = checksum >> 8;
+	reader.sendReadCommand(0, 0x0100, 10);
+	benchNotifyFrame(reader, 0, frame, frameLength);
+
+	const char model[17] = "  RBC30D1S      ";
+	frameLength = benchBuildResponse(frame, RENOGY_PRODUCT_MODEL, 8, 0);
+	memcpy(&frame[3], model, 16);
+	checksum = benchReferenceChecksum(frame, frameLength - 2);
+	frame[frameLength - 2] = checksum & 0xFF;
+	frame[frameLength - 1] = checksum >> 8;
+	reader.sendReadCommand(0, RENOGY_PRODUCT_MODEL, 8);
+	benchNotifyFrame(reader, 0, frame, frameLength);
+
+	int8_t battery = 0;
+	int8_t controller = 0;
+	benchCheck(reader.getMillivolts(0, RENOGY_AUX_BATT_VOLTAGE) == 13300 && reader.getScaledValue<RENOGY_AUX_BATT_VOLTAGE>(0) == 13300, "millivolts");
+	benchCheck(reader.getMilliamps(0, RENOGY_SOLAR_CURRENT) == 12340 && reader.getMillivolts(0, RENOGY_SOLAR_CURRENT) == 0, "milliamps, type checked");
+	benchCheck(reader.getTemperatures(0, &battery, &controller) && battery == 25 && controller == -25, "temperature pair");
+	benchCheck(strcmp(reader.getProductModel(0), "RBC30D1S") == 0, "product model string");
+
+	benchRun("raw value + description lookup + float multiply (before)", 5000000, [&]() {
+		int index = reader.getRegisterDescriptionIndex(reader.getDevice(0), RENOGY_AUX_BATT_VOLTAGE);
+		float volts = reader.getRegisterValue(0, RENOGY_AUX_BATT_VOLTAGE) * registerDescription[index].multiplier;
+		benchSink += (uint32_t)(volts * 1000);
+	});
+	benchRun("getMillivolts(RENOGY_AUX_BATT_VOLTAGE)", 5000000, [&]() { benchSink += reader.getMillivolts(0, RENOGY_AUX_BATT_VOLTAGE); });
+	benchRun("getScaledValue<RENOGY_AUX_BATT_VOLTAGE>", 5000000, [&]() { benchSink += reader.getScaledValue<RENOGY_AUX_BATT_VOLTAGE>(0); });
+	benchRun("getTemperatures", 5000000, [&]() {
+		reader.getTemperatures(0, &battery, &controller);
+		benchSink += battery;
+	});
+	benchRun("getProductModel (cached)", 5000000, [&]() { benchSink += reader.getProductModel(0)[0]; });
+	benchRun("getProductModel (decoded every call)", 2000000, [&]() {
+		device->productModelDecoded = false;
+		benchSink += reader.getProductModel(0)[0];
+	});
+}
@@ -0,0 +1,79 @@
+#include "BT2Reader.h"
+
+/** Alarm events.  Once enabled, every read of a RENOGY_BIT_FLAGS register is XORed with the value it replaces, and
+ * each named bit that flipped becomes an event; a RENOGY_OPTIONS register, like RENOGY_CHARGING_MODE, gives a
+ * cleared event for the old option and a raised one for the new.  A register that didn't change costs the XOR and
+ * nothing else.  Events wait in a ring of BT2_ALARM_QUEUE_LENGTH until loop() takes them
+ */
+
+/** Starts queueing alarm events.  With a callback, service() hands it each event as soon as the frame carrying it
+ * has been decoded; without one, take them with getNextAlarmEvent().  The first read of a register raises
+ * whatever is already set, so a fault present at connect is reported too
+ */
+void BT2Reader::beginAlarms(BT2AlarmCallback callback) {
+	alarmsEnabled = true;
+	alarmCallback = callback;
+}
+
+/** Copies the oldest event to event and removes it; false if there are none
+ */
+boolean BT2Reader::getNextAlarmEvent(BT2_ALARM_EVENT * event) {
+	for (int i = 0; i < deviceTableSize && alarmEventHead == alarmEventTail; i++) { drainFrames(&deviceTable[i]); }
+	if (alarmEventHead == alarmEventTail) { return false; }
+	*event = alarmEvents[alarmEventHead & (BT2_ALARM_QUEUE_LENGTH - 1)];
+	alarmEventHead++;
+	return true;
+}
+
+/** Events lost because the queue was full; the oldest go first, so the latest state is always there
+ */
+uint32_t BT2Reader::getAlarmEventsDropped() { return alarmEventsDropped; }
+
+/** Only the bits the profile names are looked at; labels->namedBits was worked out when the profile was compiled
+ */
+void BT2Reader::queueAlarmEvents(DEVICE * device, int descriptionIndex, uint16_t previousValue, uint16_t value, boolean firstRead, uint32_t eventMillis) {
+	const BT2_REGISTER_PROFILE * profile = device->profile;
+	const REGISTER_DESCRIPTION * description = &profile->descriptions[descriptionIndex];
+	const REGISTER_LABEL_ENTRY * labels = &profile->labels[descriptionIndex];
+	if (firstRead) { previousValue = 0; }
+
+	if (description->type == RENOGY_BIT_FLAGS) {
+		uint16_t flipped = (previousValue ^ value) & labels->namedBits;
+		if (flipped == 0) { return; }
+		const RENOGY_BIT_FLAG_TABLE * bitFlags = &profile->bitFlags[labels->first];
+		for (int k = 0; k < labels->count; k++) {
+			uint16_t bit = 1 << bitFlags[k].bit;
+			if ((flipped & bit) == 0) { continue; }
+			pushAlarmEvent(device, description->address, bitFlags[k].bit, bitFlags[k].bitName, (value & bit) != 0, eventMillis);
+		}
+	} else if (description->type == RENOGY_OPTIONS) {
+		value &= profile->optionMask;									// a Rover's load bit isn't a change of option
+		previousValue &= profile->optionMask;
+		if (value == previousValue && !firstRead) { return; }
+		if (!firstRead) { pushAlarmEvent(device, description->address, previousValue, getOptionName(profile, descriptionIndex, previousValue), false, eventMillis); }
+		pushAlarmEvent(device, description->address, value, getOptionName(profile, descriptionIndex, value), true, eventMillis);
+	}
+}
+
+void BT2Reader::pushAlarmEvent(DEVICE * device, uint16_t registerAddress, uint16_t id, const char * name, boolean raised, uint32_t eventMillis) {
+	if ((uint8_t)(alarmEventTail - alarmEventHead) == BT2_ALARM_QUEUE_LENGTH) {
+		alarmEventHead++;
+		alarmEventsDropped++;
+	}
+	BT2_ALARM_EVENT * event = &alarmEvents[alarmEventTail & (BT2_ALARM_QUEUE_LENGTH - 1)];
+	event->millis = eventMillis;
+	event->name = name;
+	event->registerAddress = registerAddress;
+	event->id = id;
+	event->deviceIndex = device - deviceTable;
+	event->raised = raised;
+	alarmEventTail++;
+}
+
+void BT2Reader::dispatchAlarms() {
+	while (alarmEventHead != alarmEventTail) {
+		BT2_ALARM_EVENT event = alarmEvents[alarmEventHead & (BT2_ALARM_QUEUE_LENGTH - 1)];
+		alarmEventHead++;
+		alarmCallback(&event);
+	}
+}
@@ -0,0 +1,115 @@
+#include "BT2Reader.h"
+
+/** Energy integration.  Once enabled, each read of a source's power or current register adds the trapezoid between
+ * it and the reading before, (previous + value) / 2 * elapsed, to that register's integral: one multiply and add
+ * per register per frame, whatever the history.  Elapsed time is an unsigned millis() difference, so a wrap at 49
+ * days costs nothing; readings further apart than the maximum gap, like either side of a disconnect, aren't
+ * bridged and are counted instead
+ */
+
+/** Starts integrating from the next reading of each power and current register.  maximumGapMillis should be a few
+ * times the poll interval of those registers
+ */
+void BT2Reader::beginEnergy(uint32_t maximumGapMillis) {
+	energyEnabled = true;
+	energyMaximumGapMillis = maximumGapMillis;
+}
+
+/** Copies the device's totals and drift into energy; false if index is out of range
+ */
+boolean BT2Reader::getEnergy(int index, BT2_ENERGY * energy) {
+	if (index < 0 || index >= deviceTableSize) { return false; }
+	DEVICE * device = &deviceTable[index];
+	drainFrames(device);
+	const ENERGY_STATE * state = &device->energy;
+	for (int i = 0; i < BT2_ENERGY_SOURCES; i++) {
+		energy->milliwattHours[i] = (uint32_t)getEnergyMilli(device, i, 0);
+		energy->milliampHours[i] = (uint32_t)getEnergyMilli(device, i, 1);
+	}
+	int32_t drift[2] = { 0, 0 };
+	for (int c = 0; c < 2; c++) {
+		if (!state->counterValid[c]) { continue; }
+		int32_t milliScale = getRegisterMilliScale(device->profile->descriptions[getRegisterDescriptionIndex(device, energyCounters[c])]);
+		drift[c] = (int32_t)((int64_t)(getEnergyTotalMilli(device, c) - state->counterBaseMilli[c])
+			- (int64_t)(state->counterLast[c] - state->counterBase[c]) * milliScale);
+	}
+	energy->hasDailyCounters = (state->counterValid[0] && state->counterValid[1]);
+	energy->driftMilliwattHours = drift[0];
+	energy->driftMilliampHours = drift[1];
+	energy->gaps = state->gaps;
+	return true;
+}
+
+/** Zeroes the device's totals and gaps, and takes a new drift baseline at the next read of the daily counters.
+ * The last readings are kept, so integration carries on from them
+ */
+void BT2Reader::resetEnergy(int index) {
+	if (index < 0 || index >= deviceTableSize) { return; }
+	ENERGY_STATE * state = &deviceTable[index].energy;
+	for (int i = 0; i < BT2_ENERGY_SOURCES * 2; i++) { state->integrals[i].sum = 0; }
+	state->counterValid[0] = state->counterValid[1] = false;
+	state->gaps = 0;
+}
+
+/** Called by processDataReceived for every good frame that overlaps the energy registers
+ */
+void BT2Reader::updateEnergy(DEVICE * device, uint16_t startRegister, int numberOfRegisters, uint32_t sampleMillis) {
+	for (int i = 0; i < BT2_ENERGY_SOURCES; i++) {
+		if (!getIsEnergySource(device, i)) { continue; }
+		const uint16_t registers[2] = { energySources[i].powerRegister, energySources[i].currentRegister };
+		for (int q = 0; q < 2; q++) {
+			if ((uint16_t)(registers[q] - startRegister) >= numberOfRegisters) { continue; }
+			integrateEnergy(device, &device->energy.integrals[i * 2 + q], device->registerValues[getRegisterValueIndex(device, registers[q])], sampleMillis);
+		}
+	}
+	for (int c = 0; c < 2; c++) {										// after the integrals, so a baseline includes this frame
+		if ((uint16_t)(energyCounters[c] - startRegister) >= numberOfRegisters) { continue; }
+		int valueIndex = getRegisterValueIndex(device, energyCounters[c]);
+		if (valueIndex >= 0) { updateEnergyCounter(device, c, device->registerValues[valueIndex]); }
+	}
+}
+
+void BT2Reader::integrateEnergy(DEVICE * device, ENERGY_INTEGRAL * integral, uint16_t value, uint32_t sampleMillis) {
+	if (integral->sampled) {
+		uint32_t elapsed = sampleMillis - integral->lastMillis;
+		if (elapsed <= energyMaximumGapMillis) { integral->sum += (uint64_t)(integral->lastValue + value) * elapsed; }
+		else { device->energy.gaps++; }
+	}
+	integral->lastValue = value;
+	integral->lastMillis = sampleMillis;
+	integral->sampled = true;
+}
+
+/** The drift baseline is taken at the first read of a counter, and again whenever it goes down, which is the
+ * controller starting a new day
+ */
+void BT2Reader::updateEnergyCounter(DEVICE * device, int counter, uint16_t value) {
+	ENERGY_STATE * state = &device->energy;
+	if (!state->counterValid[counter] || value < state->counterLast[counter]) {
+		state->counterBase[counter] = value;
+		state->counterBaseMilli[counter] = getEnergyTotalMilli(device, counter);
+		state->counterValid[counter] = true;
+	}
+	state->counterLast[counter] = value;
+}
+
+/** A source's integral in mWh (quantity 0) or mAh (quantity 1), 0 if the device doesn't have the source
+ */
+uint64_t BT2Reader::getEnergyMilli(DEVICE * device, int source, int quantity) {
+	if (!getIsEnergySource(device, source)) { return 0; }
+	uint16_t registerAddress = (quantity == 0 ? energySources[source].powerRegister : energySources[source].currentRegister);
+	int32_t milliScale = getRegisterMilliScale(device->profile->descriptions[getRegisterDescriptionIndex(device, registerAddress)]);
+	return device->energy.integrals[source * 2 + quantity].sum * milliScale / (2 * 3600000ULL);
+}
+
+uint64_t BT2Reader::getEnergyTotalMilli(DEVICE * device, int quantity) {
+	uint64_t total = 0;
+	for (int i = 0; i < BT2_ENERGY_SOURCES; i++) { total += getEnergyMilli(device, i, quantity); }
+	return total;
+}
+
+boolean BT2Reader::getIsEnergySource(DEVICE * device, int source) {
+	const BT2_ENERGY_SOURCE * energySource = &energySources[source];
+	if (energySource->profile != NULL && energySource->profile != device->profile) { return false; }
+	return (getRegisterDescriptionIndex(device, energySource->powerRegister) >= 0 && getRegisterDescriptionIndex(device, energySource->currentRegister) >= 0);
+}
@@ -0,0 +1,325 @@
+#include "BT2Reader.h"
+
+/** Renders registers into a buffer instead of a Serial.printf per field.  Text mode is the printRegister() layout;
+ * JSON mode is one object per device on a line of its own.  Numbers are formatted from the fixed point value, and
+ * option and bit flag names come straight from the profile's label index
+ */
+
+/** Writes every register of device index that has been read into buffer, and returns the length that needed,
+ * like snprintf: the output is cut short, and always terminated, if that is size or more
+ */
+int BT2Reader::formatDevice(int index, char * buffer, int size, uint8_t mode) {
+	BT2_FORMAT_BUFFER out = { buffer, size, 0, 0, false };
+	if (index >= 0 && index < deviceTableSize) { formatDevice(index, &out, mode); }
+	if (size > 0) { buffer[out.length] = 0; }
+	return out.total;
+}
+
+/** formatDevice() for every device in the table, one after the other */
+int BT2Reader::formatDevices(char * buffer, int size, uint8_t mode) {
+	BT2_FORMAT_BUFFER out = { buffer, size, 0, 0, false };
+	for (int i = 0; i < deviceTableSize; i++) { formatDevice(i, &out, mode); }
+	if (size > 0) { buffer[out.length] = 0; }
+	return out.total;
+}
+
+/** formatDevice() straight to Serial, BT2_PRINT_BUFFER_LENGTH bytes per write */
+void BT2Reader::printDevice(int index, uint8_t mode) {
+	if (index < 0 || index >= deviceTableSize) { return; }
+	char buffer[BT2_PRINT_BUFFER_LENGTH];
+	BT2_FORMAT_BUFFER out = { buffer, sizeof(buffer), 0, 0, true };
+	formatDevice(index, &out, mode);
+	flushFormat(&out);
+}
+
+void BT2Reader::formatDevice(int index, BT2_FORMAT_BUFFER * out, uint8_t mode) {
+	DEVICE * device = &deviceTable[index];
+	const BT2_REGISTER_PROFILE * profile = device->profile;
+	drainFrames(device);
+
+	if (mode == BT2_FORMAT_JSON) {
+		putFormatText(out, "{\"device\":");
+		putFormatNumber(out, index);
+		putFormatText(out, ",\"name\":");
+		putFormatJsonString(out, device->peerName, strnlen(device->peerName, sizeof(device->peerName)));
+		putFormatText(out, ",\"profile\":");
+		putFormatJsonString(out, profile->name, strlen(profile->name));
+		putFormatText(out, ",\"connected\":");
+		putFormatText(out, device->handle != BLE_CONN_HANDLE_INVALID ? "true" : "false");
+		putFormatText(out, ",\"millis\":");
+		putFormatNumber(out, millis());
+		putFormatText(out, ",\"registers\":[");
+	}
+	boolean first = true;
+	for (int d = 0; d < profile->descriptionSize; d++) {
+		uint16_t registerAddress = profile->descriptions[d].address;
+		if (registerAddress == INVALID_REGISTER || !getIsRegisterReceived(device, registerAddress)) { continue; }
+		if (mode == BT2_FORMAT_JSON && !first) { putFormatChar(out, ','); }
+		formatRegister(device, d, out, mode);
+		first = false;
+	}
+	if (mode == BT2_FORMAT_JSON) { putFormatText(out, "]}\n"); }
+}
+
+/** One register, by its description in the device's profile.  Text mode is byte for byte what printRegister()
+ * always printed, down to the "\r\n" of its closing Serial.println()
+ */
+void BT2Reader::formatRegister(DEVICE * device, int descriptionIndex, BT2_FORMAT_BUFFER * out, uint8_t mode) {
+	const BT2_REGISTER_PROFILE * profile = device->profile;
+	const REGISTER_DESCRIPTION * rr = &profile->descriptions[descriptionIndex];
+	const REGISTER_LABEL_ENTRY * labels = &profile->labels[descriptionIndex];
+	const uint16_t * values = &device->registerValues[getRegisterValueIndex(device, rr->address)];
+	uint16_t registerValue = values[0];
+	uint8_t msb = (registerValue >> 8) & 0xFF;
+	uint8_t lsb = (registerValue) & 0xFF;
+	int32_t milliScale = getRegisterMilliScale(*rr);
+	boolean json = (mode == BT2_FORMAT_JSON);
+
+	if (json) {
+		putFormatText(out, "{\"address\":\"");
+		putFormatHex(out, rr->address, 4);
+		putFormatText(out, "\",\"name\":");
+		putFormatJsonString(out, rr->name, strlen(rr->name));
+		putFormatText(out, ",\"value\":");
+	} else {
+		int nameLength = strnlen(device->peerName, sizeof(device->peerName));
+		putFormatText(out, "BT2Reader:");
+		putFormatChar(out, ' ', 10 - nameLength);
+		putFormatText(out, device->peerName, nameLength);
+		putFormatText(out, ": ");
+		putFormatChar(out, ' ', 35 - (int)strlen(rr->name));
+		putFormatText(out, rr->name);
+		putFormatText(out, " (");
+		putFormatHex(out, rr->address, 4);
+		putFormatText(out, "): ");
+	}
+
+	switch(getRegisterUnit(rr->type)) {
+		case RENOGY_BYTES:
+			{
+				if (json) { putFormatChar(out, '"'); }
+				for (int i = 0; i < rr->bytesUsed / 2; i++) {
+					putFormatHex(out, values[i] >> 8, 2);
+					if (!json) { putFormatChar(out, ' '); }
+					putFormatHex(out, values[i] & 0xFF, 2);
+					if (!json) { putFormatChar(out, ' '); }
+				}
+				if (json) { putFormatChar(out, '"'); }
+				break;
+			}
+
+		case RENOGY_CHARS:
+			{
+				char text[MAXIMUM_REGISTERS_PER_READ * 2];
+				int length = 0;
+				for (int i = 0; i < rr->bytesUsed / 2 && length < (int)sizeof(text); i++) {
+					text[length++] = (char)(values[i] >> 8);
+					text[length++] = (char)(values[i] & 0xFF);
+				}
+				if (!json) { putFormatText(out, text, length); break; }
+				while (length > 0 && (text[length - 1] == ' ' || text[length - 1] == 0)) { length--; }
+				putFormatJsonString(out, text, length);
+				break;
+			}
+
+		case RENOGY_DECIMAL:
+			{
+				if (rr->bytesUsed == 4) { putFormatNumber(out, (uint32_t)getRawValue(*rr, values), json ? 0 : 10); break; }
+				putFormatNumber(out, registerValue, json ? 0 : 5);
+				break;
+			}
+		case RENOGY_SIGNED: putFormatNumber(out, getRoundedMilli((int16_t)registerValue * milliScale, 2), json ? 0 : 7, 2); break;
+		case RENOGY_VOLTS: putFormatNumber(out, getRoundedMilli(registerValue * milliScale, 1), json ? 0 : 5, 1); if (!json) { putFormatText(out, " Volts"); } break;
+		case RENOGY_AMPS: putFormatNumber(out, getRoundedMilli((int32_t)getRawValue(*rr, values) * milliScale, 2), json ? 0 : 5, 2); if (!json) { putFormatText(out, " Amps"); } break;
+		case RENOGY_AMP_HOURS: putFormatNumber(out, registerValue, json ? 0 : 3); if (!json) { putFormatText(out, " AH"); } break;
+		case RENOGY_COEFFICIENT: putFormatNumber(out, registerValue * milliScale, json ? 0 : 5, 3); if (!json) { putFormatText(out, " mV/℃/2V"); } break;
+		case RENOGY_TEMPERATURE:
+			{
+				int32_t auxBattery = (lsb & 0x80) > 0 ? -(lsb & 0x7F) : lsb & 0x7F;
+				int32_t controller = (msb & 0x80) > 0 ? -(msb & 0x7F) : msb & 0x7F;
+				if (json) {
+					putFormatChar(out, '[');
+					putFormatNumber(out, auxBattery);
+					putFormatChar(out, ',');
+					putFormatNumber(out, controller);
+					putFormatChar(out, ']');
+					break;
+				}
+				putFormatChar(out, (lsb & 0x80) > 0 ? '-' : '+');
+				putFormatNumber(out, lsb & 0x7F);
+				putFormatText(out, " C, ");
+				putFormatChar(out, (msb & 0x80) > 0 ? '-' : '+');
+				putFormatNumber(out, msb & 0x7F);
+				putFormatText(out, " C, ");
+				break;
+			}
+		case RENOGY_OPTIONS:
+			{
+				const char * optionName = getOptionName(profile, descriptionIndex, registerValue);
+				if (json) {
+					putFormatNumber(out, registerValue);						// raw, so the bits outside the mask stay visible
+					if (optionName == NULL) { break; }
+					putFormatText(out, ",\"option\":");
+					putFormatJsonString(out, optionName, strlen(optionName));
+					break;
+				}
+				putFormatText(out, "Option ");
+				putFormatNumber(out, registerValue & profile->optionMask);
+				putFormatText(out, " (");
+				if (optionName != NULL) {
+					putFormatText(out, optionName);
+					putFormatChar(out, ')');
+				}
+				break;
+			}
+
+		case RENOGY_BIT_FLAGS:
+			{
+				const RENOGY_BIT_FLAG_TABLE * bitFlags = &profile->bitFlags[labels->first];
+				if (json) {
+					putFormatNumber(out, registerValue);
+					putFormatText(out, ",\"flags\":[");
+					boolean firstFlag = true;
+					for (int k = 0; k < labels->count; k++) {
+						if (((registerValue >> bitFlags[k].bit) & 0x01) == 0) { continue; }
+						if (!firstFlag) { putFormatChar(out, ','); }
+						putFormatJsonString(out, bitFlags[k].bitName, strlen(bitFlags[k].bitName));
+						firstFlag = false;
+					}
+					putFormatChar(out, ']');
+					break;
+				}
+				putFormatChar(out, ' ');
+				putFormatHex(out, registerValue, 4);
+				putFormatChar(out, '\n');
+				putFormatChar(out, ' ', 42);
+				for (int i = 15; i >= 0; i--) {
+					putFormatChar(out, HEX_UPPER_CASE[i]);
+					if (i == 8) { putFormatChar(out, ' '); }
+				}
+				putFormatChar(out, '\n');
+				putFormatChar(out, ' ', 42);
+				for (int i = 15; i >= 0; i--) {
+					putFormatChar(out, '0' + ((registerValue >> i) & 0x01));
+					if (i == 8) { putFormatChar(out, ' '); }
+				}
+				for (int k = 0; k < labels->count; k++) {
+					int bit = bitFlags[k].bit;
+					boolean set = ((registerValue >> bit) & 0x01) == 1;
+					putFormatChar(out, '\n');
+					putFormatChar(out, ' ', 42);
+					for (int i = 15; i > bit; i--) { putFormatChar(out, '.'); if (i == 8) { putFormatChar(out, ' '); } }
+					putFormatChar(out, set ? '1' : '0');
+					for (int i = bit; i > 0; i--) { putFormatChar(out, '.'); if (i == 8) { putFormatChar(out, ' '); } }
+					putFormatText(out, "  Bit ");
+					putFormatNumber(out, bit, 2);
+					putFormatChar(out, ':');
+					putFormatText(out, bitFlags[k].bitName);
+					putFormatText(out, set ? " TRUE" : " FALSE");
+				}
+				break;
+			}
+	}
+	putFormatText(out, json ? "}" : "\r\n");									// printRegister() ended with Serial.println()
+}
+
+/** The name of option value for a RENOGY_OPTIONS description, or NULL.  Options are numbered 0, 1, 2.. almost
+ * everywhere, so the name is found by offset, and only a table with gaps falls back to a scan of its register's names.
+ * Bits outside the profile's optionMask are ignored
+ */
+const char * BT2Reader::getOptionName(const BT2_REGISTER_PROFILE * profile, int descriptionIndex, uint16_t value) {
+	const REGISTER_LABEL_ENTRY * labels = &profile->labels[descriptionIndex];
+	if (labels->count == 0) { return NULL; }
+	value &= profile->optionMask;
+	const RENOGY_OPTIONS_TABLE * options = &profile->options[labels->first];
+	int k = value - options[0].option;
+	if (k >= 0 && k < labels->count && options[k].option == value) { return options[k].optionName; }
+	for (k = 0; k < labels->count; k++) {
+		if (options[k].option == value) { return options[k].optionName; }
+	}
+	return NULL;
+}
+
+/** Appends what fits, keeping room for a terminator, and counts the rest in total.  With toSerial, a full buffer
+ * is written out and started again instead
+ */
+void BT2Reader::putFormatText(BT2_FORMAT_BUFFER * out, const char * text, int length) {
+	out->total += length;
+	while (length > 0) {
+		int room = out->size - 1 - out->length;
+		if (room <= 0) {
+			if (!out->toSerial) { return; }
+			flushFormat(out);
+			room = out->size - 1;
+		}
+		int n = min(room, length);
+		memcpy(&out->data[out->length], text, n);
+		out->length += n;
+		text += n;
+		length -= n;
+	}
+}
+
+void BT2Reader::putFormatText(BT2_FORMAT_BUFFER * out, const char * text) { putFormatText(out, text, strlen(text)); }
+
+void BT2Reader::putFormatChar(BT2_FORMAT_BUFFER * out, char c, int count) {
+	if (count <= 0) { return; }
+	if (out->length + count < out->size) {
+		memset(&out->data[out->length], c, count);
+		out->length += count;
+		out->total += count;
+		return;
+	}
+	for (int i = 0; i < count; i++) { putFormatText(out, &c, 1); }
+}
+
+/** value in units of 10^-decimals, right aligned in width like printf's %*.*f */
+void BT2Reader::putFormatNumber(BT2_FORMAT_BUFFER * out, int64_t value, int width, int decimals) {
+	char digits[24];
+	int length = 0;
+	uint64_t magnitude = value < 0 ? -value : value;
+	do {
+		digits[length++] = '0' + magnitude % 10;
+		magnitude /= 10;
+		if (length == decimals) { digits[length++] = '.'; }
+	} while (magnitude > 0 || (decimals > 0 && length <= decimals + 1));
+	if (value < 0) { digits[length++] = '-'; }
+	putFormatChar(out, ' ', width - length);
+	while (length > 0) { putFormatChar(out, digits[--length]); }
+}
+
+/** Thousandths to 10^-decimals, rounded half away from zero as printf does */
+int64_t BT2Reader::getRoundedMilli(int64_t milli, int decimals) {
+	int divisor = (decimals == 0 ? 1000 : decimals == 1 ? 100 : decimals == 2 ? 10 : 1);
+	return (milli < 0 ? -((-milli + divisor / 2) / divisor) : (milli + divisor / 2) / divisor);
+}
+
+void BT2Reader::putFormatHex(BT2_FORMAT_BUFFER * out, uint32_t value, int digits) {
+	for (int i = digits - 1; i >= 0; i--) { putFormatChar(out, "0123456789ABCDEF"[(value >> (4 * i)) & 0x0F]); }
+}
+
+/** text in quotes, with quotes, backslashes, control characters and anything outside ASCII escaped, so a
+ * register full of noise is still valid JSON */
+void BT2Reader::putFormatJsonString(BT2_FORMAT_BUFFER * out, const char * text, int length) {
+	putFormatChar(out, '"');
+	int start = 0;
+	for (int i = 0; i < length; i++) {
+		uint8_t c = text[i];
+		if (c >= 32 && c < 127 && c != '"' && c != '\\') { continue; }
+		putFormatText(out, &text[start], i - start);
+		putFormatChar(out, '\\');
+		if (c == '"' || c == '\\') { putFormatChar(out, c); }
+		else {
+			putFormatText(out, "u00");
+			putFormatHex(out, c, 2);
+		}
+		start = i + 1;
+	}
+	putFormatText(out, &text[start], length - start);
+	putFormatChar(out, '"');
+}
+
+void BT2Reader::flushFormat(BT2_FORMAT_BUFFER * out) {
+	if (out->toSerial && out->length > 0) { Serial.write(out->data, out->length); }
+	out->length = 0;
+}
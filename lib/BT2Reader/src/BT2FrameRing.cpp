@@ -0,0 +1,42 @@
+#include "BT2Reader.h"
+
+/** Handoff from the Bluefruit BLE task to loop().  notifyCallback only assembles and checks frames; each good one
+ * is copied into the device's frameRing and decoded into registerValues, histories and subscriptions on the loop()
+ * side, so getRegister() never sees a half-written frame and the callback takes no locks.
+ *
+ * The ring is single producer, single consumer: frameRingTail is only written by notifyCallback and frameRingHead
+ * only by loop().  Both are free running counters published with release stores and read with acquire loads, so a
+ * slot's contents are visible before the index that hands it over.
+ */
+
+/** Producer side, from completeFrame().  The frame is timestamped here, so register times, history samples and
+ * energy don't depend on how late loop() drains it.  If loop() has fallen BT2_FRAME_RING_LENGTH frames behind the
+ * frame is dropped and counted rather than overwriting one being read
+ */
+void BT2Reader::pushFrame(DEVICE * device) {
+	uint8_t tail = device->frameRingTail;
+	uint8_t head = __atomic_load_n(&device->frameRingHead, __ATOMIC_ACQUIRE);
+	if ((uint8_t)(tail - head) >= BT2_FRAME_RING_LENGTH) {
+		device->stats.framesDropped++;
+		return;
+	}
+	BT2_FRAME * frame = &device->frameRing[tail & (BT2_FRAME_RING_LENGTH - 1)];
+	frame->startRegister = device->registerExpected;
+	frame->numberOfRegisters = device->dataReceived[2] / 2;
+	frame->receivedMillis = millis();
+	memcpy(frame->data, &device->dataReceived[3], frame->numberOfRegisters * 2);
+	__atomic_store_n(&device->frameRingTail, (uint8_t)(tail + 1), __ATOMIC_RELEASE);
+}
+
+/** Consumer side: decodes every frame waiting for the device.  Called from service() and at the top of every
+ * register getter, all loop() context, so reads see whole frames without the application calling anything new
+ */
+void BT2Reader::drainFrames(DEVICE * device) {
+	uint8_t head = device->frameRingHead;
+	uint8_t tail = __atomic_load_n(&device->frameRingTail, __ATOMIC_ACQUIRE);
+	while (head != tail) {
+		processDataReceived(device, &device->frameRing[head & (BT2_FRAME_RING_LENGTH - 1)]);
+		head++;
+		__atomic_store_n(&device->frameRingHead, head, __ATOMIC_RELEASE);
+	}
+}
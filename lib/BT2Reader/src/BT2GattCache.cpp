@@ -0,0 +1,128 @@
+#include "BT2Reader.h"
+
+/** GATT handle cache.  Discovering the BT2's two services and characteristics takes several connection interval
+ * round trips on every connect.  The handles don't change for a given BT2, so after the first discovery they're
+ * remembered by peer address, and the next connection binds the characteristics to them directly and enables
+ * notify with a single CCCD write.  If the first read on cached handles then times out, the handles are
+ * forgotten and the link dropped, so the reconnect falls back to a full discovery.
+ */
+
+/** Full discovery, as every connection used to do.  Returns false if the BT2's services aren't there
+ */
+boolean BT2Reader::discoverGatt(DEVICE * device, uint16_t connectionHandle) {
+	if (!device->txService.discover(connectionHandle) || !device->txCharacteristic.discover()) {
+		logerror("Renogy Tx service or characteristic not discovered, disconnecting\n");
+		return false;
+	}
+	if (!device->rxService.discover(connectionHandle) || !device->rxCharacteristic.discover()) {
+		logerror("Renogy Rx service or characteristic not discovered, disconnecting\n");
+		return false;
+	}
+	device->rxCharacteristic.enableNotify();
+	rememberGattHandles(device);
+	return true;
+}
+
+/** Binds device's services and characteristics from the handles cached for its address.  The BT2's CCCD follows
+ * the Rx value handle, so notify is enabled by writing it directly rather than discovering it first
+ */
+boolean BT2Reader::bindCachedGatt(DEVICE * device, uint16_t connectionHandle) {
+	GATT_HANDLES * handles = getGattHandles(device->peerAddress);
+	if (handles == NULL) { return false; }
+	device->txService.bind(connectionHandle);
+	device->rxService.bind(connectionHandle);
+	device->txCharacteristic._assign(&handles->txCharacteristic);
+	device->rxCharacteristic._assign(&handles->rxCharacteristic);
+
+	uint8_t enableNotify[2] = { 0x01, 0x00 };
+	ble_gattc_write_params_t params;
+	memset(&params, 0, sizeof(params));
+	params.write_op = BLE_GATT_OP_WRITE_REQ;
+	params.handle = handles->rxCharacteristic.handle_value + 1;
+	params.len = sizeof(enableNotify);
+	params.p_value = enableNotify;
+	if (sd_ble_gattc_write(connectionHandle, &params) != NRF_SUCCESS) {
+		forgetGattHandles(device->peerAddress);
+		return false;
+	}
+	handles->lastUsedMillis = millis();
+	log("Bound cached GATT handles 0x%04X / 0x%04X\n", handles->txCharacteristic.handle_value, handles->rxCharacteristic.handle_value);
+	return true;
+}
+
+GATT_HANDLES * BT2Reader::getGattHandles(uint8_t * peerAddress) {
+	if (memcmp(peerAddress, BLANK_MACID, 6) == 0) { return NULL; }
+	for (int i = 0; i < MAXIMUM_BT2_DEVICES; i++) {
+		if (memcmp(gattHandles[i].peerAddress, peerAddress, 6) == 0) { return &gattHandles[i]; }
+	}
+	return NULL;
+}
+
+/** Records device's discovered handles, replacing the least recently used entry if the cache is full
+ */
+void BT2Reader::rememberGattHandles(DEVICE * device) {
+	GATT_HANDLES * handles = getGattHandles(device->peerAddress);
+	for (int i = 0; handles == NULL && i < MAXIMUM_BT2_DEVICES; i++) {
+		if (memcmp(gattHandles[i].peerAddress, BLANK_MACID, 6) == 0) { handles = &gattHandles[i]; }
+	}
+	if (handles == NULL) {
+		uint32_t now = millis();
+		int oldest = 0;
+		for (int i = 1; i < MAXIMUM_BT2_DEVICES; i++) {
+			if (now - gattHandles[i].lastUsedMillis > now - gattHandles[oldest].lastUsedMillis) { oldest = i; }
+		}
+		handles = &gattHandles[oldest];
+	}
+	memcpy(handles->peerAddress, device->peerAddress, 6);
+	ble_gattc_char_t characteristic;
+	memset(&characteristic, 0, sizeof(characteristic));
+	uint8_t properties = device->txCharacteristic.properties();
+	memcpy(&characteristic.char_props, &properties, 1);
+	characteristic.handle_value = device->txCharacteristic.valueHandle();
+	characteristic.handle_decl = characteristic.handle_value - 1;
+	handles->txCharacteristic = characteristic;
+	properties = device->rxCharacteristic.properties();
+	memcpy(&characteristic.char_props, &properties, 1);
+	characteristic.handle_value = device->rxCharacteristic.valueHandle();
+	characteristic.handle_decl = characteristic.handle_value - 1;
+	handles->rxCharacteristic = characteristic;
+	handles->lastUsedMillis = millis();
+}
+
+void BT2Reader::forgetGattHandles(uint8_t * peerAddress) {
+	GATT_HANDLES * handles = getGattHandles(peerAddress);
+	if (handles != NULL) { memset(handles, 0, sizeof(GATT_HANDLES)); }
+}
+
+/** Called on the first good frame after connecting; this is what getConnectToReadyMillis() times
+ */
+void BT2Reader::markDeviceReady(DEVICE * device) {
+	device->ready = true;
+	device->connectToReadyMillis = millis() - device->connectedMillis;
+	device->gattFromCache = false;
+	device->stats.connectToReadyMillis = device->connectToReadyMillis;
+	device->stats.connectToReadyMaxMillis = max(device->stats.connectToReadyMaxMillis, device->connectToReadyMillis);
+}
+
+/** Milliseconds from the link coming up to the first good response, including discovery; 0 until then
+ */
+uint32_t BT2Reader::getConnectToReadyMillis(int index) {
+	if (index < 0 || index >= deviceTableSize || !deviceTable[index].ready) { return 0; }
+	return max(deviceTable[index].connectToReadyMillis, (uint32_t)1);
+}
+
+/** True while a connection bound from cached handles is waiting for its first response
+ */
+boolean BT2Reader::getIsGattFromCache(int index) {
+	if (index < 0 || index >= deviceTableSize) { return false; }
+	return deviceTable[index].gattFromCache;
+}
+
+/** The cached handles didn't work: forget them and drop the link so the reconnect discovers afresh
+ */
+void BT2Reader::rejectCachedGatt(DEVICE * device) {
+	logerror("No response on cached GATT handles for %s, rediscovering\n", device->peerName);
+	forgetGattHandles(device->peerAddress);
+	device->gattFromCache = false;
+	Bluefruit.disconnect(device->handle);
+}
@@ -0,0 +1,203 @@
+#include "BT2Reader.h"
+
+void BT2RegisterHistory::clear() {
+	memset(blocks, 0, sizeof(blocks));
+	currentBlock = 0;
+	sampleCount = 0;
+}
+
+/** Appends a sample.  Timestamps are kept to the nearest BT2_HISTORY_TICK_MILLIS, so poll jitter mostly costs
+ * nothing.  If the encoded sample won't fit in the current block it starts a new one, uncompressed in its header
+ */
+void BT2RegisterHistory::append(uint32_t sampleMillis, uint16_t value) {
+	BT2_HISTORY_BLOCK * block = &blocks[currentBlock];
+	if (block->samples == 0) {
+		startBlock(sampleMillis, value);
+		return;
+	}
+
+	int32_t elapsed = (int32_t)(sampleMillis - lastMillis);					// wraps correctly across millis() rollover
+	int32_t delta = (elapsed + (elapsed < 0 ? -BT2_HISTORY_TICK_MILLIS : BT2_HISTORY_TICK_MILLIS) / 2) / BT2_HISTORY_TICK_MILLIS;
+	int32_t deltaOfDelta = delta - lastDelta;
+	int timeBits = 36;
+	if (deltaOfDelta == 0) {
+		timeBits = 1;
+	} else if (deltaOfDelta >= -63 && deltaOfDelta <= 64) {
+		timeBits = 9;
+	} else if (deltaOfDelta >= -255 && deltaOfDelta <= 256) {
+		timeBits = 12;
+	} else if (deltaOfDelta >= -2047 && deltaOfDelta <= 2048) {
+		timeBits = 16;
+	}
+
+	uint16_t xorValue = value ^ lastValue;
+	int leadingZeros = 0;
+	int trailingZeros = 0;
+	int meaningfulBits = 0;
+	if (xorValue != 0) {
+		leadingZeros = __builtin_clz((uint32_t)xorValue) - 16;
+		trailingZeros = __builtin_ctz((uint32_t)xorValue);
+		meaningfulBits = 16 - leadingZeros - trailingZeros;
+	}
+	int valueBits = xorValue == 0 ? 1 : 9 + meaningfulBits;
+
+	if (block->bitLength + timeBits + valueBits > BT2_HISTORY_BLOCK_BYTES * 8) {
+		currentBlock = (currentBlock + 1) % BT2_HISTORY_BLOCKS;
+		startBlock(sampleMillis, value);
+		return;
+	}
+
+	switch (timeBits) {
+		case 1:	 writeBits(block, 0x0, 1); break;
+		case 9:	 writeBits(block, 0x2, 2); writeBits(block, deltaOfDelta + 63, 7); break;
+		case 12: writeBits(block, 0x6, 3); writeBits(block, deltaOfDelta + 255, 9); break;
+		case 16: writeBits(block, 0xE, 4); writeBits(block, deltaOfDelta + 2047, 12); break;
+		default: writeBits(block, 0xF, 4); writeBits(block, (uint32_t)deltaOfDelta, 32); break;
+	}
+	if (xorValue == 0) {
+		writeBits(block, 0x0, 1);
+	} else {
+		writeBits(block, 0x1, 1);
+		writeBits(block, leadingZeros, 4);
+		writeBits(block, meaningfulBits - 1, 4);
+		writeBits(block, xorValue >> trailingZeros, meaningfulBits);
+	}
+
+	block->samples++;
+	sampleCount++;
+	lastDelta = delta;
+	lastMillis += delta * BT2_HISTORY_TICK_MILLIS;							// the decoder's view, so rounding never accumulates
+	lastValue = value;
+}
+
+void BT2RegisterHistory::startBlock(uint32_t sampleMillis, uint16_t value) {
+	BT2_HISTORY_BLOCK * block = &blocks[currentBlock];
+	if (block->samples != 0) { sampleCount -= block->samples; }				// overwriting the oldest block
+	block->firstMillis = sampleMillis;
+	block->firstValue = value;
+	block->samples = 1;
+	block->bitLength = 0;
+	sampleCount++;
+	lastDelta = 0;
+	lastMillis = sampleMillis;
+	lastValue = value;
+}
+
+/** Min, max and mean of the samples taken in the windowMillis before nowMillis, sign extended if signedValues.  A
+ * sample stored up to half a BT2_HISTORY_TICK_MILLIS after nowMillis counts as in the window.  Returns false if
+ * there are none
+ */
+boolean BT2RegisterHistory::getSummary(uint32_t nowMillis, uint32_t windowMillis, BT2_HISTORY_SUMMARY * summary) {
+	uint32_t samples = 0;
+	int64_t total = 0;
+	int32_t minimum = INT32_MAX;
+	int32_t maximum = INT32_MIN;
+	uint32_t firstMillis = 0;
+	uint32_t lastSampleMillis = 0;
+	forEachSample([&](uint32_t sampleMillis, uint16_t rawValue) {
+		if ((int32_t)(nowMillis - sampleMillis) > 0 && nowMillis - sampleMillis > windowMillis) { return; }	// tick rounding can put the newest after nowMillis
+		int32_t value = signedValues ? (int16_t)rawValue : rawValue;
+		if (samples == 0) { firstMillis = sampleMillis; }
+		samples++;
+		total += value;
+		minimum = min(minimum, value);
+		maximum = max(maximum, value);
+		lastSampleMillis = sampleMillis;
+	});
+	if (samples == 0) { return false; }
+	summary->samples = samples;
+	summary->minimum = minimum;
+	summary->maximum = maximum;
+	summary->mean = (float)total / samples;
+	summary->firstMillis = firstMillis;
+	summary->lastMillis = lastSampleMillis;
+	return true;
+}
+
+uint32_t BT2RegisterHistory::getSampleCount() { return sampleCount; }
+
+/** Bytes of compressed sample data currently held, including each block's uncompressed first sample
+ */
+int BT2RegisterHistory::getBytesUsed() {
+	int bytesUsed = 0;
+	for (int i = 0; i < BT2_HISTORY_BLOCKS; i++) {
+		if (blocks[i].samples == 0) { continue; }
+		bytesUsed += 6 + (blocks[i].bitLength + 7) / 8;
+	}
+	return bytesUsed;
+}
+
+void BT2RegisterHistory::writeBits(BT2_HISTORY_BLOCK * block, uint32_t bits, int count) {
+	for (int i = count - 1; i >= 0; i--) {
+		int byteIndex = block->bitLength >> 3;
+		int bitIndex = 7 - (block->bitLength & 0x07);
+		if (bitIndex == 7) { block->data[byteIndex] = 0; }
+		block->data[byteIndex] |= ((bits >> i) & 0x01) << bitIndex;
+		block->bitLength++;
+	}
+}
+
+uint32_t BT2RegisterHistory::readBits(BT2_HISTORY_BLOCK * block, int * bitPosition, int count) {
+	uint32_t bits = 0;
+	for (int i = 0; i < count; i++) {
+		bits = (bits << 1) | ((block->data[*bitPosition >> 3] >> (7 - (*bitPosition & 0x07))) & 0x01);
+		(*bitPosition)++;
+	}
+	return bits;
+}
+
+int32_t BT2RegisterHistory::readDeltaOfDelta(BT2_HISTORY_BLOCK * block, int * bitPosition) {
+	if (readBits(block, bitPosition, 1) == 0) { return 0; }
+	if (readBits(block, bitPosition, 1) == 0) { return (int32_t)readBits(block, bitPosition, 7) - 63; }
+	if (readBits(block, bitPosition, 1) == 0) { return (int32_t)readBits(block, bitPosition, 9) - 255; }
+	if (readBits(block, bitPosition, 1) == 0) { return (int32_t)readBits(block, bitPosition, 12) - 2047; }
+	return (int32_t)readBits(block, bitPosition, 32);
+}
+
+uint16_t BT2RegisterHistory::readXor(BT2_HISTORY_BLOCK * block, int * bitPosition) {
+	if (readBits(block, bitPosition, 1) == 0) { return 0; }
+	int leadingZeros = readBits(block, bitPosition, 4);
+	int meaningfulBits = readBits(block, bitPosition, 4) + 1;
+	return (uint16_t)(readBits(block, bitPosition, meaningfulBits) << (16 - leadingZeros - meaningfulBits));
+}
+
+
+/** Starts recording registerAddress on device index into history, which the caller owns (usually a global, so
+ * the RAM is visible at link time).  Only registers in the device's profile can be recorded, and a signed one is
+ * summarized signed
+ */
+boolean BT2Reader::addHistory(int index, uint16_t registerAddress, BT2RegisterHistory * history) {
+	if (index < 0 || index >= deviceTableSize || history == NULL) { return false; }
+	if (getRegisterValueIndex(&deviceTable[index], registerAddress) < 0) {
+		logerror("Register 0x%04X has no description, can't record history\n", registerAddress);
+		return false;
+	}
+	if (historyCount >= MAXIMUM_HISTORIES || getHistory(index, registerAddress) != NULL) { return false; }
+	history->clear();
+	history->deviceIndex = index;
+	history->registerAddress = registerAddress;
+	int descriptionIndex = getRegisterDescriptionIndex(&deviceTable[index], registerAddress);
+	history->signedValues = (descriptionIndex >= 0 && getIsRegisterSigned(deviceTable[index].profile->descriptions[descriptionIndex].type));
+	histories[historyCount++] = history;
+	return true;
+}
+
+BT2RegisterHistory * BT2Reader::getHistory(int index, uint16_t registerAddress) {
+	for (int i = 0; i < historyCount; i++) {
+		if (histories[i]->deviceIndex == index && histories[i]->registerAddress == registerAddress) { return histories[i]; }
+	}
+	return NULL;
+}
+
+/** Called by processDataReceived for every good frame
+ */
+void BT2Reader::appendHistories(DEVICE * device, uint16_t startRegister, int numberOfRegisters, uint32_t sampleMillis) {
+	int index = device - deviceTable;
+	for (int i = 0; i < historyCount; i++) {
+		BT2RegisterHistory * history = histories[i];
+		if (history->deviceIndex != index) { continue; }
+		if ((uint16_t)(history->registerAddress - startRegister) >= numberOfRegisters) { continue; }
+		int valueIndex = getRegisterValueIndex(device, history->registerAddress);
+		if (valueIndex >= 0) { history->append(sampleMillis, device->registerValues[valueIndex]); }		// not in a profile bound since
+	}
+}
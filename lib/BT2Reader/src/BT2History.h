@@ -0,0 +1,88 @@
+#ifndef BT2_HISTORY_H
+#define BT2_HISTORY_H
+
+#include "Arduino.h"
+
+/**	Compressed in-RAM history of one register.  Samples are packed Gorilla style into a ring of small blocks:
+ * timestamps as delta-of-delta in BT2_HISTORY_TICK_MILLIS ticks (a steady poll rate costs 1 bit, a late or early
+ * poll 9), and values as the XOR with the previous value (an unchanged value costs 1 bit, a small change 10-16).
+ * When the ring is full the oldest block is dropped, so memory is fixed at sizeof(BT2RegisterHistory), about
+ * 330 bytes, or about 2.6KB a device for eight registers.
+ *
+ * Attach one to a register with BT2Reader::addHistory(); it's appended to every time that register is read.
+ */
+
+#define BT2_HISTORY_BLOCKS				4
+#define BT2_HISTORY_BLOCK_BYTES			64
+#define BT2_HISTORY_TICK_MILLIS			100			// timestamp resolution
+
+struct BT2_HISTORY_BLOCK {
+	uint32_t firstMillis;
+	uint16_t firstValue;
+	uint16_t samples;														// 0 if the block is unused
+	uint16_t bitLength;
+	uint8_t data[BT2_HISTORY_BLOCK_BYTES];
+};
+
+struct BT2_HISTORY_SUMMARY {
+	uint32_t samples;
+	int32_t minimum;														// sign extended if signedValues
+	int32_t maximum;
+	float mean;
+	uint32_t firstMillis;
+	uint32_t lastMillis;
+};
+
+
+class BT2RegisterHistory {
+
+public:
+
+	void clear();
+	void append(uint32_t sampleMillis, uint16_t value);
+	boolean getSummary(uint32_t nowMillis, uint32_t windowMillis, BT2_HISTORY_SUMMARY * summary);
+	uint32_t getSampleCount();
+	int getBytesUsed();
+
+	/** Calls fn(sampleMillis, value) for every stored sample, oldest first.  sampleMillis is within
+	 * BT2_HISTORY_TICK_MILLIS / 2 of the time appended
+	 */
+	template <typename F> void forEachSample(F fn) {
+		for (int i = 1; i <= BT2_HISTORY_BLOCKS; i++) {
+			BT2_HISTORY_BLOCK * block = &blocks[(currentBlock + i) % BT2_HISTORY_BLOCKS];
+			if (block->samples == 0) { continue; }
+			uint32_t sampleMillis = block->firstMillis;
+			uint16_t value = block->firstValue;
+			int32_t delta = 0;
+			int bitPosition = 0;
+			fn(sampleMillis, value);
+			for (int j = 1; j < block->samples; j++) {
+				delta += readDeltaOfDelta(block, &bitPosition);
+				sampleMillis += delta * BT2_HISTORY_TICK_MILLIS;
+				value ^= readXor(block, &bitPosition);
+				fn(sampleMillis, value);
+			}
+		}
+	}
+
+	int deviceIndex = -1;													// set by BT2Reader::addHistory
+	uint16_t registerAddress = 0;
+	boolean signedValues = false;											// two's complement register; forEachSample still gives raw values
+
+private:
+
+	BT2_HISTORY_BLOCK blocks[BT2_HISTORY_BLOCKS];
+	int currentBlock = 0;
+	uint32_t lastMillis = 0;
+	int32_t lastDelta = 0;
+	uint16_t lastValue = 0;
+	uint32_t sampleCount = 0;
+
+	void startBlock(uint32_t sampleMillis, uint16_t value);
+	void writeBits(BT2_HISTORY_BLOCK * block, uint32_t bits, int count);
+	uint32_t readBits(BT2_HISTORY_BLOCK * block, int * bitPosition, int count);
+	int32_t readDeltaOfDelta(BT2_HISTORY_BLOCK * block, int * bitPosition);
+	uint16_t readXor(BT2_HISTORY_BLOCK * block, int * bitPosition);
+};
+
+#endif
@@ -0,0 +1,163 @@
+#include "BT2Reader.h"
+#include <InternalFileSystem.h>
+
+using namespace Adafruit_LittleFS_Namespace;
+
+/** Identity cache.  Product model, versions, serial number and battery settings don't change while a BT2 is
+ * connected, and rarely at all, so they're saved per peer MAC in InternalFS (a directory on the native build).
+ * On reconnect they're loaded before the first read is sent, so getProductModel() and friends answer straight
+ * away and a poll schedule can spend its first round trips on live data, revalidating the identity later.
+ *
+ * File layout, little endian: "BT2C", BT2_IDENTITY_CACHE_VERSION, range count, then for each of
+ * identityRegisters the start register, register count and values, then the Modbus CRC of all of that.
+ */
+
+#define BT2_IDENTITY_CACHE_VERSION		1
+#define BT2_IDENTITY_CACHE_DIRECTORY	"/bt2"
+
+/** Mounts InternalFS and turns the cache on; call before the first connection
+ */
+boolean BT2Reader::beginIdentityCache() {
+	if (!InternalFS.begin()) {
+		logerror("InternalFS failed to start, identity cache disabled\n");
+		return false;
+	}
+	InternalFS.mkdir(BT2_IDENTITY_CACHE_DIRECTORY);
+	identityCacheEnabled = true;
+	return true;
+}
+
+/** True if device index's identity registers came from the cache and haven't been re-read yet
+ */
+boolean BT2Reader::getIsIdentityFromCache(int index) {
+	if (index < 0 || index >= deviceTableSize) { return false; }
+	return deviceTable[index].identityFromCache;
+}
+
+/** Forgets device index's cached identity, e.g. after swapping the controller behind a BT2
+ */
+void BT2Reader::clearIdentityCache(int index) {
+	if (!identityCacheEnabled || index < 0 || index >= deviceTableSize) { return; }
+	char path[32];
+	getIdentityCachePath(&deviceTable[index], path, sizeof(path));
+	InternalFS.remove(path);
+	deviceTable[index].identityCacheChecksum = 0;
+}
+
+void BT2Reader::getIdentityCachePath(DEVICE * device, char * path, int size) {
+	const uint8_t * a = device->peerAddress;
+	snprintf(path, size, BT2_IDENTITY_CACHE_DIRECTORY "/%02x%02x%02x%02x%02x%02x.bin", a[5], a[4], a[3], a[2], a[1], a[0]);
+}
+
+boolean BT2Reader::getIsIdentityRange(uint16_t startRegister, uint16_t numberOfRegisters) {
+	for (int i = 0; i < IDENTITY_REGISTER_RANGES; i++) {
+		if (startRegister >= identityRegisters[i].startRegister && 
+			startRegister + numberOfRegisters <= identityRegisters[i].startRegister + identityRegisters[i].numberOfRegisters) { return true; }
+	}
+	return false;
+}
+
+/** Writes the file image of device's identity registers to buffer and returns its length
+ */
+int BT2Reader::buildIdentityCache(DEVICE * device, uint8_t * buffer) {
+	int length = 0;
+	memcpy(buffer, "BT2C", 4);
+	length += 4;
+	buffer[length++] = BT2_IDENTITY_CACHE_VERSION;
+	buffer[length++] = IDENTITY_REGISTER_RANGES;
+	for (int i = 0; i < IDENTITY_REGISTER_RANGES; i++) {
+		const RENOGY_COMMANDS * range = &identityRegisters[i];
+		buffer[length++] = range->startRegister & 0xFF;
+		buffer[length++] = range->startRegister >> 8;
+		buffer[length++] = range->numberOfRegisters & 0xFF;
+		buffer[length++] = range->numberOfRegisters >> 8;
+		for (int k = 0; k < range->numberOfRegisters; k++) {
+			const REGISTER_INDEX_ENTRY * entry = getRegisterIndexEntry(device, range->startRegister + k);
+			uint16_t value = (entry == NULL || entry->valueIndex == REGISTER_INDEX_NONE) ? 0 : device->registerValues[entry->valueIndex];
+			buffer[length++] = value & 0xFF;
+			buffer[length++] = value >> 8;
+		}
+	}
+	uint16_t checksum = getCalculatedModbusChecksum(buffer, 0, length);
+	buffer[length++] = checksum & 0xFF;
+	buffer[length++] = checksum >> 8;
+	return length;
+}
+
+/** Called from connectCallback.  Applies the cached registers if the file is intact and the same version and
+ * layout as this build; anything else is ignored and the registers are simply read as usual
+ */
+boolean BT2Reader::loadIdentityCache(DEVICE * device) {
+	device->identityFromCache = false;
+	device->identityCacheChecksum = 0;
+	char path[32];
+	getIdentityCachePath(device, path, sizeof(path));
+	File file(InternalFS);
+	if (!file.open(path, FILE_O_READ)) { return false; }
+	uint8_t buffer[IDENTITY_CACHE_SIZE + 1];								// a longer file won't match either
+	int length = file.read(buffer, sizeof(buffer));
+	file.close();
+
+	uint8_t expected[IDENTITY_CACHE_SIZE];
+	if (length != buildIdentityCache(device, expected) || memcmp(buffer, expected, 6) != 0 ||
+		getCalculatedModbusChecksum(buffer, 0, length - 2) != buffer[length - 2] + buffer[length - 1] * 256) {
+		logerror("Identity cache for %s is stale or corrupt, ignoring it\n", path);
+		return false;
+	}
+
+	int offset = 6;
+	for (int i = 0; i < IDENTITY_REGISTER_RANGES; i++) {
+		if (memcmp(&buffer[offset], &expected[offset], 4) != 0) {
+			logerror("Identity cache for %s has a different register layout, ignoring it\n", path);
+			return false;
+		}
+		offset += 4 + identityRegisters[i].numberOfRegisters * 2;
+	}
+	offset = 6;
+	for (int i = 0; i < IDENTITY_REGISTER_RANGES; i++) {
+		const RENOGY_COMMANDS * range = &identityRegisters[i];
+		offset += 4;
+		for (int k = 0; k < range->numberOfRegisters; k++, offset += 2) {
+			const REGISTER_INDEX_ENTRY * entry = getRegisterIndexEntry(device, range->startRegister + k);
+			if (entry != NULL && entry->valueIndex != REGISTER_INDEX_NONE) { device->registerValues[entry->valueIndex] = buffer[offset] + buffer[offset + 1] * 256; }
+		}
+		recordFrameRun(device, range->startRegister, range->numberOfRegisters, millis());
+	}
+	device->productModelDecoded = false;
+	device->identityFromCache = true;
+	device->identityCacheChecksum = buffer[length - 2] + buffer[length - 1] * 256;
+	log("Identity for %s loaded from cache\n", path);
+	return true;
+}
+
+/** Called from service() after a read touched the identity registers.  Writes the file once every identity
+ * register has been read, and only if it changed, to spare the flash
+ */
+void BT2Reader::saveIdentityCache(int index) {
+	DEVICE * device = &deviceTable[index];
+	device->identityCacheDirty = false;
+	for (int i = 0; i < IDENTITY_REGISTER_RANGES; i++) {
+		const RENOGY_COMMANDS * range = &identityRegisters[i];
+		for (int k = 0; k < range->numberOfRegisters; k++) {
+			const REGISTER_INDEX_ENTRY * entry = getRegisterIndexEntry(device, range->startRegister + k);
+			if (entry != NULL && entry->valueIndex != REGISTER_INDEX_NONE && !getIsRegisterReceived(device, range->startRegister + k)) { return; }
+		}
+	}
+
+	uint8_t buffer[IDENTITY_CACHE_SIZE];
+	int length = buildIdentityCache(device, buffer);
+	uint16_t checksum = buffer[length - 2] + buffer[length - 1] * 256;
+	if (checksum == device->identityCacheChecksum) { return; }
+
+	char path[32];
+	getIdentityCachePath(device, path, sizeof(path));
+	InternalFS.remove(path);
+	File file(InternalFS);
+	if (!file.open(path, FILE_O_WRITE) || file.write(buffer, length) != (size_t)length) {
+		logerror("Couldn't write identity cache %s\n", path);
+		return;
+	}
+	file.close();
+	device->identityCacheChecksum = checksum;
+	log("Identity for %s saved to cache\n", path);
+}
@@ -0,0 +1,153 @@
+#include "BT2Reader.h"
+
+void BT2PollSchedule::clear() { groupCount = 0; }
+
+/** Adds a group read as one command, polled every minimumPeriodMillis while its values change and backing off
+ * to maximumPeriodMillis while they don't.  A minimum of 0 polls the group whenever nothing else is due
+ */
+boolean BT2PollSchedule::addGroup(uint16_t startRegister, uint16_t numberOfRegisters, uint32_t minimumPeriodMillis, uint32_t maximumPeriodMillis) {
+	if (groupCount == MAXIMUM_POLL_GROUPS || numberOfRegisters == 0 || numberOfRegisters > MAXIMUM_REGISTERS_PER_READ) { return false; }
+	POLL_GROUP * group = &groups[groupCount++];
+	group->startRegister = startRegister;
+	group->numberOfRegisters = numberOfRegisters;
+	group->minimumPeriodMillis = minimumPeriodMillis;
+	group->maximumPeriodMillis = max(minimumPeriodMillis, maximumPeriodMillis);
+	group->readOnce = false;
+	return true;
+}
+
+/** Adds a group that's read once per connection, for identity registers that never change
+ */
+boolean BT2PollSchedule::addStaticGroup(uint16_t startRegister, uint16_t numberOfRegisters) {
+	if (!addGroup(startRegister, numberOfRegisters, 0, 0)) { return false; }
+	groups[groupCount - 1].readOnce = true;
+	return true;
+}
+
+/** Groups for a DC-DC charger: identity once, live power as fast as the link allows, charging state and error
+ * flags within a few seconds, daily totals and battery settings slowly
+ */
+boolean BT2PollSchedule::addDefaultGroups() {
+	return (addStaticGroup(RENOGY_PRODUCT_MODEL, RENOGY_CONTROLLER_ADDRESS - RENOGY_PRODUCT_MODEL + 1) &&
+		addGroup(RENOGY_AUX_BATT_SOC, RENOGY_SOLAR_POWER - RENOGY_AUX_BATT_SOC + 1, 0, 1000) &&
+		addGroup(RENOGY_CHARGING_MODE, RENOGY_ERROR_FLAGS_2 - RENOGY_CHARGING_MODE + 1, 500, 5000) &&
+		addGroup(RENOGY_AUX_BATT_LOW_VOLTAGE, RENOGY_TODAY_POWER - RENOGY_AUX_BATT_LOW_VOLTAGE + 1, 5000, 60000) &&
+		addGroup(RENOGY_AUX_BATT_CAPACITY, RENOGY_AUX_BATT_TYPE - RENOGY_AUX_BATT_CAPACITY + 1, 60000, 600000));
+}
+
+int BT2PollSchedule::getGroupCount() { return groupCount; }
+
+const POLL_GROUP * BT2PollSchedule::getGroup(int i) {
+	if (i < 0 || i >= groupCount) { return NULL; }
+	return &groups[i];
+}
+
+
+/** Polls schedule on every device instead of a read plan; setPollSchedule(index, schedule) gives one device its
+ * own.  NULL stops it.  The schedule must outlive the reader
+ */
+void BT2Reader::setPollSchedule(BT2PollSchedule * schedule) {
+	for (int i = 0; i < deviceTableSize; i++) { setPollSchedule(i, schedule); }
+}
+
+void BT2Reader::setPollSchedule(int index, BT2PollSchedule * schedule) {
+	if (index < 0 || index >= deviceTableSize) { return; }
+	deviceTable[index].pollSchedule = schedule;
+	resetPollGroups(&deviceTable[index]);
+}
+
+/** The current period of a group on a device, for seeing where the link time is going
+ */
+uint32_t BT2Reader::getPollPeriod(int index, int group) {
+	if (index < 0 || index >= deviceTableSize || group < 0 || group >= MAXIMUM_POLL_GROUPS) { return 0; }
+	return deviceTable[index].pollGroups[group].periodMillis;
+}
+
+/** Forgets what's been read, so static groups are read again; called on every connection.  Groups the identity
+ * cache has just supplied count as read
+ */
+void BT2Reader::resetPollGroups(DEVICE * device) {
+	memset(device->pollGroups, 0, sizeof(device->pollGroups));
+	device->pollRequestId = 0;
+	if (device->pollSchedule == NULL) { return; }
+	for (int i = 0; i < device->pollSchedule->getGroupCount(); i++) {
+		const POLL_GROUP * group = device->pollSchedule->getGroup(i);
+		POLL_GROUP_STATE * state = &device->pollGroups[i];
+		state->periodMillis = group->minimumPeriodMillis;
+		if (device->identityFromCache && getIsIdentityRange(group->startRegister, group->numberOfRegisters)) {
+			state->read = true;												// already have it; check it later
+			state->lastReadMillis = millis();
+			state->revalidate = group->readOnce;
+			if (group->readOnce) { state->periodMillis = BT2_CACHE_REVALIDATE_MILLIS; }
+		}
+	}
+}
+
+/** Queues the most overdue group, groups never tried first.  A group whose read failed competes on overdue time
+ * like the rest, so one the device rejects can't starve the others.  Returns false if nothing is due yet
+ */
+boolean BT2Reader::queueNextPollGroup(int index) {
+	DEVICE * device = &deviceTable[index];
+	BT2PollSchedule * schedule = device->pollSchedule;
+	uint32_t now = millis();
+	int next = -1;
+	int32_t nextOverdue = -1;
+	for (int i = 0; i < schedule->getGroupCount(); i++) {
+		POLL_GROUP_STATE * state = &device->pollGroups[i];
+		if (!state->read && !state->attempted) {
+			next = i;
+			break;
+		}
+		if (schedule->getGroup(i)->readOnce && state->read && !state->revalidate) { continue; }
+		int32_t overdue = (int32_t)(now - state->lastReadMillis - state->periodMillis);
+		if (overdue > nextOverdue) {
+			next = i;
+			nextOverdue = overdue;
+		}
+	}
+	if (next < 0) { return false; }
+
+	const POLL_GROUP * group = schedule->getGroup(next);
+	int requestId = queueReadCommand(index, group->startRegister, group->numberOfRegisters, pollCallback);
+	if (requestId <= 0) { return false; }
+	device->pollGroup = next;
+	device->pollRequestId = requestId;
+	return true;
+}
+
+/** Adapts a group's period after a poll: halve the distance to the minimum when its values changed, stretch by a
+ * quarter (at least 100ms) towards the maximum when they didn't
+ */
+void BT2Reader::completePollGroup(int index, uint8_t status) {
+	DEVICE * device = &deviceTable[index];
+	const POLL_GROUP * group = device->pollSchedule->getGroup(device->pollGroup);
+	device->pollRequestId = 0;
+	if (group == NULL) { return; }
+	POLL_GROUP_STATE * state = &device->pollGroups[device->pollGroup];
+	state->lastReadMillis = millis();
+	if (status != BT2_REQUEST_COMPLETE) {										// retried after periodMillis
+		state->attempted = true;
+		if (group->readOnce && !state->read) { state->periodMillis = BT2_CACHE_REVALIDATE_MILLIS; }	// its period is 0
+		return;
+	}
+
+	uint32_t hash = 2166136261UL;
+	const REGISTER_INDEX_SEGMENT * segment = NULL;
+	for (int i = 0; i < group->numberOfRegisters; i++) {
+		uint16_t registerAddress = group->startRegister + i;
+		if (segment == NULL || (uint16_t)(registerAddress - segment->firstAddress) >= segment->length) {
+			segment = getRegisterIndexSegment(device, registerAddress);
+		}
+		int valueIndex = segment == NULL ? REGISTER_INDEX_NONE : device->profile->entries[segment->entryOffset + registerAddress - segment->firstAddress].valueIndex;
+		if (valueIndex != REGISTER_INDEX_NONE) { hash = (hash ^ device->registerValues[valueIndex]) * 16777619UL; }
+	}
+
+	if (state->read && hash != state->valueHash) {
+		state->periodMillis = group->minimumPeriodMillis + (state->periodMillis - group->minimumPeriodMillis) / 2;
+	} else if (state->read) {
+		state->periodMillis = min(group->maximumPeriodMillis, state->periodMillis + max(state->periodMillis / 4, (uint32_t)100));
+	}
+	state->valueHash = hash;
+	state->read = true;
+	state->revalidate = false;
+}
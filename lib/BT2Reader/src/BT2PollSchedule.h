@@ -0,0 +1,56 @@
+#ifndef BT2_POLL_SCHEDULE_H
+#define BT2_POLL_SCHEDULE_H
+
+#include "Arduino.h"
+
+/**	Groups of registers polled at their own, adaptive rates.  Each group is one read command with a minimum and
+ * maximum period; while a group's values keep changing it's polled towards its minimum period, and while they
+ * don't it backs off towards its maximum, leaving the link to the groups that are moving.  Static groups (product
+ * model, serial number) are read once per connection; if the identity cache supplied them, they're read once
+ * BT2_CACHE_REVALIDATE_MILLIS after connecting instead, so live data flows first.
+ *
+ * Hand it to BT2Reader::setPollSchedule(); service() then sends whichever group is most overdue whenever a
+ * device's link is free, and leaves the link idle when nothing is due.
+ */
+
+#define MAXIMUM_POLL_GROUPS				8
+#define BT2_CACHE_REVALIDATE_MILLIS		10000
+
+struct POLL_GROUP {
+	uint16_t startRegister;
+	uint16_t numberOfRegisters;
+	uint32_t minimumPeriodMillis;
+	uint32_t maximumPeriodMillis;
+	boolean readOnce;
+};
+
+/** Per device scheduling state for each group, kept in BT2Reader's DEVICE */
+struct POLL_GROUP_STATE {
+	uint32_t lastReadMillis;
+	uint32_t periodMillis;
+	uint32_t valueHash;													// of the group's registers at the last read
+	boolean read;
+	boolean attempted;													// a read failed; waits periodMillis like one that succeeded
+	boolean revalidate;													// a static group served from the identity cache, read once more
+};
+
+
+class BT2PollSchedule {
+
+public:
+
+	void clear();
+	boolean addGroup(uint16_t startRegister, uint16_t numberOfRegisters, uint32_t minimumPeriodMillis, uint32_t maximumPeriodMillis);
+	boolean addStaticGroup(uint16_t startRegister, uint16_t numberOfRegisters);
+	boolean addDefaultGroups();
+
+	int getGroupCount();
+	const POLL_GROUP * getGroup(int i);
+
+private:
+
+	POLL_GROUP groups[MAXIMUM_POLL_GROUPS];
+	int groupCount = 0;
+};
+
+#endif
@@ -1,6 +1,6 @@
 #include "BT2Reader.h"
 
-/** Prints bms data received.  Just follow the Serial.printf code to reconstruct any voltages, temperatures etc.
+/** Prints bms data received.  Just follow formatRegister() in BT2Format.cpp to reconstruct any voltages, temperatures etc.
  *  https://www.dropbox.com/s/03vfqklw97hziqr/%E9%80%9A%E7%94%A8%E5%8D%8F%E8%AE%AE%20V2%20%28%E6%94%AF%E6%8C%8130%E4%B8%B2%29%28Engrish%29.xlsx?dl=0
  *	^^^ has details on the data formats
  */
@@ -21,10 +21,13 @@ int BT2Reader::printRegister(uint16_t connectionHandle, uint16_t registerAddress
 	return (printRegister(&deviceTable[getDeviceIndex(connectionHandle)], registerAddress));
 }
 
+/** Formats the register (BT2Format.cpp) and writes it in one go, rather than a Serial.printf per field
+ */
 int BT2Reader::printRegister(DEVICE * device, uint16_t registerAddress) {
 
-	int registerDescriptionIndex = getRegisterDescriptionIndex(registerAddress);
-	int registerValueIndex = getRegisterValueIndex(device, registerAddress);
+	const REGISTER_INDEX_ENTRY * entry = getRegisterIndexEntry(device, registerAddress);
+	int registerDescriptionIndex = (entry == NULL || entry->descriptionIndex == REGISTER_INDEX_NONE) ? -1 : entry->descriptionIndex;
+	int registerValueIndex = (entry == NULL || entry->valueIndex == REGISTER_INDEX_NONE) ? -1 : entry->valueIndex;
 	if (registerDescriptionIndex == -1) {
 		//Serial.printf("printRegister: invalid register address 0x%04X; not found in description table; aborting\n", registerAddress);
 		return (1);
@@ -34,102 +37,56 @@ int BT2Reader::printRegister(DEVICE * device, uint16_t registerAddress) {
 		return (1);
 	}
 
-	
-
-	uint16_t registerValue = device->registerValues[registerValueIndex].value;
-	uint8_t msb = (registerValue >> 8) & 0xFF;
-	uint8_t lsb = (registerValue) & 0xFF;	
-
-	const REGISTER_DESCRIPTION * rr = &registerDescription[registerDescriptionIndex];
-	Serial.print("BT2Reader:");	
-	Serial.printf("%10s: ", device->peerName);
-	Serial.printf("%35s (%04X): ", rr->name, rr->address);
-
-	switch(rr->type) {
-		case RENOGY_BYTES: 
-			{
-				for (int i = 0; i < rr->bytesUsed / 2; i++) {
-					Serial.printf("%02X ", (device->registerValues[registerValueIndex + i].value / 256) &0xFF);
-					Serial.printf("%02X ", (device->registerValues[registerValueIndex + i].value) &0xFF);
-				}
-				break;
-			}
-		
-		case RENOGY_CHARS: 
-			{
-				for (int i = 0; i < rr->bytesUsed / 2; i++) {
-					Serial.printf("%c", (char)((device->registerValues[registerValueIndex + i].value / 256) &0xFF));
-					Serial.printf("%c", (char)((device->registerValues[registerValueIndex + i].value) &0xFF));
-				}
-				break;
-			}
-		
-		case RENOGY_DECIMAL: Serial.printf("%5d", registerValue); break;
-		case RENOGY_VOLTS: Serial.printf("%5.1f Volts", (float)(registerValue) * rr->multiplier); break;
-		case RENOGY_AMPS: Serial.printf("%5.2f Amps", (float)(registerValue) * rr->multiplier); break;
-		case RENOGY_AMP_HOURS: Serial.printf("%3d AH", registerValue); break;
-		case RENOGY_COEFFICIENT: Serial.printf("%5.3f mV/℃/2V", (float)(registerValue) * rr->multiplier); break;
-		case RENOGY_TEMPERATURE:
-			{
-				Serial.print((lsb & 0x80) > 0 ? '-' : '+');
-				Serial.printf("%d C, ", lsb & 0x7F);
-				Serial.print((msb & 0x80) > 0 ? '-' : '+');
-				Serial.printf("%d C, ", msb & 0x7F); 
-				break;
-			}
-		case RENOGY_OPTIONS:
-			{
-				Serial.printf("Option %d (", registerValue);
-				int renogyOptionsSize = sizeof(renogyOptions) / sizeof(renogyOptions[0]);
-				for (int i = 0; i < renogyOptionsSize; i++) {
-					if (renogyOptions[i].registerAddress == registerAddress && registerValue == renogyOptions[i].option) {
-						Serial.printf("%s)",renogyOptions[i].optionName);
-						break;
-					}
-				}
-				break;
-			}
-		
-		case RENOGY_BIT_FLAGS:
-			{	
-				Serial.printf(" %04X\n", registerValue);
-				Serial.printf("%42s", " ");
-				for (int i = 15; i >= 0; i--) { 
-					Serial.print(HEX_UPPER_CASE[i]);
-					if (i == 8) { Serial.print(' ');}
-				}
-				Serial.printf("\n%42s", " ");
-				for (int i = 15; i >= 0; i--) { 
-					Serial.printf("%01d", (registerValue >> i) &0x01);
-					if (i == 8) { Serial.print(' ');}
-				}
-				
-				int registerBitFlagIndex = -1;
-				int renogyBitFlagsSize = sizeof(renogyBitFlags) / sizeof(renogyBitFlags[0]);
-				for (int i = 0; i < renogyBitFlagsSize; i++) {
-					if (renogyBitFlags[i].registerAddress == registerAddress) {
-						registerBitFlagIndex = i;
-						break;
-					}
-				}
-
-				if (registerBitFlagIndex < 0) { break; }
-				do {
-					Serial.printf("\n%42s", " ");
-					int bit = renogyBitFlags[registerBitFlagIndex].bit;
-					for (int i = 15; i > bit; i--) {Serial.print('.'); if (i == 8) { Serial.print(' '); }}
-					Serial.print(((registerValue >> bit) &0x01) == 1 ? "1": "0");
-					for (int i = bit; i > 0; i--) { Serial.print('.'); if (i == 8) { Serial.print(' '); } }
-					Serial.printf("  Bit %2d:", bit);
-					Serial.print(renogyBitFlags[registerBitFlagIndex].bitName);
-					Serial.print(((registerValue >> bit) &0x01) == 1 ? " TRUE": " FALSE");
-					registerBitFlagIndex++;
-				} while (registerBitFlagIndex < renogyBitFlagsSize && (renogyBitFlags[registerBitFlagIndex].registerAddress == registerAddress));
-				break;
-			}
+	char buffer[BT2_PRINT_BUFFER_LENGTH];
+	BT2_FORMAT_BUFFER out = { buffer, sizeof(buffer), 0, 0, true };
+	formatRegister(device, registerDescriptionIndex, &out, BT2_FORMAT_TEXT);
+	flushFormat(&out);
+	return (device->profile->descriptions[registerDescriptionIndex].bytesUsed / 2);
+}
+
+/** One block of link health for the device, from getStats()
+ */
+void BT2Reader::printStats(int index) {
+	BT2_STATS stats;
+	if (!getStats(index, &stats)) { return; }
+	Serial.printf("Link stats for %s\n", deviceTable[index].peerName);
+	Serial.printf("  commands %lu, frames %lu, timeouts %lu, checksum errors %lu, exceptions %lu, overruns %lu\n",
+		(unsigned long)stats.commandsSent, (unsigned long)stats.framesCompleted, (unsigned long)stats.timeouts,
+		(unsigned long)stats.checksumErrors, (unsigned long)stats.exceptions, (unsigned long)stats.overruns);
+	if (stats.framesCompleted > 0) {
+		Serial.printf("  round trip min %lums, mean %lums, max %lums:", (unsigned long)stats.roundTripMinMillis,
+			(unsigned long)(stats.roundTripTotalMillis / stats.framesCompleted), (unsigned long)stats.roundTripMaxMillis);
+		for (int i = 0; i < BT2_RTT_BUCKETS; i++) {
+			if (i < BT2_RTT_BUCKETS - 1) { Serial.printf(" <%lu:", (unsigned long)BT2_RTT_BUCKET_MILLIS[i]); }
+			else { Serial.printf(" more:"); }
+			Serial.printf("%lu", (unsigned long)stats.roundTripHistogram[i]);
+		}
+		Serial.printf("\n  notifications %lu, %.1f per frame", (unsigned long)stats.notifications, (float)stats.frameNotifications / stats.framesCompleted);
+		if (stats.notificationGaps > 0) {
+			Serial.printf(", gap mean %luus, max %luus", (unsigned long)(stats.notificationGapTotalMicros / stats.notificationGaps),
+				(unsigned long)stats.notificationGapMaxMicros);
+		}
+		Serial.println();
+	}
+	Serial.printf("  connections %lu (%lu reconnects), connect to ready %lums (max %lums)\n", (unsigned long)stats.connections,
+		(unsigned long)stats.reconnects, (unsigned long)stats.connectToReadyMillis, (unsigned long)stats.connectToReadyMaxMillis);
+}
+
+/** Each source's totals for the device, and the drift against its daily counters, from getEnergy()
+ */
+void BT2Reader::printEnergy(int index) {
+	BT2_ENERGY energy;
+	if (!getEnergy(index, &energy)) { return; }
+	Serial.printf("Energy for %s\n", deviceTable[index].peerName);
+	for (int i = 0; i < BT2_ENERGY_SOURCES; i++) {
+		if (!getIsEnergySource(&deviceTable[index], i)) { continue; }
+		Serial.printf("  %s %lu.%03luWh, %lu.%03luAh\n", energySources[i].name, (unsigned long)(energy.milliwattHours[i] / 1000),
+			(unsigned long)(energy.milliwattHours[i] % 1000), (unsigned long)(energy.milliampHours[i] / 1000), (unsigned long)(energy.milliampHours[i] % 1000));
+	}
+	if (energy.hasDailyCounters) {
+		Serial.printf("  drift against the daily counters %ldmWh, %ldmAh\n", (long)energy.driftMilliwattHours, (long)energy.driftMilliampHours);
 	}
-	Serial.println();
-	return (rr->bytesUsed / 2);
+	Serial.printf("  gaps %lu\n", (unsigned long)energy.gaps);
 }
 
 void BT2Reader::setLoggingLevel(int i) { 
@@ -139,10 +96,9 @@ void BT2Reader::setLoggingLevel(int i) {
 
 void BT2Reader::log(const char * fsh, ...) {
 	if (loggingLevel < BT2READER_VERBOSE) { return; }
-	Serial.print("BT2Reader: ");
 	va_list args;
 	va_start(args, fsh);
-	logstub(fsh, &args);
+	logstub("BT2Reader: ", fsh, &args);
 	va_end(args);
 }
 
@@ -150,30 +106,37 @@ void BT2Reader::logprintf(const char * fsh, ...) {
 	if (loggingLevel < BT2READER_VERBOSE) { return; }
 	va_list args;
 	va_start(args, fsh);
-	logstub(fsh, &args);
+	logstub("", fsh, &args);
 	va_end(args);
 }
 
 void BT2Reader::logerror(const char * fsh, ...) {
 	if (loggingLevel < BT2READER_ERRORS_ONLY) { return; }
-	Serial.print("BT2Reader: ");
 	va_list args;
 	va_start(args, fsh);
-	logstub(fsh, &args);
+	logstub("BT2Reader: ", fsh, &args);
 	va_end(args);
 }
 
-void BT2Reader::logstub(const char * fsh, va_list * args) {
+/** Prefix and message in one write, with anything unprintable shown as its hex code
+ */
+void BT2Reader::logstub(const char * prefix, const char * fsh, va_list * args) {
 	char c[255];
 	vsnprintf(c, 255, fsh, *args);
-	
+
+	char buffer[BT2_PRINT_BUFFER_LENGTH];
+	BT2_FORMAT_BUFFER out = { buffer, sizeof(buffer), 0, 0, true };
+	putFormatText(&out, prefix);
+	int start = 0;
 	int i = 0;
-	while (c[i] != 0) {
-		if ((c[i] >= 32 && c[i] < 127) || c[i] == '\n') {
-		 	Serial.print(c[i]);
-		} else {
-			Serial.printf(" [0x%02X]", c[i]);
-		}
-		i++;
+	for (; c[i] != 0; i++) {
+		if ((c[i] >= 32 && c[i] < 127) || c[i] == '\n') { continue; }
+		putFormatText(&out, &c[start], i - start);
+		putFormatText(&out, " [0x");
+		putFormatHex(&out, (uint8_t)c[i], 2);
+		putFormatChar(&out, ']');
+		start = i + 1;
 	}
+	putFormatText(&out, &c[start], i - start);
+	flushFormat(&out);
 }
\ No newline at end of file
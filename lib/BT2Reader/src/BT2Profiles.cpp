@@ -0,0 +1,134 @@
+#include "BT2Reader.h"
+
+/** Register profiles.  Each device slot is read with one BT2_REGISTER_PROFILE (the DCC map unless told otherwise):
+ * its register index, value slots, option and bit flag names, and the Modbus address commands are sent to.  The
+ * profiles themselves are compile time tables built by BT2_REGISTER_MAP in BT2Reader.h
+ */
+
+/** Binds every device to profile; see setRegisterProfile(index, profile)
+ */
+boolean BT2Reader::setRegisterProfile(const BT2_REGISTER_PROFILE * profile) {
+	boolean bound = true;
+	for (int i = 0; i < deviceTableSize; i++) { bound = setRegisterProfile(i, profile) && bound; }
+	return bound;
+}
+
+/** Reads device index with profile from now on.  Register values, timestamps, alarm baselines and energy totals belong to the old
+ * profile's layout, so they're cleared, and subscriptions are moved to the new layout by address; a read plan built
+ * for the old profile should be replaced too.  A BT2Reader
+ * reallocates the values to the new profile's size; a StaticBT2Reader refuses a profile with more values than its VALUE_SLOTS
+ */
+boolean BT2Reader::setRegisterProfile(int index, const BT2_REGISTER_PROFILE * profile) {
+	if (index < 0 || index >= deviceTableSize || profile == NULL) { return false; }
+	DEVICE * device = &deviceTable[index];
+	if (device->profile == profile) { return true; }
+	if (profile->descriptionSize > MAXIMUM_PROFILE_DESCRIPTIONS || (deviceTableCapacity > 0 && profile->valueSize > registerValueCapacity)) {
+		logerror("Register profile %s doesn't fit device %d\n", profile->name, index);
+		return false;
+	}
+
+	drainFrames(device);														// decoded with the profile they were read with
+	if (deviceTableCapacity == 0 && device->registerValues != NULL) {
+		delete[] device->registerValues;
+		device->registerValues = new uint16_t[profile->valueSize];
+	}
+	const BT2_REGISTER_PROFILE * previousProfile = device->profile;
+	device->profile = profile;
+	if (device->registerValues != NULL) { memset(device->registerValues, 0, profile->valueSize * sizeof(uint16_t)); }
+	memset(device->frameRuns, 0, sizeof(device->frameRuns));
+	if (device->subscriptions != NULL) { remapSubscriptions(device, previousProfile); }
+	memset(&device->energy, 0, sizeof(ENERGY_STATE));
+	memset(device->alarmBaseline, 0, sizeof(device->alarmBaseline));
+	device->productModelDecoded = false;
+	device->identityFromCache = false;
+	log("Device %d is now read as %s\n", index, profile->name);
+	return true;
+}
+
+const BT2_REGISTER_PROFILE * BT2Reader::getRegisterProfile(int index) {
+	if (index < 0 || index >= deviceTableSize) { return NULL; }
+	return deviceTable[index].profile;
+}
+
+
+/** Profile detection.  Once enabled, service() reads RENOGY_PRODUCT_MODEL ahead of anything else each time a
+ * device connects, matches it against models, and binds the slot to the matching profile and read plan before the
+ * first poll, so the link is only spent on registers the device implements.  A model the identity cache already
+ * holds costs no read at all.  Models that don't match, or don't answer, keep the profile they had
+ */
+void BT2Reader::beginProfileDetection(const BT2_MODEL_PROFILE * models, int modelCount) {
+	modelProfiles = (modelCount > 0 ? models : NULL);
+	modelProfileCount = max(0, modelCount);
+	for (int i = 0; i < deviceTableSize; i++) {
+		DEVICE * device = &deviceTable[i];
+		device->profileDetection = (modelProfiles != NULL && device->handle != BLE_CONN_HANDLE_INVALID ? BT2_PROFILE_DETECTION_PENDING : BT2_PROFILE_DETECTION_OFF);
+		device->profileDetectionAttempts = 0;
+	}
+}
+
+/** True once the device's product model has been read and matched this connection
+ */
+boolean BT2Reader::getIsProfileDetected(int index) {
+	if (index < 0 || index >= deviceTableSize) { return false; }
+	return (deviceTable[index].profileDetection == BT2_PROFILE_DETECTION_MATCHED);
+}
+
+/** Queues the product model read.  Returns false, with detection finished, if nothing needs reading
+ */
+boolean BT2Reader::queueProfileDetection(int index) {
+	DEVICE * device = &deviceTable[index];
+	constexpr int productModelRegisters = registerDescription[findRegisterDescriptionIndex(RENOGY_PRODUCT_MODEL)].bytesUsed / 2;
+	if (getRegisterValueIndex(device, RENOGY_PRODUCT_MODEL) < 0 || device->profileDetectionAttempts >= PROFILE_DETECTION_ATTEMPTS) {
+		device->profileDetection = BT2_PROFILE_DETECTION_DONE;				// no answer, or a profile without the register was chosen by hand
+		return false;
+	}
+	if (device->identityFromCache) {										// loaded on connect; the model is in it
+		bindDetectedProfile(index);
+		return false;
+	}
+	device->profileDetectionAttempts++;
+	device->profileDetectionRequestId = queueReadCommand(index, RENOGY_PRODUCT_MODEL, productModelRegisters);
+	if (device->profileDetectionRequestId < 0) { return false; }
+	device->profileDetection = BT2_PROFILE_DETECTION_READING;
+	return true;
+}
+
+void BT2Reader::completeProfileDetection(int index, uint8_t status) {
+	DEVICE * device = &deviceTable[index];
+	device->profileDetectionRequestId = 0;
+	if (status == BT2_REQUEST_COMPLETE) {
+		bindDetectedProfile(index);
+	} else {
+		device->profileDetection = BT2_PROFILE_DETECTION_PENDING;			// try again, up to PROFILE_DETECTION_ATTEMPTS
+	}
+}
+
+/** Binds the device to the first entry whose prefix its model starts with.  The model string read with the old
+ * profile is carried over, and the rest of the identity reloaded from the cache, so neither is read again
+ */
+void BT2Reader::bindDetectedProfile(int index) {
+	DEVICE * device = &deviceTable[index];
+	device->profileDetection = BT2_PROFILE_DETECTION_DONE;
+	char model[sizeof(device->productModel)];
+	strcpy(model, getProductModel(index));
+	for (int i = 0; i < modelProfileCount; i++) {
+		const BT2_MODEL_PROFILE * entry = &modelProfiles[i];
+		if (strncmp(model, entry->modelPrefix, strlen(entry->modelPrefix)) != 0) { continue; }
+
+		constexpr int productModelRegisters = registerDescription[findRegisterDescriptionIndex(RENOGY_PRODUCT_MODEL)].bytesUsed / 2;
+		uint16_t modelValues[productModelRegisters];
+		memcpy(modelValues, &device->registerValues[getRegisterValueIndex(device, RENOGY_PRODUCT_MODEL)], sizeof(modelValues));
+		if (!setRegisterProfile(index, entry->profile)) { return; }
+		int valueIndex = getRegisterValueIndex(device, RENOGY_PRODUCT_MODEL);
+		if (valueIndex >= 0) {
+			memcpy(&device->registerValues[valueIndex], modelValues, sizeof(modelValues));
+			recordFrameRun(device, RENOGY_PRODUCT_MODEL, productModelRegisters, millis());
+		}
+		if (identityCacheEnabled) { loadIdentityCache(device); }
+		if (entry->readPlan != NULL) { setReadPlan(index, entry->readPlan); }
+		device->profileDetection = BT2_PROFILE_DETECTION_MATCHED;
+		log("Device %d is a %s, read as %s\n", index, model, entry->profile->name);
+		return;
+	}
+	log("Device %d is a %s, not a known model; still read as %s\n", index, model, device->profile->name);
+}
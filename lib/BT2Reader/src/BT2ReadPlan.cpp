@@ -0,0 +1,107 @@
+#include "BT2Reader.h"
+
+BT2ReadPlan::BT2ReadPlan() { 
+	maximumRegistersPerRead = MAXIMUM_REGISTERS_PER_READ; 
+}
+
+void BT2ReadPlan::clear() {
+	requestedCount = 0;
+	commandCount = 0;
+}
+
+boolean BT2ReadPlan::addRegister(uint16_t registerAddress) { return addRegisters(registerAddress, 1); }
+
+/** Adds a range of registers to be read.  Ranges are kept sorted by start register so build() is a single pass;
+ * returns false if there's no room left (call build() and read what's there, or use fewer, wider ranges)
+ */
+boolean BT2ReadPlan::addRegisters(uint16_t startRegister, uint16_t numberOfRegisters) {
+	if (numberOfRegisters == 0) { return true; }
+	if (requestedCount == MAXIMUM_READ_PLAN_RANGES) { return false; }
+	int i = requestedCount;
+	while (i > 0 && requested[i - 1].startRegister > startRegister) {
+		requested[i] = requested[i - 1];
+		i--;
+	}
+	requested[i].startRegister = startRegister;
+	requested[i].numberOfRegisters = numberOfRegisters;
+	requestedCount++;
+	return true;
+}
+
+/** Adds every register described in registerDescription (other than INVALID_REGISTER)
+ */
+boolean BT2ReadPlan::addRegisterMap() { return addRegisterMap(&BT2_REGISTER_MAP_DCC::profile); }
+
+/** Adds every register profile describes (other than INVALID_REGISTER), as one range per run of back to back
+ * descriptions so large maps don't use up the ranges
+ */
+boolean BT2ReadPlan::addRegisterMap(const BT2_REGISTER_PROFILE * profile) {
+	uint32_t runStart = 0;
+	uint32_t runEnd = 0;
+	for (int i = 0; i < profile->descriptionSize; i++) {
+		const REGISTER_DESCRIPTION * description = &profile->descriptions[i];
+		if (description->address == INVALID_REGISTER) { continue; }
+		if (description->address != runEnd) {
+			if (!addRegisters(runStart, runEnd - runStart)) { return false; }
+			runStart = description->address;
+		}
+		runEnd = description->address + description->bytesUsed / 2;
+	}
+	return addRegisters(runStart, runEnd - runStart);
+}
+
+void BT2ReadPlan::setGapTolerance(int registers) { gapTolerance = max(0, registers); }
+void BT2ReadPlan::setMaximumRegistersPerRead(int registers) { maximumRegistersPerRead = min(max(1, registers), MAXIMUM_REGISTERS_PER_READ); }
+
+/** Merges the requested ranges into read commands and returns how many commands are needed.  Overlapping ranges
+ * are read once, ranges separated by at most gapTolerance registers are read together, and nothing is merged if it
+ * would take a command past maximumRegistersPerRead
+ */
+int BT2ReadPlan::build() {
+	commandCount = 0;
+	if (requestedCount == 0) { return 0; }
+
+	uint32_t start = requested[0].startRegister;
+	uint32_t end = start + requested[0].numberOfRegisters;
+	for (int i = 1; i < requestedCount; i++) {
+		uint32_t nextStart = requested[i].startRegister;
+		uint32_t nextEnd = nextStart + requested[i].numberOfRegisters;
+		if (nextEnd <= end) { continue; }												// already covered
+		if (nextStart <= end + gapTolerance && nextEnd - start <= (uint32_t)maximumRegistersPerRead) {
+			end = nextEnd;
+			continue;
+		}
+		if (!addCommand(start, end)) { return commandCount; }
+		start = max(nextStart, end);													// don't read an overlap twice
+		end = nextEnd;
+	}
+	addCommand(start, end);
+	return commandCount;
+}
+
+int BT2ReadPlan::getCommandCount() { return commandCount; }
+
+const RENOGY_COMMANDS * BT2ReadPlan::getCommand(int i) {
+	if (i < 0 || i >= commandCount) { return NULL; }
+	return (&commands[i]);
+}
+
+int BT2ReadPlan::getRegistersRead() {
+	int registersRead = 0;
+	for (int i = 0; i < commandCount; i++) { registersRead += commands[i].numberOfRegisters; }
+	return registersRead;
+}
+
+/** Adds commands covering [startRegister, endRegister), split into reads of at most maximumRegistersPerRead
+ */
+boolean BT2ReadPlan::addCommand(uint32_t startRegister, uint32_t endRegister) {
+	while (startRegister < endRegister) {
+		if (commandCount == MAXIMUM_READ_PLAN_COMMANDS) { return false; }
+		uint32_t numberOfRegisters = min(endRegister - startRegister, (uint32_t)maximumRegistersPerRead);
+		commands[commandCount].startRegister = startRegister;
+		commands[commandCount].numberOfRegisters = numberOfRegisters;
+		commandCount++;
+		startRegister += numberOfRegisters;
+	}
+	return true;
+}
@@ -0,0 +1,55 @@
+#ifndef BT2_READ_PLAN_H
+#define BT2_READ_PLAN_H
+
+#include "Arduino.h"
+
+/**	Builds the fewest Modbus read commands that cover a set of registers.  Register the addresses you care about
+ * with addRegisters(), then build() merges adjacent and overlapping ranges, bridges gaps of up to gapTolerance
+ * unused registers, and splits anything longer than maximumRegistersPerRead.  Each BLE round trip costs far more
+ * than a few extra registers in the response, so fewer, larger reads refresh the device faster.
+ */
+
+#define MAXIMUM_READ_PLAN_RANGES		32
+#define MAXIMUM_READ_PLAN_COMMANDS		16
+#define DEFAULT_READ_PLAN_GAP			4
+
+struct BT2_REGISTER_PROFILE;
+
+struct RENOGY_COMMANDS {
+	uint16_t startRegister;
+	uint16_t numberOfRegisters;
+};
+
+
+class BT2ReadPlan {
+
+public:
+
+	BT2ReadPlan();
+	void clear();
+	boolean addRegister(uint16_t registerAddress);
+	boolean addRegisters(uint16_t startRegister, uint16_t numberOfRegisters);
+	boolean addRegisterMap();
+	boolean addRegisterMap(const BT2_REGISTER_PROFILE * profile);
+
+	void setGapTolerance(int registers);
+	void setMaximumRegistersPerRead(int registers);
+	int build();
+
+	int getCommandCount();
+	const RENOGY_COMMANDS * getCommand(int i);
+	int getRegistersRead();
+
+private:
+
+	RENOGY_COMMANDS requested[MAXIMUM_READ_PLAN_RANGES];
+	int requestedCount = 0;
+	RENOGY_COMMANDS commands[MAXIMUM_READ_PLAN_COMMANDS];
+	int commandCount = 0;
+	int gapTolerance = DEFAULT_READ_PLAN_GAP;
+	int maximumRegistersPerRead;
+
+	boolean addCommand(uint32_t startRegister, uint32_t endRegister);
+};
+
+#endif
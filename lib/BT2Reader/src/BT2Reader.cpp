@@ -4,17 +4,51 @@ BT2Reader * BT2Reader::_pointerToBT2ReaderClass = NULL;
 
 
 
+/** Sizes the device table.  A BT2Reader allocates it, freeing any previous table; a StaticBT2Reader just uses the
+ * first i of its slots
+ */
 int BT2Reader::setDeviceTableSize(int i) {
-	deviceTableSize = min(max(1, i), MAXIMUM_BT2_DEVICES);
-	deviceTable = new DEVICE[deviceTableSize];
+	if (deviceTableCapacity > 0) {
+		deviceTableSize = min(max(1, i), deviceTableCapacity);
+	} else {
+		if (deviceTable != NULL) {
+			for (int j = 0; j < deviceTableSize; j++) {
+				delete[] deviceTable[j].registerValues;
+				delete deviceTable[j].subscriptions;
+			}
+			delete[] deviceTable;
+		}
+		deviceTableSize = min(max(1, i), MAXIMUM_BT2_DEVICES);
+		deviceTable = new DEVICE[deviceTableSize];
+	}
+	initializeDeviceTable();
+	log("deviceTable is %d entries long\n", deviceTableSize);
+	return deviceTableSize;
+}
+
+/** Called by StaticBT2Reader's constructor with its member arrays; registerValues holds capacity * valueSize, and
+ * every slot starts out bound to profile
+ */
+void BT2Reader::setStorage(DEVICE * devices, int capacity, uint16_t * registerValues, int valueSize, REGISTER_SUBSCRIPTIONS * subscriptions, const BT2_REGISTER_PROFILE * profile) {
+	deviceTable = devices;
+	deviceTableCapacity = capacity;
+	registerValueStorage = registerValues;
+	registerValueCapacity = valueSize;
+	subscriptionStorage = subscriptions;
+	for (int i = 0; i < capacity; i++) {
+		deviceTable[i].registerValues = &registerValueStorage[i * valueSize];
+		deviceTable[i].profile = profile;
+	}
+}
+
+void BT2Reader::initializeDeviceTable() {
 	for (int i = 0; i < deviceTableSize; i++) {
 		memset(deviceTable[i].peerName, 0, 20);
 		memset(deviceTable[i].peerAddress, 0, 6);
 		deviceTable[i].slotNamed = false;
 		deviceTable[i].handle = BLE_CONN_HANDLE_INVALID;
 	}
-	log("deviceTable is %d entries long\n", deviceTableSize);
-	return deviceTableSize;
+	rebuildAddressIndex();
 }
 
 
@@ -24,6 +58,7 @@ boolean BT2Reader::addTargetBT2Device(char * peerName) {
 		if (!deviceTable[i].slotNamed) {
 			memcpy(deviceTable[i].peerName, peerName, strlen(peerName));
 			deviceTable[i].slotNamed = true;
+			clearScanRejects();
 			log("added device %s to deviceTable\n", peerName);
 			return true;
 		}	
@@ -37,6 +72,7 @@ boolean BT2Reader::addTargetBT2Device(uint8_t * peerAddress) {
 		if (!deviceTable[i].slotNamed) {
 			memcpy(deviceTable[i].peerAddress, peerAddress, 6);
 			deviceTable[i].slotNamed = true;
+			rebuildAddressIndex();
 			log("Added target peer Address ");
 			for (int i = 0; i < 6; i++) { logprintf("%02X ",peerAddress[i]); }
 			logprintf("to deviceTable\n");
@@ -50,20 +86,32 @@ boolean BT2Reader::addTargetBT2Device(uint8_t * peerAddress) {
 void BT2Reader::begin() {
 	if (deviceTableSize == 0) { setDeviceTableSize(1); }
 	_pointerToBT2ReaderClass = this;
-	registerDescriptionSize = sizeof(registerDescription) / sizeof(registerDescription[0]);
-	registerValueSize = 0;
-	for (int i = 0; i < registerDescriptionSize; i++) { registerValueSize += (registerDescription[i].bytesUsed / 2); }
-
-	log("BT2Reader: registerDescription is %d entries, registerValue is %d entries\n", registerDescriptionSize, registerValueSize);
+	memset(gattHandles, 0, sizeof(gattHandles));
 
 	for (int i = 0; i < deviceTableSize; i++) {
 		DEVICE * device = &deviceTable[i];
-		device->registerValues = new REGISTER_VALUE[registerValueSize];
+		log("BT2Reader: device %d is %s, %d register descriptions, %d register values\n", i, device->profile->name, 
+			device->profile->descriptionSize, device->profile->valueSize);
+		if (device->registerValues == NULL) { device->registerValues = new uint16_t[device->profile->valueSize]; }
+		memset(device->registerValues, 0, device->profile->valueSize * sizeof(uint16_t));
+		memset(device->frameRuns, 0, sizeof(device->frameRuns));
+		memset(&device->stats, 0, sizeof(BT2_STATS));
+		memset(&device->energy, 0, sizeof(ENERGY_STATE));
+		memset(device->alarmBaseline, 0, sizeof(device->alarmBaseline));
+		device->productModelDecoded = false;
 		device->handle = BLE_CONN_HANDLE_INVALID;
 		device->dataReceivedLength = 0;
-		device->dataError = false;
+		device->parserState = BT2_PARSER_WAIT_START;
+		device->registersRequested = 0;
+		device->runningChecksum = 0xFFFF;
+		device->checksumLength = 0;
 		device->registerExpected = 0;
 		device->newDataAvailable = false;
+		device->frameStatus = BT2_FRAME_PENDING;
+		device->requestQueueHead = 0;
+		device->requestQueueCount = 0;
+		device->frameRingHead = 0;
+		device->frameRingTail = 0;
 		
 		device->txService.begin();
 		device->txCharacteristic.begin();
@@ -71,78 +119,67 @@ void BT2Reader::begin() {
 		device->rxService.begin();
 		device->rxCharacteristic.setNotifyCallback(notifyCallbackWrapper);
 		device->rxCharacteristic.begin();
-
-		int registerValueIndex = 0;
-		for (int j = 0; j < registerValueSize; j++) {
-			int registerLength = registerDescription[j].bytesUsed / 2;
-			int registerAddress = registerDescription[j].address;
-			for (int k = 0; k < registerLength; k++) {
-				device->registerValues[registerValueIndex].lastUpdateMillis = 0;
-				device->registerValues[registerValueIndex].value = 0;
-				device->registerValues[registerValueIndex++].registerAddress = registerAddress++;
-			}
-		}
 	}
-	invalidRegister.lastUpdateMillis = 0;
-	invalidRegister.value = 0;
 }
 
 
 boolean BT2Reader::scanCallback(ble_gap_evt_adv_report_t* report) {
 	if (numberOfConnections == deviceTableSize) { return false; }
 
+	uint32_t addressHash = getAddressHash(report->peer_addr.addr);
+	if (getIsScanRejected(addressHash)) { return false; }
+
+	BT2_ADVERTISEMENT advertisement;
+	parseAdvertisement(report, &advertisement);
+
 	// has service, manufacturer data
 	if (!report->type.scan_response) {
 
-		if (Bluefruit.Scanner.checkReportForService(report, deviceTable[0].txService)) {
-			
-			uint8_t buffer[20];
-			int len = Bluefruit.Scanner.parseReportByType(report, BLE_GAP_AD_TYPE_MANUFACTURER_SPECIFIC_DATA, buffer, 20);
-			if (len == 0 || (buffer[1] * 256 + buffer[0] != BT2_MANUFACTURER_ID)) {
-				return false;
-			}
-
-			for (int i = 0; i < deviceTableSize; i++) {
+		if (!advertisement.hasBT2Service || !advertisement.hasManufacturerId || advertisement.manufacturerId != BT2_MANUFACTURER_ID) {
+			rejectScanAddress(addressHash);									// not a BT2
+			return false;
+		}
 
-				if (memcmp(report->peer_addr.addr, deviceTable[i].peerAddress, 6) == 0) {
-					if (deviceTable[i].slotNamed) {
-						log("BT2Reader: Found targeted BT2 device, attempting connection\n");
-						Bluefruit.Central.connect(report);
-					} else {
-						//log("BT2Reader: Found untargeted BT2 device, will connect once name determined\n");
-					}
-					return true;
-				} else {
-					if (!deviceTable[i].slotNamed
-						&& memcmp(BLANK_MACID, deviceTable[i].peerAddress, 6) == 0) {
-						memcpy(deviceTable[i].peerAddress, report->peer_addr.addr, 6);
-						log("BT2Reader: Found untargeted BT2 device, adding it to deviceTable for future connection\n");
-						return true;
-					}
-				}								
+		int i = findAddressIndex(report->peer_addr.addr, addressHash);
+		if (i >= 0) {
+			if (deviceTable[i].slotNamed) {
+				log("BT2Reader: Found targeted BT2 device, attempting connection\n");
+				Bluefruit.Central.connect(report);
+			} else {
+				//log("BT2Reader: Found untargeted BT2 device, will connect once name determined\n");
 			}
+			return true;
 		}
 
+		for (i = 0; i < deviceTableSize; i++) {
+			if (!deviceTable[i].slotNamed
+				&& memcmp(BLANK_MACID, deviceTable[i].peerAddress, 6) == 0) {
+				memcpy(deviceTable[i].peerAddress, report->peer_addr.addr, 6);
+				rebuildAddressIndex();
+				log("BT2Reader: Found untargeted BT2 device, adding it to deviceTable for future connection\n");
+				return true;
+			}
+		}
+		if (!getHasOpenSlot()) { rejectScanAddress(addressHash); }			// a BT2, but every slot has its address
 		return false;
 
 	} else {
-		uint8_t buffer[20];
-		int len = Bluefruit.Scanner.parseReportByType(report, BLE_GAP_AD_TYPE_COMPLETE_LOCAL_NAME, buffer, 20);
-		
-		if (len > 0) {
-			log("found device named %s", (char *)buffer);
-
-			for (int i = 0; i < deviceTableSize; i++) {
-				if (strcmp((char *)buffer, deviceTable[i].peerName) == 0 
-					|| memcmp(report->peer_addr.addr, deviceTable[i].peerAddress, 6) == 0) {
-					memcpy(deviceTable[i].peerAddress, report->peer_addr.addr, 6);
-					logprintf(", attempting connection\n");
-					Bluefruit.Central.connect(report);
-					return true;
-				}				
+		if (advertisement.localNameLength == 0) { return false; }
+		log("found device named %s", advertisement.localName);
+
+		int i = findAddressIndex(report->peer_addr.addr, addressHash);
+		if (i < 0) { i = getDeviceIndex(advertisement.localName); }
+		if (i >= 0) {
+			if (memcmp(deviceTable[i].peerAddress, report->peer_addr.addr, 6) != 0) {
+				memcpy(deviceTable[i].peerAddress, report->peer_addr.addr, 6);
+				rebuildAddressIndex();
 			}
-			logprintf("\n");
+			logprintf(", attempting connection\n");
+			Bluefruit.Central.connect(report);
+			return true;
 		}
+		logprintf("\n");
+		if (!getHasOpenSlot()) { rejectScanAddress(addressHash); }
 	}
 	return false;
 }
@@ -156,34 +193,24 @@ boolean BT2Reader::connectCallback(uint16_t connectionHandle) {
 	uint8_t peerAddress[6];
 	memcpy(peerAddress, connection->getPeerAddr().addr, 6);
 	
-	for (int i = 0; i < deviceTableSize; i++) {
-		if (memcmp(peerAddress, deviceTable[i].peerAddress, 6) != 0) { continue; }
-
+	int i = findAddressIndex(peerAddress);
+	if (i >= 0) {
 		DEVICE * device = &deviceTable[i];
-		if (device->txService.discover(connectionHandle) && device->txCharacteristic.discover()) {
-			//Serial.print("Renogy Tx service and characteristic discovered:\n");
-			//printUuid((uint8_t * )device->txService.uuid._uuid128, 16);
-			//printUuid((uint8_t * )device->txCharacteristic.uuid._uuid128, 16);
-		} else {
-			logerror("Renogy Tx service or characteristic not discovered, disconnecting\n");
-			Bluefruit.disconnect(connectionHandle);
-			return true;
-		}
-
-		if (device->rxService.discover(connectionHandle) && device->rxCharacteristic.discover()) {
-			//Serial.print("Renogy Rx service and characteristic discovered:\n");
-			//printUuid((uint8_t * )device->rxService.uuid._uuid128, 16);
-			//printUuid((uint8_t * )device->rxCharacteristic.uuid._uuid128, 16);		
-			device->rxCharacteristic.enableNotify();
-			//Serial.print("Renogy Rx characteristic notify enabled:\n");
-			
-		} else {
-			logerror("Renogy Rx service or characteristic not discovered, disconnecting\n");
+		device->connectedMillis = millis();
+		device->ready = false;
+		device->connectToReadyMillis = 0;
+		device->gattFromCache = bindCachedGatt(device, connectionHandle);
+		if (!device->gattFromCache && !discoverGatt(device, connectionHandle)) {
 			Bluefruit.disconnect(connectionHandle);
 			return true;
 		}
 
 		device->handle = connectionHandle;
+		if (device->stats.connections++ > 0) { device->stats.reconnects++; }
+		if (identityCacheEnabled) { loadIdentityCache(device); }
+		device->profileDetection = (modelProfiles != NULL ? BT2_PROFILE_DETECTION_PENDING : BT2_PROFILE_DETECTION_OFF);
+		device->profileDetectionAttempts = 0;
+		resetPollGroups(device);
 		connection->getPeerName(device->peerName, 20);
 		numberOfConnections++;
 		log("Connected to device %s, active connections = %d\n", device->peerName, numberOfConnections);
@@ -195,12 +222,12 @@ boolean BT2Reader::connectCallback(uint16_t connectionHandle) {
 boolean BT2Reader::disconnectCallback(uint16_t connectionHandle, uint8_t reason) {
 	
 	for (int i = 0; i < deviceTableSize; i++) {
-		if (deviceTable[i].handle == connectionHandle) {
-			deviceTable[i].handle = BLE_CONN_HANDLE_INVALID;
-			if (!deviceTable[i].slotNamed) {
-				memset(deviceTable[i].peerAddress, 0, 6);
-				memset(deviceTable[i].peerName, 0, 20);
-			}
+		if (deviceTable[i].handle != connectionHandle) { continue; }
+		deviceTable[i].handle = BLE_CONN_HANDLE_INVALID;				// service() fails any queued requests
+		if (!deviceTable[i].slotNamed) {
+			memset(deviceTable[i].peerAddress, 0, 6);
+			memset(deviceTable[i].peerName, 0, 20);
+			rebuildAddressIndex();
 		}
 		numberOfConnections--;
 		log("Disconnected, reason = 0x%02X, active connections = %d\n", reason, numberOfConnections);
@@ -222,72 +249,220 @@ void BT2Reader::notifyCallback(BLEClientCharacteristic * rxCharacteristic, uint8
 		return;
 	}
 
-	DEVICE * device = &deviceTable[index];
-
-	if (device->dataError) { return; }									// don't append anything if there's already an error
-
-	if (device->dataReceivedLength > 0 || data[0] == 0xFF) {
-		device->dataError = !appendRenogyPacket(device, data, len);		// append second or greater packet
-	}
+	recordNotification(&deviceTable[index]);
+	appendRenogyPacket(&deviceTable[index], data, len);
+}
 
-	if (!device->dataError && device->dataReceivedLength == getExpectedLength(device->dataReceived)) {
 
-		if (getIsReceivedDataValid(device->dataReceived)) {
-			//Serial.printf("Complete datagram of %d bytes, %d registers (%d packets) received:\n", 
-			//	device->dataReceivedLength, device->dataReceived[2], device->dataReceivedLength % 20 + 1);
-			//printHex(device->dataReceived, device->dataReceivedLength);
-			processDataReceived(device);
+/** Streaming frame parser.  Bytes are fed through a small state machine as notifications arrive, so a frame
+ * ("FF 03 len data... crc" or the Modbus exception "FF 83 code crc") can straddle notifications, a bad function
+ * code or a length that doesn't match the registers requested is rejected on the byte it arrives, and the
+ * checksum is accumulated as the data comes in.  After a rejected byte or a failed checksum the parser
+ * resynchronizes on the next 0xFF, so garbage ahead of a good frame doesn't cost the whole request.  0xFF is a
+ * controller's address; batteries and inverters answer with their own (BT2_REGISTER_PROFILE::modbusAddress).
+ */
+void BT2Reader::appendRenogyPacket(DEVICE * device, uint8_t * data, int dataLen, boolean rescanning) {
+	int i = 0;
+	while (i < dataLen) {
+		switch (device->parserState) {
+
+			case BT2_PARSER_WAIT_START:
+				if (data[i] == device->profile->modbusAddress) {
+					device->dataReceivedLength = 0;
+					device->runningChecksum = 0xFFFF;
+					device->checksumLength = 0;
+					device->dataReceived[device->dataReceivedLength++] = data[i];
+					device->parserState = BT2_PARSER_FUNCTION;
+				}
+				i++;
+				break;
+
+			case BT2_PARSER_FUNCTION:
+				if (data[i] == MODBUS_READ_REGISTERS || data[i] == MODBUS_READ_EXCEPTION) {
+					device->dataReceived[device->dataReceivedLength++] = data[i];
+					device->parserState = (data[i] == MODBUS_READ_REGISTERS ? BT2_PARSER_LENGTH : BT2_PARSER_DATA);
+					i++;
+				} else {
+					device->parserState = BT2_PARSER_WAIT_START;			// don't consume it; it may be the next 0xFF
+				}
+				break;
+
+			case BT2_PARSER_LENGTH:
+				if (getIsFrameLengthValid(device, data[i])) {
+					device->dataReceived[device->dataReceivedLength++] = data[i];
+					device->parserState = BT2_PARSER_DATA;
+					i++;
+				} else {
+					device->parserState = BT2_PARSER_WAIT_START;
+				}
+				break;
+
+			case BT2_PARSER_DATA:
+				{
+					int expectedLength = getExpectedLength(device->dataReceived);
+					int n = min(expectedLength - device->dataReceivedLength, dataLen - i);
+					memcpy(&device->dataReceived[device->dataReceivedLength], &data[i], n);
+					device->dataReceivedLength += n;
+					i += n;
+
+					int checksumEnd = min(device->dataReceivedLength, expectedLength - 2);	// the last two bytes are the checksum itself
+					if (checksumEnd > device->checksumLength) {
+						device->runningChecksum = updateModbusChecksum(device->runningChecksum, 
+							&device->dataReceived[device->checksumLength], checksumEnd - device->checksumLength);
+						device->checksumLength = checksumEnd;
+					}
+					if (device->dataReceivedLength == expectedLength) { completeFrame(device, rescanning); }
+					break;
+				}
 
-			char bt2Response[21] = "main recv data[XX] [";
-			for (int i = 0; i < device->dataError; i+= 20) {
-				bt2Response[15] = HEX_LOWER_CASE[(device->dataReceived[i] / 16) & 0x0F];
-				bt2Response[16] = HEX_LOWER_CASE[(device->dataReceived[i]) & 0x0F];
-				//Serial.printf("Sending response #%d to BT2: %s\n", i, bt2Response);
-				device->txCharacteristic.write(bt2Response, 20);
-			}
-		} else {
-			//Serial.printf("Checksum error: received is 0x%04X, calculated is 0x%04X\n", 
-			//	getProvidedModbusChecksum(device->dataReceived), getCalculatedModbusChecksum(device->dataReceived));
+			default:
+				return;															// frame already complete; ignore anything else until the next command
 		}
-	} 
+	}
 }
 
-
-/** Appends received data.  Returns false if there's potential for buffer overrun, true otherwise
+/** The length byte must be what the registers requested would produce, which also rejects most stale responses.
+ * Either way the frame has to fit in dataReceived and BT2_FRAME::data
  */
-boolean BT2Reader::appendRenogyPacket(DEVICE * device, uint8_t * data, int dataLen) {
-	if (dataLen + device->dataReceivedLength >= DEFAULT_DATA_BUFFER_LENGTH -1) {
-		logerror("BT2Reader: Buffer overrun receiving data\n");
-		return false;
+boolean BT2Reader::getIsFrameLengthValid(DEVICE * device, uint8_t length) {
+	if (length == 0 || (length & 0x01) != 0 || length / 2 > MAXIMUM_REGISTERS_PER_READ || length + 5 > DEFAULT_DATA_BUFFER_LENGTH) { return false; }
+	return (device->registersRequested == 0 || length == device->registersRequested * 2);
+}
+
+void BT2Reader::completeFrame(DEVICE * device, boolean rescanning) {
+	if (!getIsReceivedDataValid(device)) {
+		//Serial.printf("Checksum error: received is 0x%04X, calculated is 0x%04X\n", 
+		//	getProvidedModbusChecksum(device->dataReceived), device->runningChecksum);
+		device->parserState = BT2_PARSER_WAIT_START;
+		if (!rescanning) {													// the 0xFF may have been noise; look for a frame after it
+			device->stats.checksumErrors++;
+			uint8_t rescan[DEFAULT_DATA_BUFFER_LENGTH];
+			int rescanLength = device->dataReceivedLength - 1;
+			memcpy(rescan, &device->dataReceived[1], rescanLength);
+			appendRenogyPacket(device, rescan, rescanLength, true);
 		}
-	memcpy(&device->dataReceived[device->dataReceivedLength], data, dataLen);
-	//for (int i = 0; i < dataLen; i++) { device->dataReceived[device->dataReceivedLength++] = data[i]; }
-	device->dataReceivedLength += dataLen;
-	if (getExpectedLength(device->dataReceived) < device->dataReceivedLength) {
-		logerror("BT2Reader: Buffer overrun receiving data\n");
-		return false;
+		if (device->parserState == BT2_PARSER_WAIT_START && device->frameStatus == BT2_FRAME_PENDING) {
+			device->frameStatus = BT2_FRAME_CHECKSUM_ERROR;
+		}
+		return;
+	}
+
+	device->parserState = BT2_PARSER_COMPLETE;
+	recordFrameStats(device, device->dataReceived[1] == MODBUS_READ_EXCEPTION);
+	if (device->dataReceived[1] == MODBUS_READ_EXCEPTION) {
+		logerror("BT2 returned exception 0x%02X reading 0x%04X\n", device->dataReceived[2], device->registerExpected);
+		device->frameStatus = BT2_FRAME_EXCEPTION;
+		return;
 	}
-	return true;
+
+	//Serial.printf("Complete datagram of %d bytes, %d registers (%d packets) received:\n", 
+	//	device->dataReceivedLength, device->dataReceived[2], device->dataReceivedLength % 20 + 1);
+	//printHex(device->dataReceived, device->dataReceivedLength);
+	if (!device->ready) { markDeviceReady(device); }
+	pushFrame(device);
+	__atomic_store_n(&device->frameStatus, (uint8_t)BT2_FRAME_COMPLETE, __ATOMIC_RELEASE);	// never seen before the frame
+
+	// The Renogy app acknowledges each notification with "main recv data[XX] [", but the BT-2 answers without it and
+	// this library has never sent it, so the notify callback makes no GATT writes
+	//char bt2Response[21] = "main recv data[XX] [";
+	//for (int i = 0; i < device->dataReceivedLength; i+= 20) {
+	//	bt2Response[15] = HEX_LOWER_CASE[(device->dataReceived[i] / 16) & 0x0F];
+	//	bt2Response[16] = HEX_LOWER_CASE[(device->dataReceived[i]) & 0x0F];
+	//	device->txCharacteristic.write(bt2Response, 20);
+	//}
 }
 
-void BT2Reader::processDataReceived(DEVICE * device) {
+/** Decodes a frame from the ring into the register store.  Runs in loop() context, from drainFrames()
+ */
+void BT2Reader::processDataReceived(DEVICE * device, const BT2_FRAME * frame) {
 
 	int registerOffset = 0;
-	int registersProvided = device->dataReceived[2] / 2;
+	int registersProvided = frame->numberOfRegisters;
+	uint16_t startRegister = frame->startRegister;
+	const REGISTER_INDEX_SEGMENT * segment = NULL;
 	
 	while (registerOffset < registersProvided) {
-		int registerIndex = getRegisterValueIndex(device, device->registerExpected + registerOffset);
-		if (registerIndex >= 0) {
-			uint8_t msb = device->dataReceived[registerOffset * 2 + 3];
-			uint8_t lsb = device->dataReceived[registerOffset * 2 + 4];
-			device->registerValues[registerIndex].value = msb * 256 + lsb;
-			device->registerValues[registerIndex].lastUpdateMillis = millis();
+		uint16_t registerAddress = startRegister + registerOffset;
+		if (segment == NULL || (uint16_t)(registerAddress - segment->firstAddress) >= segment->length) {
+			segment = getRegisterIndexSegment(device, registerAddress);	// only changes at the edge of a run of registers
+		}
+		const REGISTER_INDEX_ENTRY * entry = segment == NULL ? NULL : &device->profile->entries[segment->entryOffset + registerAddress - segment->firstAddress];
+		if (entry != NULL && entry->valueIndex != REGISTER_INDEX_NONE) {
+			uint8_t msb = frame->data[registerOffset * 2];
+			uint8_t lsb = frame->data[registerOffset * 2 + 1];
+			uint16_t previousValue = device->registerValues[entry->valueIndex];
+			device->registerValues[entry->valueIndex] = msb * 256 + lsb;
+			if (alarmsEnabled && entry->descriptionIndex != REGISTER_INDEX_NONE && device->profile->labels[entry->descriptionIndex].count > 0) {
+				uint32_t * baseline = &device->alarmBaseline[entry->descriptionIndex / 32];
+				uint32_t bit = 1UL << (entry->descriptionIndex & 31);
+				queueAlarmEvents(device, entry->descriptionIndex, previousValue, msb * 256 + lsb, (*baseline & bit) == 0, frame->receivedMillis);
+				*baseline |= bit;
+			}
 		}
 		registerOffset++;
 	}	
+	recordFrameRun(device, startRegister, registersProvided, frame->receivedMillis);
+	if (historyCount > 0) { appendHistories(device, startRegister, registersProvided, frame->receivedMillis); }
+	if (device->subscriptions != NULL) { updateSubscriptions(device, startRegister, registersProvided); }
+	if (energyEnabled && startRegister <= RENOGY_TODAY_POWER && startRegister + registersProvided > RENOGY_ALTERNATOR_CURRENT) {	// spans energySources and energyCounters
+		updateEnergy(device, startRegister, registersProvided, frame->receivedMillis);
+	}
+	constexpr int productModelRegisters = registerDescription[findRegisterDescriptionIndex(RENOGY_PRODUCT_MODEL)].bytesUsed / 2;
+	if (startRegister < RENOGY_PRODUCT_MODEL + productModelRegisters && startRegister + registersProvided > RENOGY_PRODUCT_MODEL) {
+		device->productModelDecoded = false;
+	}
+	for (int i = 0; i < IDENTITY_REGISTER_RANGES; i++) {
+		if (startRegister < identityRegisters[i].startRegister + identityRegisters[i].numberOfRegisters && 
+			startRegister + registersProvided > identityRegisters[i].startRegister) {
+			device->identityFromCache = false;
+			device->identityCacheDirty = identityCacheEnabled;
+		}
+	}
 	device->newDataAvailable = true;
 }
 
+/** Register timestamps are kept per frame rather than per register: each distinct (start, count) read gets one
+ * FRAME_RUN, refreshed every time that read completes.  A read plan repeats the same few reads, so this is exact
+ * in practice; if more than MAXIMUM_FRAME_RUNS distinct reads are in use, the oldest run is forgotten
+ */
+void BT2Reader::recordFrameRun(DEVICE * device, uint16_t startRegister, uint16_t numberOfRegisters, uint32_t updateMillis) {
+	uint32_t now = millis();
+	int oldest = 0;
+	for (int i = 0; i < MAXIMUM_FRAME_RUNS; i++) {
+		FRAME_RUN * run = &device->frameRuns[i];
+		if (run->numberOfRegisters == 0 || (run->startRegister == startRegister && run->numberOfRegisters == numberOfRegisters)) {
+			oldest = i;
+			break;
+		}
+		if (now - run->updateMillis > now - device->frameRuns[oldest].updateMillis) { oldest = i; }
+	}
+	device->frameRuns[oldest].startRegister = startRegister;
+	device->frameRuns[oldest].numberOfRegisters = numberOfRegisters;
+	device->frameRuns[oldest].updateMillis = updateMillis;
+}
+
+/** Returns when registerAddress was last received, or 0 if it never has been (or its run has been forgotten)
+ */
+uint32_t BT2Reader::getRegisterUpdateMillis(DEVICE * device, uint16_t registerAddress) {
+	uint32_t now = millis();
+	uint32_t updateMillis = 0;
+	boolean found = false;
+	for (int i = 0; i < MAXIMUM_FRAME_RUNS; i++) {
+		FRAME_RUN * run = &device->frameRuns[i];
+		if ((uint16_t)(registerAddress - run->startRegister) >= run->numberOfRegisters) { continue; }
+		if (!found || now - run->updateMillis < now - updateMillis) { updateMillis = run->updateMillis; }
+		found = true;
+	}
+	return updateMillis;
+}
+
+boolean BT2Reader::getIsRegisterReceived(DEVICE * device, uint16_t registerAddress) {
+	for (int i = 0; i < MAXIMUM_FRAME_RUNS; i++) {
+		if ((uint16_t)(registerAddress - device->frameRuns[i].startRegister) < device->frameRuns[i].numberOfRegisters) { return true; }
+	}
+	return false;
+}
+
 
 void BT2Reader::sendReadCommand(char * name, uint16_t startRegister, uint16_t numberOfRegisters) { sendReadCommand(getDeviceIndex(name), startRegister, numberOfRegisters); }
 void BT2Reader::sendReadCommand(uint8_t * address, uint16_t startRegister, uint16_t numberOfRegisters) { sendReadCommand(getDeviceIndex(address), startRegister, numberOfRegisters); }
@@ -297,8 +472,13 @@ void BT2Reader::sendReadCommand(int index, uint16_t startRegister, uint16_t numb
 		logerror("SendReadCommand: invalid name, mac address, or index provided\n");
 		return;
 	}
+	if (numberOfRegisters == 0 || numberOfRegisters > MAXIMUM_REGISTERS_PER_READ) {
+		logerror("SendReadCommand: %d registers, must be 1 to %d\n", numberOfRegisters, MAXIMUM_REGISTERS_PER_READ);
+		return;
+	}
 	uint8_t command[20];
-	command[0] = 0xFF;
+	DEVICE * device = &deviceTable[index];
+	command[0] = device->profile->modbusAddress;
 	command[1] = 0x03;
 	command[2] = (startRegister >> 8) & 0xFF;
 	command[3] = startRegister & 0xFF;
@@ -312,47 +492,55 @@ void BT2Reader::sendReadCommand(int index, uint16_t startRegister, uint16_t numb
 	for (int i = 0; i < 8; i++) { logprintf("%02X ", command[i]); }
 	logprintf("\n");
 
-	DEVICE * device = &deviceTable[index];
-	device->txCharacteristic.write(command, 8);
+	if (device->txCharacteristic.write(command, 8) == 0 && device->gattFromCache) { rejectCachedGatt(device); }
 	device->registerExpected = startRegister;
+	device->registersRequested = numberOfRegisters;
 	device->dataReceivedLength = 0;
-	device->dataError = false;
+	device->parserState = BT2_PARSER_WAIT_START;
+	device->runningChecksum = 0xFFFF;
+	device->checksumLength = 0;
 	device->newDataAvailable = false;
+	device->frameStatus = BT2_FRAME_PENDING;
+	device->commandSentMillis = millis();
+	device->responseNotifications = 0;
+	device->stats.commandsSent++;
 }
 
 
-int BT2Reader::getRegisterValueIndex(DEVICE * device, uint16_t registerAddress) {
-	int left = 0;
-	int right = registerValueSize - 1;
-	while (left <= right) {
-		int mid = (left + right) / 2;
-		if (device->registerValues[mid].registerAddress == registerAddress) { return mid; }
-		if (device->registerValues[mid].registerAddress < registerAddress) { 
-			left = mid + 1;
-		} else {
-			right = mid -1;
-		}
+/** Returns the segment of the device's register index covering registerAddress, or NULL if the address isn't in
+ * its profile
+ */
+const REGISTER_INDEX_SEGMENT * BT2Reader::getRegisterIndexSegment(DEVICE * device, uint16_t registerAddress) {
+	const BT2_REGISTER_PROFILE * profile = device->profile;
+	for (int i = 0; i < profile->segmentCount; i++) {
+		const REGISTER_INDEX_SEGMENT * segment = &profile->segments[i];
+		if ((uint16_t)(registerAddress - segment->firstAddress) < segment->length) { return segment; }
 	}
-	return -1;
+	return NULL;
 }
 
-int BT2Reader::getRegisterDescriptionIndex(uint16_t registerAddress) {
-	int left = 0;
-	int right = registerDescriptionSize - 1;
-	while (left <= right) {
-		int mid = (left + right) / 2;
-		if (registerDescription[mid].address == registerAddress) { return mid; }
-		if (registerDescription[mid].address < registerAddress) { 
-			left = mid + 1;
-		} else {
-			right = mid -1;
-		}
-	}
-	return -1;
+/** Returns the value slot and description for registerAddress in one lookup, or NULL if it isn't in the profile
+ */
+const REGISTER_INDEX_ENTRY * BT2Reader::getRegisterIndexEntry(DEVICE * device, uint16_t registerAddress) {
+	const REGISTER_INDEX_SEGMENT * segment = getRegisterIndexSegment(device, registerAddress);
+	if (segment == NULL) { return NULL; }
+	return (&device->profile->entries[segment->entryOffset + registerAddress - segment->firstAddress]);
 }
 
+int BT2Reader::getRegisterValueIndex(DEVICE * device, uint16_t registerAddress) {
+	const REGISTER_INDEX_ENTRY * entry = getRegisterIndexEntry(device, registerAddress);
+	if (entry == NULL || entry->valueIndex == REGISTER_INDEX_NONE) { return -1; }
+	return (entry->valueIndex);
+}
 
-int BT2Reader::getExpectedLength(uint8_t * data) { return data[2] + 5; }
+int BT2Reader::getRegisterDescriptionIndex(DEVICE * device, uint16_t registerAddress) {
+	const REGISTER_INDEX_ENTRY * entry = getRegisterIndexEntry(device, registerAddress);
+	if (entry == NULL || entry->descriptionIndex == REGISTER_INDEX_NONE) { return -1; }
+	return (entry->descriptionIndex);
+}
+
+
+int BT2Reader::getExpectedLength(uint8_t * data) { return (data[1] == MODBUS_READ_EXCEPTION ? 5 : data[2] + 5); }
 
 int BT2Reader::getDeviceIndex(uint16_t connectionHandle) {
 	for (int i = 0; i < deviceTableSize; i++) {
@@ -368,12 +556,7 @@ int BT2Reader::getDeviceIndex(char * name) {
 	return -1;
 }
 
-int BT2Reader::getDeviceIndex(uint8_t * address) {
-	for (int i = 0; i < deviceTableSize; i++) {
-		if (memcmp(address, deviceTable[i].peerAddress, 6) == 0) { return i; }
-	}
-	return -1;
-}
+int BT2Reader::getDeviceIndex(uint8_t * address) { return findAddressIndex(address); }
 
 int BT2Reader::getDeviceIndex(BLEClientCharacteristic * characteristic) {
 	for (int i = 0; i < deviceTableSize; i++) {
@@ -383,14 +566,30 @@ int BT2Reader::getDeviceIndex(BLEClientCharacteristic * characteristic) {
 	return -1;
 }
 
-REGISTER_VALUE * BT2Reader::getRegister(char * name, uint16_t registerAddress) { return (getRegister(getDeviceIndex(name), registerAddress)); }
-REGISTER_VALUE * BT2Reader::getRegister(uint8_t * address, uint16_t registerAddress) { return (getRegister(getDeviceIndex(address), registerAddress)); }
-REGISTER_VALUE * BT2Reader::getRegister(uint16_t connectionHandle, uint16_t registerAddress) { return (getRegister(getDeviceIndex(connectionHandle), registerAddress)); }
-REGISTER_VALUE * BT2Reader::getRegister(int deviceIndex, uint16_t registerAddress) {
-	if (deviceIndex < 0) { return &invalidRegister; }
+REGISTER_VALUE BT2Reader::getRegister(char * name, uint16_t registerAddress) { return (getRegister(getDeviceIndex(name), registerAddress)); }
+REGISTER_VALUE BT2Reader::getRegister(uint8_t * address, uint16_t registerAddress) { return (getRegister(getDeviceIndex(address), registerAddress)); }
+REGISTER_VALUE BT2Reader::getRegister(uint16_t connectionHandle, uint16_t registerAddress) { return (getRegister(getDeviceIndex(connectionHandle), registerAddress)); }
+REGISTER_VALUE BT2Reader::getRegister(int deviceIndex, uint16_t registerAddress) {
+	REGISTER_VALUE registerValue = { INVALID_REGISTER, 0, 0 };
+	if (deviceIndex < 0) { return registerValue; }
+	drainFrames(&deviceTable[deviceIndex]);
+	int registerValueIndex = getRegisterValueIndex(&deviceTable[deviceIndex], registerAddress);
+	if (registerValueIndex < 0) { return registerValue; }
+	registerValue.registerAddress = registerAddress;
+	registerValue.value = deviceTable[deviceIndex].registerValues[registerValueIndex];
+	registerValue.lastUpdateMillis = getRegisterUpdateMillis(&deviceTable[deviceIndex], registerAddress);
+	return registerValue;
+}
+
+uint16_t BT2Reader::getRegisterValue(char * name, uint16_t registerAddress) { return (getRegisterValue(getDeviceIndex(name), registerAddress)); }
+uint16_t BT2Reader::getRegisterValue(uint8_t * address, uint16_t registerAddress) { return (getRegisterValue(getDeviceIndex(address), registerAddress)); }
+uint16_t BT2Reader::getRegisterValue(uint16_t connectionHandle, uint16_t registerAddress) { return (getRegisterValue(getDeviceIndex(connectionHandle), registerAddress)); }
+uint16_t BT2Reader::getRegisterValue(int deviceIndex, uint16_t registerAddress) {
+	if (deviceIndex < 0) { return 0; }
+	drainFrames(&deviceTable[deviceIndex]);
 	int registerValueIndex = getRegisterValueIndex(&deviceTable[deviceIndex], registerAddress);
-	if (registerValueIndex < 0) { return &invalidRegister; }
-	return (&deviceTable[deviceIndex].registerValues[registerValueIndex]);
+	if (registerValueIndex < 0) { return 0; }
+	return (deviceTable[deviceIndex].registerValues[registerValueIndex]);
 }
 
 boolean BT2Reader::getIsNewDataAvailable(char * name) { return (getIsNewDataAvailable(getDeviceIndex(name))); }
@@ -398,6 +597,7 @@ boolean BT2Reader::getIsNewDataAvailable(uint8_t * address) { return (getIsNewDa
 boolean BT2Reader::getIsNewDataAvailable(uint16_t connectionHandle) { return (getIsNewDataAvailable(getDeviceIndex(connectionHandle))); }
 boolean BT2Reader::getIsNewDataAvailable(int index) {
 	if (index == -1) { return false; }
+	drainFrames(&deviceTable[index]);
 	boolean isNewDataAvailable = deviceTable[index].newDataAvailable;
 	deviceTable[index].newDataAvailable = false;
 	return (isNewDataAvailable);
@@ -3,6 +3,8 @@
 
 #include "bluefruit.h"
 #include <array>
+#include <cstddef>
+#include <initializer_list>
 
 /**	Adafruit nrf52 code for communicating with Renogy DCC series MPPT solar controllers and DC:DC converters
  * These include:
@@ -22,9 +24,13 @@
  * Thanks go to Wireshark for allowing me to read the bluetooth packets used 
  */
 #include "Arduino.h"
+#include "BT2ReadPlan.h"
+#include "BT2History.h"
+#include "BT2PollSchedule.h"
+#include "BT2Snapshot.h"
 
 
-static const uint16_t MODBUS_TABLE_A001[256] = {
+static constexpr uint16_t MODBUS_TABLE_A001[256] = {
 	0x0000, 0xC0C1, 0xC181, 0x0140, 0xC301, 0x03C0, 0x0280, 0xC241,
 	0xC601, 0x06C0, 0x0780, 0xC741, 0x0500, 0xC5C1, 0xC481, 0x0440,
 	0xCC01, 0x0CC0, 0x0D80, 0xCD41, 0x0F00, 0xCFC1, 0xCE81, 0x0E40,
@@ -59,6 +65,40 @@ static const uint16_t MODBUS_TABLE_A001[256] = {
 	0x8201, 0x42C0, 0x4380, 0x8341, 0x4100, 0x81C1, 0x8081, 0x4040
 };
 
+/** Slicing-by-4 tables for the Modbus CRC, generated at compile time.  table[0] is MODBUS_TABLE_A001;
+ * table[k][b] is the CRC contribution of byte b followed by k zero bytes, so four bytes can be folded
+ * into the CRC with four independent lookups instead of four dependent ones.  Slicing-by-8 would
+ * double the flash used (4 KB) for little gain on 20 byte notifications, so 4 is used here.
+ */
+struct MODBUS_SLICING_TABLE {
+	uint16_t table[4][256];
+};
+
+constexpr MODBUS_SLICING_TABLE buildModbusSlicingTable() {
+	MODBUS_SLICING_TABLE slicing = {};
+	for (int i = 0; i < 256; i++) {
+		uint16_t crc = i;
+		for (int bit = 0; bit < 8; bit++) { crc = (crc & 0x0001) ? (crc >> 1) ^ 0xA001 : crc >> 1; }
+		slicing.table[0][i] = crc;
+	}
+	for (int k = 1; k < 4; k++) {
+		for (int i = 0; i < 256; i++) {
+			slicing.table[k][i] = (slicing.table[k - 1][i] >> 8) ^ slicing.table[0][slicing.table[k - 1][i] & 0xFF];
+		}
+	}
+	return slicing;
+}
+
+static constexpr MODBUS_SLICING_TABLE MODBUS_SLICING_A001 = buildModbusSlicingTable();
+
+constexpr boolean getIsModbusSlicingTableValid() {
+	for (int i = 0; i < 256; i++) {
+		if (MODBUS_SLICING_A001.table[0][i] != MODBUS_TABLE_A001[i]) { return false; }
+	}
+	return true;
+}
+static_assert(getIsModbusSlicingTableValid(), "generated Modbus CRC table does not match MODBUS_TABLE_A001");
+
 
 #define BT2READER_QUIET					0
 #define BT2READER_ERRORS_ONLY			1
@@ -66,6 +106,53 @@ static const uint16_t MODBUS_TABLE_A001[256] = {
 
 #define MAXIMUM_BT2_DEVICES				8
 #define DEFAULT_DATA_BUFFER_LENGTH		100
+#define BT2_REQUEST_QUEUE_LENGTH		8
+#define DEFAULT_REQUEST_TIMEOUT			5000
+#define MAXIMUM_FRAME_RUNS				8
+#define MAXIMUM_CHANGE_CALLBACKS		8			// distinct callbacks passed to subscribe()
+#define ADDRESS_INDEX_SIZE				16			// power of two, at least 2 * MAXIMUM_BT2_DEVICES
+#define SCAN_REJECT_CACHE_SIZE			64			// power of two
+#define BT2_SCAN_REJECT_MILLIS			60000
+#define BT2_RTT_BUCKETS					8
+#define BT2_FRAME_RING_LENGTH			4			// power of two; completed frames waiting for loop()
+#define BT2_ALARM_QUEUE_LENGTH			32			// power of two; alarm events waiting for loop()
+#define BT2_ENERGY_MAX_GAP_MILLIS		30000		// readings of a power or current register further apart aren't integrated across
+#define MAXIMUM_HISTORIES				64			// registers with a BT2RegisterHistory attached, across all devices
+#define MAXIMUM_REGISTERS_PER_READ		((DEFAULT_DATA_BUFFER_LENGTH - 7) / 2)		// largest response that fits in dataReceived
+
+#define BT2_FRAME_PENDING				0
+#define BT2_FRAME_COMPLETE				1
+#define BT2_FRAME_CHECKSUM_ERROR		2
+#define BT2_FRAME_EXCEPTION				3
+
+#define BT2_PARSER_WAIT_START			0
+#define BT2_PARSER_FUNCTION				1
+#define BT2_PARSER_LENGTH				2
+#define BT2_PARSER_DATA					3
+#define BT2_PARSER_COMPLETE				4
+
+#define MODBUS_READ_REGISTERS			0x03
+#define MODBUS_READ_EXCEPTION			0x83
+
+#define BT2_REQUEST_UNKNOWN				0
+#define BT2_REQUEST_QUEUED				1
+#define BT2_REQUEST_SENT				2
+#define BT2_REQUEST_COMPLETE			3
+#define BT2_REQUEST_CHECKSUM_ERROR		4
+#define BT2_REQUEST_FRAME_ERROR			5						// the BT2 answered with a Modbus exception
+#define BT2_REQUEST_TIMEOUT				6
+#define BT2_REQUEST_DISCONNECTED		7
+
+#define BT2_PROFILE_DETECTION_OFF		0
+#define BT2_PROFILE_DETECTION_PENDING	1						// connected; the product model hasn't been read yet
+#define BT2_PROFILE_DETECTION_READING	2
+#define BT2_PROFILE_DETECTION_MATCHED	3
+#define BT2_PROFILE_DETECTION_DONE		4						// no match, or no answer; the slot keeps its profile
+#define PROFILE_DETECTION_ATTEMPTS		3						// product model reads per connection
+
+#define BT2_FORMAT_TEXT					0						// the printRegister() layout, a line per register
+#define BT2_FORMAT_JSON					1						// a JSON object per device, a line each
+#define BT2_PRINT_BUFFER_LENGTH			256						// printRegister(), printDevice() and log() write in chunks of this
 
 #define RENOGY_BYTES					0
 #define RENOGY_DECIMAL					1
@@ -77,6 +164,13 @@ static const uint16_t MODBUS_TABLE_A001[256] = {
 #define RENOGY_OPTIONS					7
 #define RENOGY_COEFFICIENT				8
 #define RENOGY_TEMPERATURE				9
+#define RENOGY_SIGNED					10			// two's complement, scaled by multiplier
+#define RENOGY_SIGNED_FLAG				0x80		// or'd into a unit, e.g. RENOGY_AMPS | RENOGY_SIGNED_FLAG, for a two's complement register
+#define RENOGY_UNIT_MASK				0x7F
+
+#define MODBUS_ADDRESS_CONTROLLER		0xFF		// what a BT-1/BT-2 answers for on a charge controller
+#define MODBUS_ADDRESS_SMART_BATTERY	0x30		// first battery on the RS485 link; 0x31.. for the others
+#define MODBUS_ADDRESS_INVERTER			0x20
 
 
 #define INVALID_REGISTER				0x0000
@@ -117,12 +211,52 @@ static const uint16_t MODBUS_TABLE_A001[256] = {
 #define REGISTER_DESCRIPTION_UNKNOWN3	0xFFF3
 #define REGISTER_DESCRIPTION_UNKNOWN4	0xFFF4
 
-	
-struct RENOGY_COMMANDS {
-	uint16_t startRegister;
-	uint16_t numberOfRegisters;
-};
+/** Rover / Wanderer MPPT controllers share the DCC's 0x0100 block, but 0x0104-0x0106 are the load output rather
+ * than the alternator, and the block carries on with lifetime totals
+ */
+#define RENOGY_LOAD_VOLTAGE				0x0104
+#define RENOGY_LOAD_CURRENT				0x0105
+#define RENOGY_LOAD_POWER				0x0106
+#define RENOGY_TODAY_HIGHEST_DISCHARGE_CURRENT	0x010E
+#define RENOGY_TODAY_HIGHEST_DISCHARGE_POWER	0x0110
+#define RENOGY_TODAY_DISCHARGE_AMP_HOURS	0x0112
+#define RENOGY_TODAY_CONSUMPTION		0x0114
+#define RENOGY_OPERATING_DAYS			0x0115
+#define RENOGY_OVER_DISCHARGES			0x0116
+#define RENOGY_FULL_CHARGES				0x0117
+#define RENOGY_TOTAL_CHARGE_AMP_HOURS	0x0118
+#define RENOGY_TOTAL_DISCHARGE_AMP_HOURS	0x011A
+#define RENOGY_TOTAL_GENERATION			0x011C
+#define RENOGY_TOTAL_CONSUMPTION		0x011E
+#define RENOGY_FAULT_FLAGS				0x0121		// high word of the 32 bit fault code; the low word is reserved
+
+/** Renogy smart (LiFePO4) batteries, at MODBUS_ADDRESS_SMART_BATTERY
+ */
+#define RENOGY_BATTERY_CELL_COUNT		0x1388
+#define RENOGY_BATTERY_CELL_VOLTAGE		0x1389		// cell 1; cell n is at + n - 1
+#define RENOGY_BATTERY_SENSOR_COUNT		0x1399
+#define RENOGY_BATTERY_CELL_TEMPERATURE	0x139A		// sensor 1; sensor n is at + n - 1
+#define RENOGY_BATTERY_CURRENT			0x13B2		// negative while discharging
+#define RENOGY_BATTERY_VOLTAGE			0x13B3
+#define RENOGY_BATTERY_REMAINING_CHARGE	0x13B4
+#define RENOGY_BATTERY_CAPACITY			0x13B6
+#define RENOGY_BATTERY_MODEL			0x1402
+
+/** Renogy inverters and inverter chargers, at MODBUS_ADDRESS_INVERTER
+ */
+#define RENOGY_INVERTER_INPUT_VOLTAGE	0x0FA0
+#define RENOGY_INVERTER_INPUT_CURRENT	0x0FA1
+#define RENOGY_INVERTER_OUTPUT_VOLTAGE	0x0FA2
+#define RENOGY_INVERTER_OUTPUT_CURRENT	0x0FA3
+#define RENOGY_INVERTER_OUTPUT_FREQUENCY	0x0FA4
+#define RENOGY_INVERTER_BATTERY_VOLTAGE	0x0FA5
+#define RENOGY_INVERTER_TEMPERATURE		0x0FA6
+#define RENOGY_INVERTER_INPUT_FREQUENCY	0x0FA7
+#define RENOGY_INVERTER_MODEL			0x10D7
 
+
+/** The reads the Renogy BT app makes.  BT2ReadPlan::addRegisterMap() covers the same registers in fewer commands
+ */
 const RENOGY_COMMANDS renogyCommands[8] = {
 	{0x000C, 2},												// Startup; this is always the first command send on connection
 	{0x000C, 8},												// Product model
@@ -134,6 +268,16 @@ const RENOGY_COMMANDS renogyCommands[8] = {
 	{0xE001, 0x21}												// battery type and other settings
 };
 
+/** Registers that don't change while connected, persisted per device by the identity cache (BT2IdentityCache.cpp)
+ */
+#define IDENTITY_REGISTER_RANGES		2
+const RENOGY_COMMANDS identityRegisters[IDENTITY_REGISTER_RANGES] = {
+	{RENOGY_PRODUCT_MODEL, RENOGY_CONTROLLER_ADDRESS - RENOGY_PRODUCT_MODEL + 1},	// model, versions, serial number, address
+	{RENOGY_AUX_BATT_CAPACITY, RENOGY_AUX_BATT_TYPE - RENOGY_AUX_BATT_CAPACITY + 1}	// battery settings
+};
+constexpr int IDENTITY_CACHE_SIZE = 6 + IDENTITY_REGISTER_RANGES * 4 + 2 + 2 * 
+	(RENOGY_CONTROLLER_ADDRESS - RENOGY_PRODUCT_MODEL + 1 + RENOGY_AUX_BATT_TYPE - RENOGY_AUX_BATT_CAPACITY + 1);
+
 struct REGISTER_DESCRIPTION {
 	uint16_t address;
 	uint8_t bytesUsed;
@@ -146,7 +290,7 @@ struct REGISTER_DESCRIPTION {
  *  https://www.dropbox.com/s/03vfqklw97hziqr/%E9%80%9A%E7%94%A8%E5%8D%8F%E8%AE%AE%20V2%20%28%E6%94%AF%E6%8C%8130%E4%B8%B2%29%28Engrish%29.xlsx?dl=0
  *	^^^ has details on the data formats
  */
-const REGISTER_DESCRIPTION registerDescription[] = {
+inline constexpr REGISTER_DESCRIPTION registerDescription[] = {
 	{INVALID_REGISTER, 2, "Invalid register", RENOGY_CHARS, 1},
 	{RENOGY_PRODUCT_MODEL, 16, "Product model", RENOGY_CHARS, 1},
 	{RENOGY_SOFTWARE_VERSION, 4, "Software version", RENOGY_BYTES, 1},
@@ -186,13 +330,136 @@ const REGISTER_DESCRIPTION registerDescription[] = {
 
 };
 
+/** Compile time index from register address to value slot and description.  The register map is a handful of
+ * dense runs (0x0000-0x001A, 0x0100-0x0122, 0xE002-0xE004), so runs closer than REGISTER_INDEX_MAX_GAP are merged
+ * into a segment and each segment gets a flat entry per address.  A lookup is a scan of the few segments and an
+ * offset into that segment, instead of a binary search over the values and another over the descriptions.
+ */
+#define REGISTER_INDEX_NONE				0xFF
+#define REGISTER_INDEX_MAX_GAP			16
+
+struct REGISTER_INDEX_ENTRY {
+	uint8_t valueIndex;											// slot in DEVICE::registerValues, or REGISTER_INDEX_NONE
+	uint8_t descriptionIndex;									// registerDescription entry starting here, or REGISTER_INDEX_NONE
+};
+
+struct REGISTER_INDEX_SEGMENT {
+	uint16_t firstAddress;
+	uint16_t length;
+	uint16_t entryOffset;
+};
+
+template <int SEGMENTS, int ENTRIES> struct REGISTER_INDEX {
+	REGISTER_INDEX_SEGMENT segments[SEGMENTS];
+	REGISTER_INDEX_ENTRY entries[ENTRIES];
+	static constexpr int segmentCount = SEGMENTS;
+	static constexpr int entryCount = ENTRIES;
+};
+
+constexpr int getRegisterEndAddress(const REGISTER_DESCRIPTION & description) { return description.address + description.bytesUsed / 2; }
+
+constexpr int countRegisterValueSlots(const REGISTER_DESCRIPTION * descriptions, int size) {
+	int slots = 0;
+	for (int i = 0; i < size; i++) { slots += descriptions[i].bytesUsed / 2; }
+	return slots;
+}
+
+constexpr boolean getIsRegisterMapSorted(const REGISTER_DESCRIPTION * descriptions, int size) {
+	for (int i = 1; i < size; i++) {
+		if (descriptions[i].address < getRegisterEndAddress(descriptions[i - 1])) { return false; }
+	}
+	return true;
+}
+
+constexpr int countRegisterIndexSegments(const REGISTER_DESCRIPTION * descriptions, int size) {
+	int segments = size > 0 ? 1 : 0;
+	for (int i = 1; i < size; i++) {
+		if (descriptions[i].address - getRegisterEndAddress(descriptions[i - 1]) > REGISTER_INDEX_MAX_GAP) { segments++; }
+	}
+	return segments;
+}
+
+constexpr int countRegisterIndexEntries(const REGISTER_DESCRIPTION * descriptions, int size) {
+	int entries = 0;
+	int segmentStart = 0;
+	for (int i = 1; i <= size; i++) {
+		if (i == size || descriptions[i].address - getRegisterEndAddress(descriptions[i - 1]) > REGISTER_INDEX_MAX_GAP) {
+			entries += getRegisterEndAddress(descriptions[i - 1]) - descriptions[segmentStart].address;
+			segmentStart = i;
+		}
+	}
+	return entries;
+}
+
+template <int SEGMENTS, int ENTRIES> constexpr REGISTER_INDEX<SEGMENTS, ENTRIES> buildRegisterIndex(const REGISTER_DESCRIPTION * descriptions, int size) {
+	REGISTER_INDEX<SEGMENTS, ENTRIES> index = {};
+	for (int i = 0; i < ENTRIES; i++) { index.entries[i] = { REGISTER_INDEX_NONE, REGISTER_INDEX_NONE }; }
+
+	int segment = -1;
+	int entryOffset = 0;
+	int valueIndex = 0;
+	for (int i = 0; i < size; i++) {
+		if (i == 0 || descriptions[i].address - getRegisterEndAddress(descriptions[i - 1]) > REGISTER_INDEX_MAX_GAP) {
+			if (segment >= 0) { entryOffset += index.segments[segment].length; }
+			segment++;
+			index.segments[segment] = { descriptions[i].address, 0, (uint16_t)entryOffset };
+		}
+		REGISTER_INDEX_SEGMENT & current = index.segments[segment];
+		current.length = getRegisterEndAddress(descriptions[i]) - current.firstAddress;
+		int entry = current.entryOffset + descriptions[i].address - current.firstAddress;
+		index.entries[entry].descriptionIndex = i;
+		for (int k = 0; k < descriptions[i].bytesUsed / 2; k++) { index.entries[entry + k].valueIndex = valueIndex++; }
+	}
+	return index;
+}
+
+/** Compile time lookups in a register index, so accessors for a register known at compile time reduce to an
+ * array read and a multiply
+ */
+template <typename INDEX> constexpr const REGISTER_INDEX_ENTRY * findRegisterIndexEntry(const INDEX & index, uint16_t registerAddress) {
+	for (int i = 0; i < index.segmentCount; i++) {
+		const REGISTER_INDEX_SEGMENT & segment = index.segments[i];
+		if ((uint16_t)(registerAddress - segment.firstAddress) < segment.length) { 
+			return &index.entries[segment.entryOffset + registerAddress - segment.firstAddress]; 
+		}
+	}
+	return NULL;
+}
+
+template <typename INDEX> constexpr int findRegisterValueIndex(const INDEX & index, uint16_t registerAddress) {
+	return (findRegisterIndexEntry(index, registerAddress) == NULL || findRegisterIndexEntry(index, registerAddress)->valueIndex == REGISTER_INDEX_NONE) 
+		? -1 : findRegisterIndexEntry(index, registerAddress)->valueIndex;
+}
+
+template <typename INDEX> constexpr int findRegisterDescriptionIndex(const INDEX & index, uint16_t registerAddress) {
+	return (findRegisterIndexEntry(index, registerAddress) == NULL || findRegisterIndexEntry(index, registerAddress)->descriptionIndex == REGISTER_INDEX_NONE) 
+		? -1 : findRegisterIndexEntry(index, registerAddress)->descriptionIndex;
+}
+
+/** Fixed point scale: thousandths of the register's unit per count, e.g. 100 mV per count for a 0.1 V register
+ */
+constexpr int32_t getRegisterMilliScale(const REGISTER_DESCRIPTION & description) { return (int32_t)(description.multiplier * 1000 + 0.5f); }
+
+/** A description's type without RENOGY_SIGNED_FLAG, and whether its register is two's complement
+ */
+constexpr uint8_t getRegisterUnit(uint8_t type) { return type & RENOGY_UNIT_MASK; }
+constexpr boolean getIsRegisterSigned(uint8_t type) { return (type & RENOGY_SIGNED_FLAG) != 0 || type == RENOGY_SIGNED; }
+
+/** A scaled value as getScaledValue returns it: a 4 byte counter past about 2.1 million stops at INT32_MAX rather
+ * than wrapping negative
+ */
+constexpr int32_t getSaturatedMilli(int64_t milli) { return (milli > INT32_MAX ? INT32_MAX : (milli < INT32_MIN ? INT32_MIN : (int32_t)milli)); }
+
+
 struct RENOGY_BIT_FLAG_TABLE {
 	int registerAddress;
 	int bit;
 	const char * bitName;
 };
 
-const RENOGY_BIT_FLAG_TABLE renogyBitFlags[] {
+/** Bit flags are printed a register at a time, so each register's flags must be together; BT2_REGISTER_MAP checks
+ */
+inline constexpr RENOGY_BIT_FLAG_TABLE renogyBitFlags[] {
 	{RENOGY_ERROR_FLAGS_1, 11, "Aux batt low temperature" },
 	{RENOGY_ERROR_FLAGS_1, 10, "Aux batt overcharge protection" },
 	{RENOGY_ERROR_FLAGS_1, 9, "Starter batt reverse polarity" },
@@ -215,7 +482,7 @@ struct RENOGY_OPTIONS_TABLE {
 	const char * optionName;
 };
 
-const RENOGY_OPTIONS_TABLE renogyOptions[] {
+inline constexpr RENOGY_OPTIONS_TABLE renogyOptions[] {
 	{RENOGY_CHARGING_MODE, 0, "No charging activated" },
 	{RENOGY_CHARGING_MODE, 1, "Reserved" },
 	{RENOGY_CHARGING_MODE, 2, "MPPT charging (solar)" },
@@ -228,15 +495,551 @@ const RENOGY_OPTIONS_TABLE renogyOptions[] {
 
 	{RENOGY_AUX_BATT_TYPE, 0, "User mode" },
 	{RENOGY_AUX_BATT_TYPE, 1, "Open cell Lead Acid" },
-	{RENOGY_AUX_BATT_TYPE, 8, "Sealed Lead Acid" },
-	{RENOGY_AUX_BATT_TYPE, 8, "AGM Lead Acid" },
-	{RENOGY_AUX_BATT_TYPE, 8, "Lithium Iron Phosphate" }
+	{RENOGY_AUX_BATT_TYPE, 2, "Sealed (AGM) Lead Acid" },
+	{RENOGY_AUX_BATT_TYPE, 3, "Gel Lead Acid" },
+	{RENOGY_AUX_BATT_TYPE, 4, "Lithium Iron Phosphate" }
+};
+
+
+/** Register map DSL.  A profile is a struct naming its tables:
+ *
+ *		struct MY_REGISTERS {
+ *			static constexpr const char * name = "My device";
+ *			static constexpr uint8_t modbusAddress = MODBUS_ADDRESS_CONTROLLER;
+ *			static constexpr const auto & descriptions = myRegisterDescription;		// REGISTER_DESCRIPTION[]
+ *			static constexpr const auto & bitFlags = myBitFlags;					// or std::nullptr_t bitFlags = nullptr
+ *			static constexpr const auto & options = myOptions;						// or std::nullptr_t options = nullptr
+ *			static constexpr uint16_t optionMask = 0xFFFF;							// bits of a RENOGY_OPTIONS register that hold the option
+ *		};
+ *		using BT2_REGISTER_MAP_MINE = BT2_REGISTER_MAP<MY_REGISTERS>;
+ *
+ * BT2_REGISTER_MAP checks the tables at compile time, derives the value slot count and the register index, and
+ * provides BT2_REGISTER_PROFILE ::profile for setRegisterProfile() and BT2ReadPlan::addRegisterMap().  A device
+ * bound to a profile only holds values for, and only polls, the registers that profile describes
+ */
+template <typename T, size_t N> constexpr int getTableSize(const T (&)[N]) { return N; }
+constexpr int getTableSize(std::nullptr_t) { return 0; }
+
+constexpr int getRegisterMapType(const REGISTER_DESCRIPTION * descriptions, int size, int registerAddress) {
+	for (int i = 0; i < size; i++) {
+		if (descriptions[i].address == registerAddress) { return descriptions[i].type; }
+	}
+	return -1;
+}
+
+/** Whole registers only, and the types that are decoded from a single register use exactly one
+ */
+constexpr boolean getIsRegisterMapWellFormed(const REGISTER_DESCRIPTION * descriptions, int size) {
+	for (int i = 0; i < size; i++) {
+		if (descriptions[i].bytesUsed == 0 || (descriptions[i].bytesUsed & 0x01) != 0) { return false; }
+		boolean singleRegister = descriptions[i].type == RENOGY_BIT_FLAGS || descriptions[i].type == RENOGY_OPTIONS || getIsRegisterSigned(descriptions[i].type);
+		if (singleRegister && descriptions[i].bytesUsed != 2) { return false; }
+	}
+	return true;
+}
+
+constexpr boolean getIsBitFlagTableValid(const RENOGY_BIT_FLAG_TABLE * bitFlags, int bitFlagSize, const REGISTER_DESCRIPTION * descriptions, int size) {
+	for (int i = 0; i < bitFlagSize; i++) {
+		if (bitFlags[i].bit < 0 || bitFlags[i].bit > 15) { return false; }
+		if (getRegisterMapType(descriptions, size, bitFlags[i].registerAddress) != RENOGY_BIT_FLAGS) { return false; }
+		for (int j = 0; j < i; j++) {
+			if (bitFlags[j].registerAddress != bitFlags[i].registerAddress) { continue; }
+			if (bitFlags[j].bit == bitFlags[i].bit || bitFlags[i - 1].registerAddress != bitFlags[i].registerAddress) { return false; }
+		}
+	}
+	return true;
+}
+
+constexpr boolean getIsOptionTableValid(const RENOGY_OPTIONS_TABLE * options, int optionSize, const REGISTER_DESCRIPTION * descriptions, int size) {
+	for (int i = 0; i < optionSize; i++) {
+		if (getRegisterMapType(descriptions, size, options[i].registerAddress) != RENOGY_OPTIONS) { return false; }
+		for (int j = 0; j < i; j++) {
+			if (options[j].registerAddress != options[i].registerAddress) { continue; }
+			if (options[j].option == options[i].option || options[i - 1].registerAddress != options[i].registerAddress) { return false; }
+		}
+	}
+	return true;
+}
+
+/** Per description: where its names start in the profile's bitFlags or options table, and how many there are.
+ * Both tables are grouped by register, so the formatter goes straight to a register's names instead of scanning.
+ * namedBits has a bit set for each named bit of a RENOGY_BIT_FLAGS register
+ */
+struct REGISTER_LABEL_ENTRY {
+	uint8_t first;
+	uint8_t count;
+	uint16_t namedBits;
+};
+
+template <int SIZE> struct REGISTER_LABEL_INDEX {
+	REGISTER_LABEL_ENTRY entries[SIZE];
 };
 
+template <int SIZE> constexpr REGISTER_LABEL_INDEX<SIZE> buildRegisterLabelIndex(const REGISTER_DESCRIPTION * descriptions,
+		const RENOGY_BIT_FLAG_TABLE * bitFlags, int bitFlagSize, const RENOGY_OPTIONS_TABLE * options, int optionSize) {
+	REGISTER_LABEL_INDEX<SIZE> index = {};
+	for (int d = 0; d < SIZE; d++) {
+		REGISTER_LABEL_ENTRY & entry = index.entries[d];
+		for (int i = 0; i < bitFlagSize; i++) {
+			if (bitFlags[i].registerAddress != descriptions[d].address || descriptions[d].type != RENOGY_BIT_FLAGS) { continue; }
+			if (entry.count++ == 0) { entry.first = i; }
+			entry.namedBits |= 1 << bitFlags[i].bit;
+		}
+		for (int i = 0; i < optionSize; i++) {
+			if (options[i].registerAddress != descriptions[d].address || descriptions[d].type != RENOGY_OPTIONS) { continue; }
+			if (entry.count++ == 0) { entry.first = i; }
+		}
+	}
+	return index;
+}
+
+/** A register map as the runtime sees it; each DEVICE points at the one it is bound to
+ */
+struct BT2_REGISTER_PROFILE {
+	const char * name;
+	uint8_t modbusAddress;												// first byte of every command and response
+	const REGISTER_DESCRIPTION * descriptions;
+	uint8_t descriptionSize;
+	uint8_t valueSize;													// uint16_t slots in DEVICE::registerValues
+	const REGISTER_INDEX_SEGMENT * segments;
+	uint8_t segmentCount;
+	const REGISTER_INDEX_ENTRY * entries;
+	const RENOGY_BIT_FLAG_TABLE * bitFlags;
+	uint8_t bitFlagSize;
+	const RENOGY_OPTIONS_TABLE * options;
+	uint8_t optionSize;
+	uint16_t optionMask;												// applied to a RENOGY_OPTIONS value before it's looked up
+	const REGISTER_LABEL_ENTRY * labels;								// per description
+};
+
+template <typename DEFINITION> struct BT2_REGISTER_MAP {
+	static constexpr const REGISTER_DESCRIPTION * descriptions = DEFINITION::descriptions;
+	static constexpr int descriptionSize = getTableSize(DEFINITION::descriptions);
+	static constexpr int valueSize = countRegisterValueSlots(descriptions, descriptionSize);
+	static constexpr const RENOGY_BIT_FLAG_TABLE * bitFlags = DEFINITION::bitFlags;
+	static constexpr int bitFlagSize = getTableSize(DEFINITION::bitFlags);
+	static constexpr const RENOGY_OPTIONS_TABLE * options = DEFINITION::options;
+	static constexpr int optionSize = getTableSize(DEFINITION::options);
+
+	static_assert(getIsRegisterMapSorted(descriptions, descriptionSize), "register map must be sorted by address with no overlapping registers");
+	static_assert(getIsRegisterMapWellFormed(descriptions, descriptionSize), "register map entries must be whole registers; bit flag, option and signed registers exactly one");
+	static_assert(valueSize < REGISTER_INDEX_NONE && descriptionSize < REGISTER_INDEX_NONE, "register map too large for a uint8_t index");
+	static_assert(getIsBitFlagTableValid(bitFlags, bitFlagSize, descriptions, descriptionSize), "bit flags must be bits 0-15 of a RENOGY_BIT_FLAGS register in the map, grouped by register, with no repeats");
+	static_assert(getIsOptionTableValid(options, optionSize, descriptions, descriptionSize), "options must belong to a RENOGY_OPTIONS register in the map, grouped by register, with no repeats");
+
+	static constexpr auto index = buildRegisterIndex<
+		countRegisterIndexSegments(descriptions, descriptionSize),
+		countRegisterIndexEntries(descriptions, descriptionSize)>(descriptions, descriptionSize);
+
+	static constexpr auto labels = buildRegisterLabelIndex<descriptionSize>(descriptions, bitFlags, bitFlagSize, options, optionSize);
+
+	static constexpr int findValueIndex(uint16_t registerAddress) { return findRegisterValueIndex(index, registerAddress); }
+	static constexpr int findDescriptionIndex(uint16_t registerAddress) { return findRegisterDescriptionIndex(index, registerAddress); }
+
+	static constexpr BT2_REGISTER_PROFILE profile = {
+		DEFINITION::name, DEFINITION::modbusAddress, descriptions, (uint8_t)descriptionSize, (uint8_t)valueSize,
+		index.segments, (uint8_t)index.segmentCount, index.entries, bitFlags, (uint8_t)bitFlagSize, options, (uint8_t)optionSize, DEFINITION::optionMask, labels.entries
+	};
+};
+
+
+/** DCC30S / DCC50S: registerDescription, renogyBitFlags and renogyOptions above.  Every device starts out bound to it
+ */
+struct BT2_DCC_REGISTERS {
+	static constexpr const char * name = "DCC";
+	static constexpr uint8_t modbusAddress = MODBUS_ADDRESS_CONTROLLER;
+	static constexpr const auto & descriptions = registerDescription;
+	static constexpr const auto & bitFlags = renogyBitFlags;
+	static constexpr const auto & options = renogyOptions;
+	static constexpr uint16_t optionMask = 0xFFFF;
+};
+using BT2_REGISTER_MAP_DCC = BT2_REGISTER_MAP<BT2_DCC_REGISTERS>;
+
+constexpr int REGISTER_DESCRIPTION_SIZE = BT2_REGISTER_MAP_DCC::descriptionSize;
+constexpr int REGISTER_VALUE_SIZE = BT2_REGISTER_MAP_DCC::valueSize;
+inline constexpr const auto & registerIndex = BT2_REGISTER_MAP_DCC::index;
+
+constexpr const REGISTER_INDEX_ENTRY * findRegisterIndexEntry(uint16_t registerAddress) { return findRegisterIndexEntry(registerIndex, registerAddress); }
+constexpr int findRegisterValueIndex(uint16_t registerAddress) { return findRegisterValueIndex(registerIndex, registerAddress); }
+constexpr int findRegisterDescriptionIndex(uint16_t registerAddress) { return findRegisterDescriptionIndex(registerIndex, registerAddress); }
+
+
+/** Rover / Wanderer / Adventurer MPPT charge controllers
+ */
+inline constexpr REGISTER_DESCRIPTION roverRegisterDescription[] = {
+	{RENOGY_PRODUCT_MODEL, 16, "Product model", RENOGY_CHARS, 1},
+	{RENOGY_SOFTWARE_VERSION, 4, "Software version", RENOGY_BYTES, 1},
+	{RENOGY_HARDWARE_VERSION, 4, "Hardware version", RENOGY_BYTES, 1},
+	{RENOGY_SERIAL_NUMBER, 4, "Serial number", RENOGY_BYTES, 1},
+	{RENOGY_CONTROLLER_ADDRESS, 2, "Controller address", RENOGY_BYTES, 1},
+
+	{RENOGY_AUX_BATT_SOC, 2, "Battery SOC\%", RENOGY_DECIMAL, 1},
+	{RENOGY_AUX_BATT_VOLTAGE, 2, "Battery voltage", RENOGY_VOLTS, 0.1},
+	{RENOGY_MAX_CHARGE_CURRENT, 2, "Charging current", RENOGY_AMPS, 0.01},
+	{RENOGY_AUX_BATT_TEMPERATURE, 2, "Battery, controller temperature", RENOGY_TEMPERATURE, 1},
+	{RENOGY_LOAD_VOLTAGE, 2, "Load voltage", RENOGY_VOLTS, 0.1},
+	{RENOGY_LOAD_CURRENT, 2, "Load current", RENOGY_AMPS, 0.01},
+	{RENOGY_LOAD_POWER, 2, "Load power (Watts)", RENOGY_DECIMAL, 1},
+	{RENOGY_SOLAR_VOLTAGE, 2, "Solar Voltage", RENOGY_VOLTS, 0.1},
+	{RENOGY_SOLAR_CURRENT, 2, "Solar current", RENOGY_AMPS, 0.01},
+	{RENOGY_SOLAR_POWER, 2, "Solar power (Watts)", RENOGY_DECIMAL, 1},
+
+	{RENOGY_AUX_BATT_LOW_VOLTAGE, 2, "Today battery low voltage", RENOGY_VOLTS, 0.1},
+	{RENOGY_AUX_BATT_HIGH_VOLTAGE, 2, "Today battery high voltage", RENOGY_VOLTS, 0.1},
+	{RENOGY_TODAY_HIGHEST_CURRENT, 2, "Today highest charge current", RENOGY_AMPS, 0.01},
+	{RENOGY_TODAY_HIGHEST_DISCHARGE_CURRENT, 2, "Today highest discharge current", RENOGY_AMPS, 0.01},
+	{RENOGY_TODAY_HIGHEST_POWER, 2, "Today highest charge power (Watts)", RENOGY_DECIMAL, 1},
+	{RENOGY_TODAY_HIGHEST_DISCHARGE_POWER, 2, "Today highest discharge power (Watts)", RENOGY_DECIMAL, 1},
+	{RENOGY_TODAY_AMP_HOURS, 2, "Today charge Amp Hours", RENOGY_DECIMAL, 1},
+	{RENOGY_TODAY_DISCHARGE_AMP_HOURS, 2, "Today discharge Amp Hours", RENOGY_DECIMAL, 1},
+	{RENOGY_TODAY_POWER, 2, "Today generation (Watt Hours)", RENOGY_DECIMAL, 1},
+	{RENOGY_TODAY_CONSUMPTION, 2, "Today consumption (Watt Hours)", RENOGY_DECIMAL, 1},
+	{RENOGY_OPERATING_DAYS, 2, "Operating days", RENOGY_DECIMAL, 1},
+	{RENOGY_OVER_DISCHARGES, 2, "Battery over-discharges", RENOGY_DECIMAL, 1},
+	{RENOGY_FULL_CHARGES, 2, "Battery full charges", RENOGY_DECIMAL, 1},
+	{RENOGY_TOTAL_CHARGE_AMP_HOURS, 4, "Total charge Amp Hours", RENOGY_DECIMAL, 1},
+	{RENOGY_TOTAL_DISCHARGE_AMP_HOURS, 4, "Total discharge Amp Hours", RENOGY_DECIMAL, 1},
+	{RENOGY_TOTAL_GENERATION, 4, "Total generation (Watt Hours)", RENOGY_DECIMAL, 1},
+	{RENOGY_TOTAL_CONSUMPTION, 4, "Total consumption (Watt Hours)", RENOGY_DECIMAL, 1},
+	{RENOGY_CHARGING_MODE, 2, "Charging state", RENOGY_OPTIONS, 1},
+	{RENOGY_FAULT_FLAGS, 2, "Fault codes", RENOGY_BIT_FLAGS, 1},
+
+	{RENOGY_AUX_BATT_CAPACITY, 2, "Battery capacity (Amp Hours)", RENOGY_DECIMAL, 1},
+	{RENOGY_AUX_BATT_TYPE, 2, "Battery chemistry", RENOGY_OPTIONS, 1}
+};
+
+inline constexpr RENOGY_BIT_FLAG_TABLE roverBitFlags[] {
+	{RENOGY_FAULT_FLAGS, 14, "Charge MOSFET short circuit" },
+	{RENOGY_FAULT_FLAGS, 13, "Anti-reverse MOSFET short circuit" },
+	{RENOGY_FAULT_FLAGS, 12, "Solar reverse polarity" },
+	{RENOGY_FAULT_FLAGS, 11, "Solar working point overvoltage" },
+	{RENOGY_FAULT_FLAGS, 10, "Solar counter current" },
+	{RENOGY_FAULT_FLAGS, 9, "Solar input overvoltage" },
+	{RENOGY_FAULT_FLAGS, 8, "Solar input short circuit" },
+	{RENOGY_FAULT_FLAGS, 7, "Solar input overpower" },
+	{RENOGY_FAULT_FLAGS, 6, "Ambient overtemperature" },
+	{RENOGY_FAULT_FLAGS, 5, "Controller overtemperature" },
+	{RENOGY_FAULT_FLAGS, 4, "Load overpower or overcurrent" },
+	{RENOGY_FAULT_FLAGS, 3, "Load short circuit" },
+	{RENOGY_FAULT_FLAGS, 2, "Battery undervoltage" },
+	{RENOGY_FAULT_FLAGS, 1, "Battery overvoltage" },
+	{RENOGY_FAULT_FLAGS, 0, "Battery overdischarged" }
+};
+
+/** The charging state is the low byte of RENOGY_CHARGING_MODE; bit 15 is set while the load output is on, so the
+ * profile's optionMask keeps only the low byte
+ */
+inline constexpr RENOGY_OPTIONS_TABLE roverOptions[] {
+	{RENOGY_CHARGING_MODE, 0, "Charging deactivated" },
+	{RENOGY_CHARGING_MODE, 1, "Charging activated" },
+	{RENOGY_CHARGING_MODE, 2, "MPPT charging" },
+	{RENOGY_CHARGING_MODE, 3, "Equalization charging" },
+	{RENOGY_CHARGING_MODE, 4, "Boost charging" },
+	{RENOGY_CHARGING_MODE, 5, "Float charging" },
+	{RENOGY_CHARGING_MODE, 6, "Current limited charging" },
+
+	{RENOGY_AUX_BATT_TYPE, 0, "User mode" },
+	{RENOGY_AUX_BATT_TYPE, 1, "Open cell Lead Acid" },
+	{RENOGY_AUX_BATT_TYPE, 2, "Sealed (AGM) Lead Acid" },
+	{RENOGY_AUX_BATT_TYPE, 3, "Gel Lead Acid" },
+	{RENOGY_AUX_BATT_TYPE, 4, "Lithium Iron Phosphate" }
+};
+
+struct BT2_ROVER_REGISTERS {
+	static constexpr const char * name = "Rover";
+	static constexpr uint8_t modbusAddress = MODBUS_ADDRESS_CONTROLLER;
+	static constexpr const auto & descriptions = roverRegisterDescription;
+	static constexpr const auto & bitFlags = roverBitFlags;
+	static constexpr const auto & options = roverOptions;
+	static constexpr uint16_t optionMask = 0x00FF;							// bit 15 of RENOGY_CHARGING_MODE is the load
+};
+using BT2_REGISTER_MAP_ROVER = BT2_REGISTER_MAP<BT2_ROVER_REGISTERS>;
+
+
+/** Renogy smart LiFePO4 batteries.  Cells and sensors 1-4 cover a 12V battery; extend the runs for larger packs
+ */
+inline constexpr REGISTER_DESCRIPTION smartBatteryRegisterDescription[] = {
+	{RENOGY_BATTERY_CELL_COUNT, 2, "Cell count", RENOGY_DECIMAL, 1},
+	{RENOGY_BATTERY_CELL_VOLTAGE, 2, "Cell 1 voltage", RENOGY_VOLTS, 0.1},
+	{RENOGY_BATTERY_CELL_VOLTAGE + 1, 2, "Cell 2 voltage", RENOGY_VOLTS, 0.1},
+	{RENOGY_BATTERY_CELL_VOLTAGE + 2, 2, "Cell 3 voltage", RENOGY_VOLTS, 0.1},
+	{RENOGY_BATTERY_CELL_VOLTAGE + 3, 2, "Cell 4 voltage", RENOGY_VOLTS, 0.1},
+	{RENOGY_BATTERY_SENSOR_COUNT, 2, "Temperature sensor count", RENOGY_DECIMAL, 1},
+	{RENOGY_BATTERY_CELL_TEMPERATURE, 2, "Cell temperature 1 (C)", RENOGY_SIGNED, 0.1},
+	{RENOGY_BATTERY_CELL_TEMPERATURE + 1, 2, "Cell temperature 2 (C)", RENOGY_SIGNED, 0.1},
+	{RENOGY_BATTERY_CELL_TEMPERATURE + 2, 2, "Cell temperature 3 (C)", RENOGY_SIGNED, 0.1},
+	{RENOGY_BATTERY_CELL_TEMPERATURE + 3, 2, "Cell temperature 4 (C)", RENOGY_SIGNED, 0.1},
+	{RENOGY_BATTERY_CURRENT, 2, "Battery current (Amps)", RENOGY_AMPS | RENOGY_SIGNED_FLAG, 0.01},
+	{RENOGY_BATTERY_VOLTAGE, 2, "Battery voltage", RENOGY_VOLTS, 0.1},
+	{RENOGY_BATTERY_REMAINING_CHARGE, 4, "Remaining charge (mAh)", RENOGY_DECIMAL, 1},
+	{RENOGY_BATTERY_CAPACITY, 4, "Capacity (mAh)", RENOGY_DECIMAL, 1},
+	{RENOGY_BATTERY_MODEL, 16, "Battery model", RENOGY_CHARS, 1}
+};
+
+struct BT2_SMART_BATTERY_REGISTERS {
+	static constexpr const char * name = "Smart battery";
+	static constexpr uint8_t modbusAddress = MODBUS_ADDRESS_SMART_BATTERY;
+	static constexpr const auto & descriptions = smartBatteryRegisterDescription;
+	static constexpr std::nullptr_t bitFlags = nullptr;
+	static constexpr std::nullptr_t options = nullptr;
+	static constexpr uint16_t optionMask = 0xFFFF;
+};
+using BT2_REGISTER_MAP_SMART_BATTERY = BT2_REGISTER_MAP<BT2_SMART_BATTERY_REGISTERS>;
+
+
+/** Renogy inverters and inverter chargers
+ */
+inline constexpr REGISTER_DESCRIPTION inverterRegisterDescription[] = {
+	{RENOGY_INVERTER_INPUT_VOLTAGE, 2, "AC input voltage", RENOGY_VOLTS, 0.1},
+	{RENOGY_INVERTER_INPUT_CURRENT, 2, "AC input current", RENOGY_AMPS, 0.01},
+	{RENOGY_INVERTER_OUTPUT_VOLTAGE, 2, "AC output voltage", RENOGY_VOLTS, 0.1},
+	{RENOGY_INVERTER_OUTPUT_CURRENT, 2, "AC output current", RENOGY_AMPS, 0.01},
+	{RENOGY_INVERTER_OUTPUT_FREQUENCY, 2, "Output frequency (Hz)", RENOGY_SIGNED, 0.01},
+	{RENOGY_INVERTER_BATTERY_VOLTAGE, 2, "Battery voltage", RENOGY_VOLTS, 0.1},
+	{RENOGY_INVERTER_TEMPERATURE, 2, "Temperature (C)", RENOGY_SIGNED, 0.1},
+	{RENOGY_INVERTER_INPUT_FREQUENCY, 2, "Input frequency (Hz)", RENOGY_SIGNED, 0.01},
+	{RENOGY_INVERTER_MODEL, 16, "Inverter model", RENOGY_CHARS, 1}
+};
+
+struct BT2_INVERTER_REGISTERS {
+	static constexpr const char * name = "Inverter";
+	static constexpr uint8_t modbusAddress = MODBUS_ADDRESS_INVERTER;
+	static constexpr const auto & descriptions = inverterRegisterDescription;
+	static constexpr std::nullptr_t bitFlags = nullptr;
+	static constexpr std::nullptr_t options = nullptr;
+	static constexpr uint16_t optionMask = 0xFFFF;
+};
+using BT2_REGISTER_MAP_INVERTER = BT2_REGISTER_MAP<BT2_INVERTER_REGISTERS>;
+
+/** Subscriptions are indexed by description, so they're sized for the largest built in profile, and a
+ * StaticBT2Reader's values are too unless it's told otherwise, so detection can bind any of them
+ */
+constexpr int getLargestTableSize(std::initializer_list<int> sizes) {
+	int largest = 0;
+	for (int size : sizes) { largest = size > largest ? size : largest; }
+	return largest;
+}
+constexpr int MAXIMUM_PROFILE_DESCRIPTIONS = getLargestTableSize({ BT2_REGISTER_MAP_DCC::descriptionSize, BT2_REGISTER_MAP_ROVER::descriptionSize,
+	BT2_REGISTER_MAP_SMART_BATTERY::descriptionSize, BT2_REGISTER_MAP_INVERTER::descriptionSize });
+constexpr int MAXIMUM_PROFILE_VALUES = getLargestTableSize({ BT2_REGISTER_MAP_DCC::valueSize, BT2_REGISTER_MAP_ROVER::valueSize,
+	BT2_REGISTER_MAP_SMART_BATTERY::valueSize, BT2_REGISTER_MAP_INVERTER::valueSize });
+static_assert(MAXIMUM_BT2_DEVICES <= BT2_SNAPSHOT_MAXIMUM_DEVICES && MAXIMUM_PROFILE_VALUES <= BT2_SNAPSHOT_MAXIMUM_VALUES, "snapshots can't hold every device and register");
+
+/** A model family beginProfileDetection() recognises: modelPrefix is matched against the start of the trimmed
+ * RENOGY_PRODUCT_MODEL string, and a match binds the device to profile and, if it isn't NULL, readPlan
+ */
+struct BT2_MODEL_PROFILE {
+	const char * modelPrefix;
+	const BT2_REGISTER_PROFILE * profile;
+	BT2ReadPlan * readPlan;
+};
+
+/** Controllers answering at MODBUS_ADDRESS_CONTROLLER; batteries and inverters don't implement 0x000C
+ */
+inline constexpr BT2_MODEL_PROFILE knownModelProfiles[] = {
+	{"RBC", &BT2_REGISTER_MAP_DCC::profile, NULL},							// DCC30S, DCC50S (RBC30D1S, RBC50D1S)
+	{"RNG-CTRL-RVR", &BT2_REGISTER_MAP_ROVER::profile, NULL},				// Rover, Rover Li
+	{"RNG-CTRL-WND", &BT2_REGISTER_MAP_ROVER::profile, NULL},				// Wanderer
+	{"RNG-CTRL-ADV", &BT2_REGISTER_MAP_ROVER::profile, NULL},				// Adventurer
+};
+
+/** Charging sources beginEnergy() integrates.  A source is integrated on a device whose profile describes both its
+ * registers and, if profile isn't NULL, only with that profile: a Rover has its load output where the DCC has the
+ * alternator.  RENOGY_TODAY_POWER and RENOGY_TODAY_AMP_HOURS count all of them together
+ */
+#define BT2_ENERGY_SOLAR				0
+#define BT2_ENERGY_ALTERNATOR			1
+#define BT2_ENERGY_SOURCES				2
+
+struct BT2_ENERGY_SOURCE {
+	const char * name;
+	uint16_t powerRegister;
+	uint16_t currentRegister;
+	const BT2_REGISTER_PROFILE * profile;
+};
+
+inline constexpr BT2_ENERGY_SOURCE energySources[BT2_ENERGY_SOURCES] = {
+	{"Solar", RENOGY_SOLAR_POWER, RENOGY_SOLAR_CURRENT, NULL},
+	{"Alternator", RENOGY_ALTERNATOR_POWER, RENOGY_ALTERNATOR_CURRENT, &BT2_REGISTER_MAP_DCC::profile},
+};
+
+/** The controller's daily counters the integrated totals are checked against: Wh, then Ah */
+inline constexpr uint16_t energyCounters[2] = { RENOGY_TODAY_POWER, RENOGY_TODAY_AMP_HOURS };
+
+	/** What getRegister() returns.  The store itself is structure-of-arrays: addresses live once, in flash, in
+	 * registerIndex; each device holds just a uint16_t per register plus a timestamp per frame run
+	 */
 	struct REGISTER_VALUE {
 		uint16_t registerAddress;
 		uint16_t value;
-		uint32_t lastUpdateMillis = 0;
+		uint32_t lastUpdateMillis;
+	};
+
+	struct FRAME_RUN {
+		uint16_t startRegister;
+		uint16_t numberOfRegisters;											// 0 if the slot is unused
+		uint32_t updateMillis;
+	};
+
+	/** Upper bounds of the round trip histogram buckets in ms; the last bucket takes everything slower */
+	constexpr uint32_t BT2_RTT_BUCKET_MILLIS[BT2_RTT_BUCKETS - 1] = { 50, 75, 100, 150, 200, 400, 1000 };
+
+	/** Link health counters for one device, kept in DEVICE and copied out by getStats().  Cumulative since
+	 * begin() or resetStats()
+	 */
+	struct BT2_STATS {
+		uint32_t commandsSent;
+		uint32_t framesCompleted;											// good checksum, including exceptions
+		uint32_t roundTripHistogram[BT2_RTT_BUCKETS];						// command sent to complete frame
+		uint32_t roundTripMinMillis;
+		uint32_t roundTripMaxMillis;
+		uint32_t roundTripTotalMillis;
+		uint32_t notifications;
+		uint32_t frameNotifications;										// notifications that made up completed frames
+		uint32_t notificationGaps;											// between notifications of the same response
+		uint32_t notificationGapTotalMicros;
+		uint32_t notificationGapMaxMicros;
+		uint32_t checksumErrors;
+		uint32_t exceptions;
+		uint32_t overruns;													// notifications arriving after the frame was complete
+		uint32_t timeouts;
+		uint32_t framesDropped;												// frameRing full; loop() isn't calling service()
+		uint32_t connections;
+		uint32_t reconnects;												// connections after the first
+		uint32_t connectToReadyMillis;										// last connection
+		uint32_t connectToReadyMaxMillis;
+	};
+
+	/** A power or current register integrated over time (BT2Energy.cpp).  sum is twice the trapezoid total, in raw
+	 * register units times milliseconds, so each step is exact integer arithmetic
+	 */
+	struct ENERGY_INTEGRAL {
+		uint64_t sum;
+		uint32_t lastMillis;
+		uint16_t lastValue;
+		boolean sampled;													// lastValue and lastMillis hold a reading
+	};
+
+	/** Energy state of one device, kept in DEVICE.  integrals[] holds the power then the current of each
+	 * BT2_ENERGY_SOURCES entry; the counter fields are for RENOGY_TODAY_POWER, then RENOGY_TODAY_AMP_HOURS
+	 */
+	struct ENERGY_STATE {
+		ENERGY_INTEGRAL integrals[BT2_ENERGY_SOURCES * 2];
+		uint64_t counterBaseMilli[2];										// integrated mWh, mAh at the baseline
+		uint16_t counterBase[2];											// counter value at the baseline
+		uint16_t counterLast[2];
+		boolean counterValid[2];
+		uint32_t gaps;
+	};
+
+	/** What getEnergy() copies out.  Totals are since beginEnergy() or resetEnergy().  Drift is what all sources
+	 * integrated to minus what the controller's daily counter grew by, since it was first read or went back to
+	 * zero for a new day; the counters count whole Wh and Ah at the battery, so expect a unit of jitter, plus the
+	 * converter's losses in Wh and the voltage ratio in Ah
+	 */
+	struct BT2_ENERGY {
+		uint32_t milliwattHours[BT2_ENERGY_SOURCES];
+		uint32_t milliampHours[BT2_ENERGY_SOURCES];
+		boolean hasDailyCounters;											// both counters read, drift is meaningful
+		int32_t driftMilliwattHours;
+		int32_t driftMilliampHours;
+		uint32_t gaps;														// intervals skipped, longer than the maximum gap
+	};
+
+	/** A frame with a good checksum, handed from notifyCallback to loop() through DEVICE::frameRing */
+	struct BT2_FRAME {
+		uint16_t startRegister;
+		uint8_t numberOfRegisters;
+		uint32_t receivedMillis;											// stamped by pushFrame, so a late drain doesn't move it
+		uint8_t data[MAXIMUM_REGISTERS_PER_READ * 2];						// register values as received, MSB first
+	};
+
+	struct BT2_REQUEST;
+	typedef void (*BT2RequestCallback)(int deviceIndex, const BT2_REQUEST * request);
+
+	struct BT2_REQUEST {
+		int id;
+		uint16_t startRegister;
+		uint16_t numberOfRegisters;
+		uint8_t status;
+		uint32_t timeoutMillis;
+		uint32_t sentMillis;
+		BT2RequestCallback callback;
+	};
+
+	/** A named bit of a RENOGY_BIT_FLAGS register, or a RENOGY_OPTIONS value, that came or went (BT2Alarms.cpp).
+	 * id is the bit number, or the option value; name is from the device's profile, NULL for an unnamed option
+	 */
+	struct BT2_ALARM_EVENT {
+		uint32_t millis;
+		const char * name;
+		uint16_t registerAddress;
+		uint16_t id;
+		uint8_t deviceIndex;
+		boolean raised;														// false: cleared
+	};
+
+	typedef void (*BT2AlarmCallback)(const BT2_ALARM_EVENT * event);
+
+	constexpr int REGISTER_MASK_WORDS = (MAXIMUM_PROFILE_DESCRIPTIONS + 31) / 32;
+
+	typedef void (*BT2ChangeCallback)(int deviceIndex, uint16_t registerAddress);
+
+	/** Change subscriptions for one device, indexed by its profile's description entries.  Only allocated once
+	 * something on the device is subscribed to
+	 */
+	struct REGISTER_SUBSCRIPTIONS {
+		uint32_t subscribed[REGISTER_MASK_WORDS];
+		uint32_t reported[REGISTER_MASK_WORDS];								// reportedValues[] holds something
+		uint32_t changed[REGISTER_MASK_WORDS];								// moved by at least the deadband, not yet consumed
+		uint32_t withCallback[REGISTER_MASK_WORDS];
+		uint32_t reportedValues[MAXIMUM_PROFILE_DESCRIPTIONS];
+		uint16_t deadbands[MAXIMUM_PROFILE_DESCRIPTIONS];					// raw register units
+		uint8_t callbacks[MAXIMUM_PROFILE_DESCRIPTIONS];					// index into BT2Reader::changeCallbacks
+	};
+
+	/** A BLEClientService that can be bound to a connection from cached attribute handles, skipping discovery
+	 */
+	class BT2ClientService : public BLEClientService {
+
+	public:
+
+		BT2ClientService(BLEUuid bleuuid) : BLEClientService(bleuuid) {}
+		void bind(uint16_t connectionHandle) { _conn_hdl = connectionHandle; }
+	};
+
+	/** What scanCallback needs from an advertising report, from one pass over its AD structures (BT2Scan.cpp) */
+	struct BT2_ADVERTISEMENT {
+		boolean hasBT2Service;
+		boolean hasManufacturerId;
+		uint16_t manufacturerId;
+		uint8_t localNameLength;
+		char localName[20];
+	};
+
+	/** An advertiser scanCallback has no use for, by address hash (BT2Scan.cpp) */
+	struct SCAN_REJECT {
+		uint32_t addressHash;
+		uint32_t expiresMillis;												// 0 if the entry is empty
+	};
+
+	/** Output of the formatter (BT2Format.cpp).  length is what's in data; total counts everything formatted, so
+	 * total >= size means it was cut short.  With toSerial set, a full buffer is written to Serial and reused
+	 */
+	struct BT2_FORMAT_BUFFER {
+		char * data;
+		int size;
+		int length;
+		int total;
+		boolean toSerial;
+	};
+
+	/** Attribute handles discovered on a BT2, remembered by peer address (BT2GattCache.cpp) */
+	struct GATT_HANDLES {
+		uint8_t peerAddress[6];												// all zero if the slot is unused
+		ble_gattc_char_t txCharacteristic;
+		ble_gattc_char_t rxCharacteristic;
+		uint32_t lastUsedMillis;
 	};
 
 	struct DEVICE {
@@ -247,16 +1050,64 @@ const RENOGY_OPTIONS_TABLE renogyOptions[] {
 
 		uint8_t dataReceived[DEFAULT_DATA_BUFFER_LENGTH];
 		int dataReceivedLength = 0;
-		boolean dataError = false;
+		uint8_t parserState = BT2_PARSER_WAIT_START;
+		uint16_t runningChecksum = 0xFFFF;									// Modbus CRC of dataReceived[0 .. checksumLength - 1]
+		int checksumLength = 0;
 		int registerExpected;
+		int registersRequested = 0;
 		boolean newDataAvailable;
+		volatile uint8_t frameStatus = BT2_FRAME_PENDING;					// set by notifyCallback, consumed by service()
+		BT2_FRAME frameRing[BT2_FRAME_RING_LENGTH];							// single producer (notifyCallback), single consumer (loop)
+		uint8_t frameRingHead = 0;											// free running; written only by the consumer
+		uint8_t frameRingTail = 0;											// free running; written only by the producer
+
+		BT2_REQUEST requestQueue[BT2_REQUEST_QUEUE_LENGTH];
+		int requestQueueHead = 0;
+		int requestQueueCount = 0;
+		int lastRequestId = 0;
+		uint8_t lastRequestStatus = BT2_REQUEST_UNKNOWN;
+
+		BT2ReadPlan * readPlan = NULL;										// polled continuously by service() when set
+		int readPlanCommand = 0;
+		uint32_t framesCompleted = 0;
+		uint32_t throughputWindowFrames = 0;
+		uint32_t throughputWindowStartMillis = 0;
+		float framesPerSecond = 0;
+
+		BT2PollSchedule * pollSchedule = NULL;								// takes over from readPlan when set
+		POLL_GROUP_STATE pollGroups[MAXIMUM_POLL_GROUPS];
+		int pollGroup = 0;													// group of the poll in flight
+		int pollRequestId = 0;
+
+		const BT2_REGISTER_PROFILE * profile = &BT2_REGISTER_MAP_DCC::profile;	// the register map this device is read with
+		uint8_t profileDetection = BT2_PROFILE_DETECTION_OFF;
+		uint8_t profileDetectionAttempts = 0;
+		int profileDetectionRequestId = 0;
+		uint16_t * registerValues = NULL;									// profile->valueSize slots, indexed by REGISTER_INDEX_ENTRY::valueIndex
+		char productModel[17];												// decoded lazily by getProductModel()
+		boolean productModelDecoded = false;
+		FRAME_RUN frameRuns[MAXIMUM_FRAME_RUNS];
+		REGISTER_SUBSCRIPTIONS * subscriptions = NULL;
+		boolean identityFromCache = false;									// identity registers loaded from the cache, not yet re-read
+		boolean identityCacheDirty = false;									// a read touched them; service() saves them
+		uint16_t identityCacheChecksum = 0;									// CRC of the file as last loaded or saved
+
+		uint32_t connectedMillis = 0;
+		uint32_t connectToReadyMillis = 0;									// connection up to first good frame, including discovery
+		boolean ready = false;
+		boolean gattFromCache = false;										// bound from gattHandles, not yet proven by a response
 
-		REGISTER_VALUE * registerValues;
+		BT2_STATS stats;
+		ENERGY_STATE energy;
+		uint32_t alarmBaseline[REGISTER_MASK_WORDS];						// per description: read with alarms on, so the next read is an edge
+		uint32_t commandSentMillis = 0;
+		uint32_t lastNotificationMicros = 0;
+		uint16_t responseNotifications = 0;									// since the last command was sent
 
-		BLEClientService txService = BLEClientService("0000ffD0-0000-1000-8000-00805f9b34fb");				// Renogy service
+		BT2ClientService txService = BT2ClientService("0000ffD0-0000-1000-8000-00805f9b34fb");				// Renogy service
 		BLEClientCharacteristic txCharacteristic = BLEClientCharacteristic("0000ffD1-0000-1000-8000-00805f9b34fb");		// Renogy Tx and Rx service
 
-		BLEClientService rxService = BLEClientService("0000ffF0-0000-1000-8000-00805f9b34fb");				// Renogy service
+		BT2ClientService rxService = BT2ClientService("0000ffF0-0000-1000-8000-00805f9b34fb");				// Renogy service
 		BLEClientCharacteristic rxCharacteristic = BLEClientCharacteristic("0000ffF1-0000-1000-8000-00805f9b34fb");		// Renogy Tx and Rx service
 	};
 
@@ -289,16 +1140,23 @@ public:
 	DEVICE * getDevice(uint16_t connectionHandle);
 	DEVICE * getDevice(int index);
 	
-	REGISTER_VALUE * getRegister(char * name, uint16_t registerAddress);
-	REGISTER_VALUE * getRegister(uint8_t * address, uint16_t registerAddress);
-	REGISTER_VALUE * getRegister(uint16_t connectionHandle, uint16_t registerAddress);
-	REGISTER_VALUE * getRegister(int deviceIndex, uint16_t registerAddress);
-	//REGISTER_VALUE * getRegister(DEVICE * device, uint16_t registerAddress);
+	REGISTER_VALUE getRegister(char * name, uint16_t registerAddress);
+	REGISTER_VALUE getRegister(uint8_t * address, uint16_t registerAddress);
+	REGISTER_VALUE getRegister(uint16_t connectionHandle, uint16_t registerAddress);
+	REGISTER_VALUE getRegister(int deviceIndex, uint16_t registerAddress);
+
+	uint16_t getRegisterValue(char * name, uint16_t registerAddress);
+	uint16_t getRegisterValue(uint8_t * address, uint16_t registerAddress);
+	uint16_t getRegisterValue(uint16_t connectionHandle, uint16_t registerAddress);
+	uint16_t getRegisterValue(int deviceIndex, uint16_t registerAddress);
 	
 	int printRegister(char * name, uint16_t registerAddress);
 	int printRegister(uint8_t * device, uint16_t registerAddress);
 	int printRegister(uint16_t connectionHandle, uint16_t registerAddress);
 	int printRegister(DEVICE * device, uint16_t registerAddress);
+	void printDevice(int index, uint8_t mode = BT2_FORMAT_TEXT);
+	int formatDevice(int index, char * buffer, int size, uint8_t mode = BT2_FORMAT_TEXT);
+	int formatDevices(char * buffer, int size, uint8_t mode = BT2_FORMAT_TEXT);
 
 	void printHex(uint8_t * data, int datalen);
 	void printHex(uint8_t * data, int datalen, boolean reverse);
@@ -314,9 +1172,84 @@ public:
 	boolean getIsNewDataAvailable(uint16_t connectionHandle);
 	boolean getIsNewDataAvailable(int index);
 
+	int32_t getScaledValue(int index, uint16_t registerAddress);
+	int64_t getRawValue(int index, uint16_t registerAddress);
+	int32_t getMillivolts(int index, uint16_t registerAddress);
+	int32_t getMilliamps(int index, uint16_t registerAddress);
+	int32_t getWatts(int index, uint16_t registerAddress);
+	float getRegisterAsFloat(int index, uint16_t registerAddress);
+	boolean getTemperatures(int index, int8_t * auxBatteryCelsius, int8_t * controllerCelsius);
+	const char * getProductModel(int index);
+
+	/** getScaledValue for a register known at compile time; the slot and scale are resolved by the compiler.  A
+	 * device bound to a different profile falls back to the runtime lookup
+	 */
+	template <uint16_t REGISTER_ADDRESS, typename REGISTER_MAP = BT2_REGISTER_MAP_DCC> int32_t getScaledValue(int index) {
+		constexpr int valueIndex = REGISTER_MAP::findValueIndex(REGISTER_ADDRESS);
+		constexpr int descriptionIndex = REGISTER_MAP::findDescriptionIndex(REGISTER_ADDRESS);
+		static_assert(valueIndex >= 0 && descriptionIndex >= 0, "register is not in REGISTER_MAP");
+		constexpr REGISTER_DESCRIPTION description = REGISTER_MAP::descriptions[descriptionIndex];
+		if (index < 0 || index >= deviceTableSize) { return 0; }
+		if (deviceTable[index].profile != &REGISTER_MAP::profile) { return getScaledValue(index, REGISTER_ADDRESS); }
+		drainFrames(&deviceTable[index]);
+		return (getSaturatedMilli(getRawValue(description, &deviceTable[index].registerValues[valueIndex]) * getRegisterMilliScale(description)));
+	}
+
+	int queueReadCommand(uint8_t * address, uint16_t startRegister, uint16_t numberOfRegisters, BT2RequestCallback callback = NULL, uint32_t timeoutMillis = DEFAULT_REQUEST_TIMEOUT);
+	int queueReadCommand(char * name, uint16_t startRegister, uint16_t numberOfRegisters, BT2RequestCallback callback = NULL, uint32_t timeoutMillis = DEFAULT_REQUEST_TIMEOUT);
+	int queueReadCommand(uint16_t handle, uint16_t startRegister, uint16_t numberOfRegisters, BT2RequestCallback callback = NULL, uint32_t timeoutMillis = DEFAULT_REQUEST_TIMEOUT);
+	int queueReadCommand(int index, uint16_t startRegister, uint16_t numberOfRegisters, BT2RequestCallback callback = NULL, uint32_t timeoutMillis = DEFAULT_REQUEST_TIMEOUT);
+	int getQueuedRequestCount(int index);
+	uint8_t getRequestStatus(int requestId);
+	void service();
+
+	boolean setRegisterProfile(const BT2_REGISTER_PROFILE * profile);
+	boolean setRegisterProfile(int index, const BT2_REGISTER_PROFILE * profile);
+	const BT2_REGISTER_PROFILE * getRegisterProfile(int index);
+	void beginProfileDetection(const BT2_MODEL_PROFILE * models = knownModelProfiles, int modelCount = getTableSize(knownModelProfiles));
+	boolean getIsProfileDetected(int index);
+
+	void setReadPlan(BT2ReadPlan * plan);
+	void setReadPlan(int index, BT2ReadPlan * plan);
+	void setPollCallback(BT2RequestCallback callback);
+	float getFramesPerSecond(int index);
+	uint32_t getFramesCompleted(int index);
+	void setPollSchedule(BT2PollSchedule * schedule);
+	void setPollSchedule(int index, BT2PollSchedule * schedule);
+	uint32_t getPollPeriod(int index, int group);
+
+	boolean beginIdentityCache();
+	boolean getIsIdentityFromCache(int index);
+	void clearIdentityCache(int index);
+
+	uint32_t getConnectToReadyMillis(int index);
+	boolean getStats(int index, BT2_STATS * stats);
+	void resetStats(int index);
+	void printStats(int index);
+	boolean getIsGattFromCache(int index);
+
+	boolean addHistory(int index, uint16_t registerAddress, BT2RegisterHistory * history);
+	BT2RegisterHistory * getHistory(int index, uint16_t registerAddress);
+
+	boolean subscribe(int index, uint16_t registerAddress, int32_t deadband = 0, BT2ChangeCallback callback = NULL);
+	boolean unsubscribe(int index, uint16_t registerAddress);
+	boolean getIsRegisterChanged(int index, uint16_t registerAddress);
+	int getNextChangedRegister(int index);
+
+	int encodeSnapshot(uint8_t * buffer, int size, BT2SnapshotEncoder * encoder = NULL);
+
+	void beginAlarms(BT2AlarmCallback callback = NULL);
+	boolean getNextAlarmEvent(BT2_ALARM_EVENT * event);
+	uint32_t getAlarmEventsDropped();
+
+	void beginEnergy(uint32_t maximumGapMillis = BT2_ENERGY_MAX_GAP_MILLIS);
+	boolean getEnergy(int index, BT2_ENERGY * energy);
+	void resetEnergy(int index);
+	void printEnergy(int index);
+
 	void setLoggingLevel(int i);
 
-private:
+protected:
 
 	const uint16_t BT2_TX_SERVICE = 0xFFD0;
 	const uint16_t BT2_MANUFACTURER_ID = 0x7DE0;
@@ -327,34 +1260,163 @@ private:
 	const uint8_t BLANK_MACID[6] = {0,0,0,0,0,0};									//useful to check whether a BT2 Device slot has a valid peer Mac Address or not
 	const char * LOGGING_LEVEL_TEXT[3] = { "QUIET", "ERROR", "VERBOSE"};
 
-	REGISTER_VALUE invalidRegister;
 	static BT2Reader * _pointerToBT2ReaderClass;
 	int numberOfConnections = 0;
+	int nextRequestId = 1;
+	BT2RequestCallback pollCallback = NULL;
+	BT2RegisterHistory * histories[MAXIMUM_HISTORIES];
+	int historyCount = 0;
+	BT2ChangeCallback changeCallbacks[MAXIMUM_CHANGE_CALLBACKS];
+	int changeCallbackCount = 0;
+	boolean identityCacheEnabled = false;
+	boolean alarmsEnabled = false;
+	BT2AlarmCallback alarmCallback = NULL;
+	BT2_ALARM_EVENT alarmEvents[BT2_ALARM_QUEUE_LENGTH];
+	uint8_t alarmEventHead = 0;												// free running, like DEVICE::frameRing
+	uint8_t alarmEventTail = 0;
+	uint32_t alarmEventsDropped = 0;
+	boolean energyEnabled = false;
+	uint32_t energyMaximumGapMillis = BT2_ENERGY_MAX_GAP_MILLIS;
+	const BT2_MODEL_PROFILE * modelProfiles = NULL;							// set by beginProfileDetection()
+	int modelProfileCount = 0;
+	GATT_HANDLES gattHandles[MAXIMUM_BT2_DEVICES];
+	int8_t addressIndex[ADDRESS_INDEX_SIZE];								// deviceTable slot by peer address hash, -1 if empty
+	SCAN_REJECT scanRejects[SCAN_REJECT_CACHE_SIZE];
+	uint32_t scanRejectsAgedMillis = 0;
 	
-	DEVICE * deviceTable;
+	DEVICE * deviceTable = NULL;
+	int deviceTableCapacity = 0;											// > 0 if the storage was supplied by StaticBT2Reader
+	uint16_t * registerValueStorage = NULL;
+	REGISTER_SUBSCRIPTIONS * subscriptionStorage = NULL;
 	int deviceTableSize = 0;
-	int registerDescriptionSize = 0;
-	int registerValueSize = 0;
+	int registerValueCapacity = 0;											// value slots per device in StaticBT2Reader storage
 	int loggingLevel = BT2READER_QUIET;
 
-	boolean appendRenogyPacket(DEVICE * device, uint8_t * data, int dataLen);
+	void setStorage(DEVICE * devices, int capacity, uint16_t * registerValues, int valueSize, REGISTER_SUBSCRIPTIONS * subscriptions, const BT2_REGISTER_PROFILE * profile);
+	void initializeDeviceTable();
+	void appendRenogyPacket(DEVICE * device, uint8_t * data, int dataLen, boolean rescanning = false);
+	boolean getIsFrameLengthValid(DEVICE * device, uint8_t length);
+	void completeFrame(DEVICE * device, boolean rescanning);
 	uint16_t getProvidedModbusChecksum(uint8_t * data);
 	uint16_t getCalculatedModbusChecksum(uint8_t * data);
 	uint16_t getCalculatedModbusChecksum(uint8_t * data, int start, int end);
+	uint16_t updateModbusChecksum(uint16_t crc, const uint8_t * data, int len);
 	boolean getIsReceivedDataValid(uint8_t * data);
+	boolean getIsReceivedDataValid(DEVICE * device);
 	int getExpectedLength(uint8_t * data);
-	void processDataReceived(DEVICE * device);
+	void processDataReceived(DEVICE * device, const BT2_FRAME * frame);
+	void pushFrame(DEVICE * device);
+	void drainFrames(DEVICE * device);
+	void recordFrameRun(DEVICE * device, uint16_t startRegister, uint16_t numberOfRegisters, uint32_t updateMillis);
+	uint32_t getRegisterUpdateMillis(DEVICE * device, uint16_t registerAddress);
+	boolean getIsRegisterReceived(DEVICE * device, uint16_t registerAddress);
+	int32_t getScaledValue(int index, uint16_t registerAddress, uint8_t type);
+	void serviceDevice(int index);
+	void completeRequest(int index, uint8_t status);
+	boolean queueNextReadPlanCommand(int index);
+	void updateThroughput(DEVICE * device);
+	boolean queueProfileDetection(int index);
+	void completeProfileDetection(int index, uint8_t status);
+	void bindDetectedProfile(int index);
+	void resetPollGroups(DEVICE * device);
+	boolean queueNextPollGroup(int index);
+	void completePollGroup(int index, uint8_t status);
+	boolean getIsIdentityRange(uint16_t startRegister, uint16_t numberOfRegisters);
+	void getIdentityCachePath(DEVICE * device, char * path, int size);
+	int buildIdentityCache(DEVICE * device, uint8_t * buffer);
+	boolean loadIdentityCache(DEVICE * device);
+	void saveIdentityCache(int index);
+	boolean discoverGatt(DEVICE * device, uint16_t connectionHandle);
+	boolean bindCachedGatt(DEVICE * device, uint16_t connectionHandle);
+	GATT_HANDLES * getGattHandles(uint8_t * peerAddress);
+	void rememberGattHandles(DEVICE * device);
+	void forgetGattHandles(uint8_t * peerAddress);
+	void markDeviceReady(DEVICE * device);
+	void recordNotification(DEVICE * device);
+	void recordFrameStats(DEVICE * device, boolean exception);
+	void rejectCachedGatt(DEVICE * device);
+	void parseAdvertisement(const ble_gap_evt_adv_report_t * report, BT2_ADVERTISEMENT * advertisement);
+	uint32_t getAddressHash(const uint8_t * peerAddress);
+	void rebuildAddressIndex();
+	boolean getIsScanRejected(uint32_t addressHash);
+	void rejectScanAddress(uint32_t addressHash);
+	void clearScanRejects();
+	void ageScanRejects();
+	boolean getHasOpenSlot();
+	int findAddressIndex(const uint8_t * peerAddress);
+	int findAddressIndex(const uint8_t * peerAddress, uint32_t addressHash);
+	void appendHistories(DEVICE * device, uint16_t startRegister, int numberOfRegisters, uint32_t sampleMillis);
+	void updateSubscriptions(DEVICE * device, uint16_t startRegister, int numberOfRegisters);
+	uint32_t getSubscriptionValue(DEVICE * device, int descriptionIndex);
+	void remapSubscriptions(DEVICE * device, const BT2_REGISTER_PROFILE * previousProfile);
+	void dispatchChanges(int index);
+	void queueAlarmEvents(DEVICE * device, int descriptionIndex, uint16_t previousValue, uint16_t value, boolean firstRead, uint32_t eventMillis);
+	void pushAlarmEvent(DEVICE * device, uint16_t registerAddress, uint16_t id, const char * name, boolean raised, uint32_t eventMillis);
+	void dispatchAlarms();
+	void updateEnergy(DEVICE * device, uint16_t startRegister, int numberOfRegisters, uint32_t sampleMillis);
+	void integrateEnergy(DEVICE * device, ENERGY_INTEGRAL * integral, uint16_t value, uint32_t sampleMillis);
+	void updateEnergyCounter(DEVICE * device, int counter, uint16_t value);
+	uint64_t getEnergyMilli(DEVICE * device, int source, int quantity);
+	uint64_t getEnergyTotalMilli(DEVICE * device, int quantity);
+	boolean getIsEnergySource(DEVICE * device, int source);
+	static int putSnapshotByte(uint8_t * buffer, int size, int length, uint8_t value);
+	static int putSnapshotVarint(uint8_t * buffer, int size, int length, uint32_t value);
+	void formatDevice(int index, BT2_FORMAT_BUFFER * out, uint8_t mode);
+	void formatRegister(DEVICE * device, int descriptionIndex, BT2_FORMAT_BUFFER * out, uint8_t mode);
+	static const char * getOptionName(const BT2_REGISTER_PROFILE * profile, int descriptionIndex, uint16_t value);
+	static void putFormatText(BT2_FORMAT_BUFFER * out, const char * text, int length);
+	static void putFormatText(BT2_FORMAT_BUFFER * out, const char * text);
+	static void putFormatChar(BT2_FORMAT_BUFFER * out, char c, int count = 1);
+	static void putFormatNumber(BT2_FORMAT_BUFFER * out, int64_t value, int width = 0, int decimals = 0);
+	static int64_t getRoundedMilli(int64_t milli, int decimals);
+	static void putFormatHex(BT2_FORMAT_BUFFER * out, uint32_t value, int digits);
+	static void putFormatJsonString(BT2_FORMAT_BUFFER * out, const char * text, int length);
+	static void flushFormat(BT2_FORMAT_BUFFER * out);
 
-	int getRegisterDescriptionIndex(uint16_t registerAddress);
+	const REGISTER_INDEX_SEGMENT * getRegisterIndexSegment(DEVICE * device, uint16_t registerAddress);
+	const REGISTER_INDEX_ENTRY * getRegisterIndexEntry(DEVICE * device, uint16_t registerAddress);
+	int getRegisterDescriptionIndex(DEVICE * device, uint16_t registerAddress);
 	int getRegisterValueIndex(DEVICE * device, uint16_t registerAddress);
+	static int64_t getRawValue(const REGISTER_DESCRIPTION & description, const uint16_t * values);
 
 	void log(const char * fsh, ...);
 	void logprintf(const char * fsh, ...);
 	void logerror(const char * fsh, ...);
-	void logstub(const char * fsh, va_list * args);
+	void logstub(const char * prefix, const char * fsh, va_list * args);
+
+};
+
+
+/** A BT2Reader whose device table, register values and subscriptions are members sized at compile time, so a
+ * global instance lands in .bss, the linker map shows its exact RAM use, and begin() allocates nothing:
+ *
+ *		StaticBT2Reader<2> bt2Reader;										// instead of BT2Reader bt2Reader;
+ *
+ * Everything else is the BT2Reader API.  setDeviceTableSize() may use fewer than MAX_DEVICES slots.  Every slot
+ * starts out bound to REGISTER_MAP, with VALUE_SLOTS values: by default room for the largest built in profile, so
+ * setRegisterProfile() and profile detection can bind any of them.  A reader that will only ever see one kind of
+ * device can be trimmed to it, StaticBT2Reader<1, BT2_REGISTER_MAP_SMART_BATTERY,
+ * BT2_REGISTER_MAP_SMART_BATTERY::valueSize> holds a battery's values and nothing else, and then refuses a profile
+ * with more value slots than that
+ */
+template <int MAX_DEVICES, typename REGISTER_MAP = BT2_REGISTER_MAP_DCC, int VALUE_SLOTS = MAXIMUM_PROFILE_VALUES>
+class StaticBT2Reader : public BT2Reader {
+
+	static_assert(MAX_DEVICES >= 1 && MAX_DEVICES <= MAXIMUM_BT2_DEVICES, "MAX_DEVICES must be 1 to MAXIMUM_BT2_DEVICES");
+	static_assert(REGISTER_MAP::descriptionSize <= MAXIMUM_PROFILE_DESCRIPTIONS, "REGISTER_MAP has more descriptions than REGISTER_SUBSCRIPTIONS holds");
+	static_assert(VALUE_SLOTS >= REGISTER_MAP::valueSize, "VALUE_SLOTS can't hold REGISTER_MAP's values");
+
+public:
+
+	StaticBT2Reader() { setStorage(devices, MAX_DEVICES, &values[0][0], VALUE_SLOTS, subscriptionStore, &REGISTER_MAP::profile); }
+
+private:
 
+	DEVICE devices[MAX_DEVICES];
+	uint16_t values[MAX_DEVICES][VALUE_SLOTS];
+	REGISTER_SUBSCRIPTIONS subscriptionStore[MAX_DEVICES];
 };
 
 
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,194 @@
+#include "BT2Reader.h"
+
+/** Non-blocking reads.  queueReadCommand() adds a read to a device's queue and returns straight away with a
+ * request id; service(), called from loop(), sends the next queued read as soon as the previous one completes,
+ * fails it after its timeout, and runs the request's callback (in loop() context, not the BLE task) with the
+ * outcome.  getRequestStatus() can be polled instead of using a callback.
+ *
+ * Each device has its own queue and service() advances them all independently, so every connected BT2 can have a
+ * read in flight at the same time.  setReadPlan() makes this continuous: whenever a device's queue is empty,
+ * service() queues the next command of its read plan, round robin, so N devices refresh in about the time of one.
+ * setPollSchedule() does the same with per group, adaptive rates instead of round robin (see BT2PollSchedule.h).
+ */
+
+int BT2Reader::queueReadCommand(char * name, uint16_t startRegister, uint16_t numberOfRegisters, BT2RequestCallback callback, uint32_t timeoutMillis) { 
+	return (queueReadCommand(getDeviceIndex(name), startRegister, numberOfRegisters, callback, timeoutMillis)); 
+}
+int BT2Reader::queueReadCommand(uint8_t * address, uint16_t startRegister, uint16_t numberOfRegisters, BT2RequestCallback callback, uint32_t timeoutMillis) { 
+	return (queueReadCommand(getDeviceIndex(address), startRegister, numberOfRegisters, callback, timeoutMillis)); 
+}
+int BT2Reader::queueReadCommand(uint16_t handle, uint16_t startRegister, uint16_t numberOfRegisters, BT2RequestCallback callback, uint32_t timeoutMillis) { 
+	return (queueReadCommand(getDeviceIndex(handle), startRegister, numberOfRegisters, callback, timeoutMillis)); 
+}
+
+/** Returns the request id, or -1 if the device isn't connected, its queue is full, or numberOfRegisters isn't
+ * 1 to MAXIMUM_REGISTERS_PER_READ
+ */
+int BT2Reader::queueReadCommand(int index, uint16_t startRegister, uint16_t numberOfRegisters, BT2RequestCallback callback, uint32_t timeoutMillis) {
+	if (index < 0 || index >= deviceTableSize || deviceTable[index].handle == BLE_CONN_HANDLE_INVALID) {
+		logerror("queueReadCommand: device not connected\n");
+		return -1;
+	}
+	if (numberOfRegisters == 0 || numberOfRegisters > MAXIMUM_REGISTERS_PER_READ) {
+		logerror("queueReadCommand: %d registers, must be 1 to %d\n", numberOfRegisters, MAXIMUM_REGISTERS_PER_READ);
+		return -1;
+	}
+	DEVICE * device = &deviceTable[index];
+	if (device->requestQueueCount == BT2_REQUEST_QUEUE_LENGTH) {
+		logerror("queueReadCommand: request queue full for %s\n", device->peerName);
+		return -1;
+	}
+
+	BT2_REQUEST * request = &device->requestQueue[(device->requestQueueHead + device->requestQueueCount) % BT2_REQUEST_QUEUE_LENGTH];
+	request->id = nextRequestId;
+	request->startRegister = startRegister;
+	request->numberOfRegisters = numberOfRegisters;
+	request->status = BT2_REQUEST_QUEUED;
+	request->timeoutMillis = timeoutMillis;
+	request->sentMillis = 0;
+	request->callback = callback;
+	device->requestQueueCount++;
+
+	nextRequestId = (nextRequestId == 0x7FFFFFFF ? 1 : nextRequestId + 1);
+	return (request->id);
+}
+
+int BT2Reader::getQueuedRequestCount(int index) {
+	if (index < 0 || index >= deviceTableSize) { return 0; }
+	return (deviceTable[index].requestQueueCount);
+}
+
+/** Returns BT2_REQUEST_QUEUED or BT2_REQUEST_SENT while a request is outstanding, its outcome once it's the most
+ * recently completed request on its device, and BT2_REQUEST_UNKNOWN after that
+ */
+uint8_t BT2Reader::getRequestStatus(int requestId) {
+	for (int i = 0; i < deviceTableSize; i++) {
+		DEVICE * device = &deviceTable[i];
+		if (device->lastRequestId == requestId) { return device->lastRequestStatus; }
+		for (int j = 0; j < device->requestQueueCount; j++) {
+			BT2_REQUEST * request = &device->requestQueue[(device->requestQueueHead + j) % BT2_REQUEST_QUEUE_LENGTH];
+			if (request->id == requestId) { return request->status; }
+		}
+	}
+	return BT2_REQUEST_UNKNOWN;
+}
+
+/** Call as often as possible from loop().  Never blocks
+ */
+void BT2Reader::service() {
+	for (int i = 0; i < deviceTableSize; i++) {
+		serviceDevice(i);
+		dispatchChanges(i);
+		if (deviceTable[i].identityCacheDirty) { saveIdentityCache(i); }
+	}
+	if (alarmCallback != NULL) { dispatchAlarms(); }
+	ageScanRejects();
+}
+
+void BT2Reader::serviceDevice(int index) {
+	DEVICE * device = &deviceTable[index];
+	updateThroughput(device);
+	drainFrames(device);
+
+	while (device->requestQueueCount > 0 || queueNextReadPlanCommand(index)) {
+		BT2_REQUEST * request = &device->requestQueue[device->requestQueueHead];
+
+		if (device->handle == BLE_CONN_HANDLE_INVALID) {
+			completeRequest(index, BT2_REQUEST_DISCONNECTED);
+			continue;
+		}
+
+		if (request->status == BT2_REQUEST_QUEUED) {
+			sendReadCommand(index, request->startRegister, request->numberOfRegisters);
+			request->status = BT2_REQUEST_SENT;
+			request->sentMillis = millis();
+			return;
+		}
+
+		switch (__atomic_load_n(&device->frameStatus, __ATOMIC_ACQUIRE)) {
+			case BT2_FRAME_COMPLETE: completeRequest(index, BT2_REQUEST_COMPLETE); break;		// and send the next one straight away
+			case BT2_FRAME_CHECKSUM_ERROR: completeRequest(index, BT2_REQUEST_CHECKSUM_ERROR); break;
+			case BT2_FRAME_EXCEPTION: completeRequest(index, BT2_REQUEST_FRAME_ERROR); break;
+			default:
+				if (millis() - request->sentMillis < request->timeoutMillis) { return; }
+				logerror("Timeout waiting for registers 0x%04X - 0x%04X from %s\n", 
+					request->startRegister, request->startRegister + request->numberOfRegisters - 1, device->peerName);
+				completeRequest(index, BT2_REQUEST_TIMEOUT);
+				break;
+		}
+	}
+}
+
+/** Queues the next command of the device's read plan, round robin, once profile detection has had its read.
+ * Returns false if there's nothing to poll
+ */
+boolean BT2Reader::queueNextReadPlanCommand(int index) {
+	DEVICE * device = &deviceTable[index];
+	if (device->profileDetection == BT2_PROFILE_DETECTION_PENDING && device->handle != BLE_CONN_HANDLE_INVALID && queueProfileDetection(index)) { return true; }
+	if (device->pollSchedule != NULL && device->handle != BLE_CONN_HANDLE_INVALID) { return queueNextPollGroup(index); }
+	if (device->readPlan == NULL || device->readPlan->getCommandCount() == 0 || device->handle == BLE_CONN_HANDLE_INVALID) { return false; }
+	device->readPlanCommand %= device->readPlan->getCommandCount();
+	const RENOGY_COMMANDS * command = device->readPlan->getCommand(device->readPlanCommand++);
+	return (queueReadCommand(index, command->startRegister, command->numberOfRegisters, pollCallback) > 0);
+}
+
+/** Pops the request at the head of the device's queue and runs its callback
+ */
+void BT2Reader::completeRequest(int index, uint8_t status) {
+	DEVICE * device = &deviceTable[index];
+	drainFrames(device);														// the frame that completed it may have arrived since
+	BT2_REQUEST request = device->requestQueue[device->requestQueueHead];
+	request.status = status;
+	device->requestQueueHead = (device->requestQueueHead + 1) % BT2_REQUEST_QUEUE_LENGTH;
+	device->requestQueueCount--;
+	device->frameStatus = BT2_FRAME_PENDING;
+	device->lastRequestId = request.id;
+	device->lastRequestStatus = status;
+	if (status == BT2_REQUEST_COMPLETE) {
+		device->framesCompleted++;
+		device->throughputWindowFrames++;
+	}
+	if (status == BT2_REQUEST_TIMEOUT) { device->stats.timeouts++; }
+	if (status == BT2_REQUEST_TIMEOUT && device->gattFromCache) { rejectCachedGatt(device); }
+	if (request.id == device->pollRequestId) { completePollGroup(index, status); }
+	if (request.id == device->profileDetectionRequestId) { completeProfileDetection(index, status); }
+	if (request.callback != NULL) { request.callback(index, &request); }
+}
+
+
+/** Polls plan on every device; setReadPlan(index, plan) gives one device its own plan.  NULL stops polling.
+ * The plan must outlive the reader, and must already have been built
+ */
+void BT2Reader::setReadPlan(BT2ReadPlan * plan) {
+	for (int i = 0; i < deviceTableSize; i++) { setReadPlan(i, plan); }
+}
+
+void BT2Reader::setReadPlan(int index, BT2ReadPlan * plan) {
+	if (index < 0 || index >= deviceTableSize) { return; }
+	deviceTable[index].readPlan = plan;
+	deviceTable[index].readPlanCommand = 0;
+}
+
+/** Runs for every read queued by the read plan, like a queueReadCommand callback
+ */
+void BT2Reader::setPollCallback(BT2RequestCallback callback) { pollCallback = callback; }
+
+/** Completed frames per second over the last full second
+ */
+float BT2Reader::getFramesPerSecond(int index) {
+	if (index < 0 || index >= deviceTableSize) { return 0; }
+	return (deviceTable[index].framesPerSecond);
+}
+
+uint32_t BT2Reader::getFramesCompleted(int index) {
+	if (index < 0 || index >= deviceTableSize) { return 0; }
+	return (deviceTable[index].framesCompleted);
+}
+
+void BT2Reader::updateThroughput(DEVICE * device) {
+	uint32_t elapsed = millis() - device->throughputWindowStartMillis;
+	if (elapsed < 1000) { return; }
+	device->framesPerSecond = device->throughputWindowFrames * 1000.0f / elapsed;
+	device->throughputWindowFrames = 0;
+	device->throughputWindowStartMillis = millis();
+}
@@ -0,0 +1,125 @@
+#include "BT2Reader.h"
+
+/** Scan path helpers.  scanCallback runs for every advertising report in range, so each report is walked once
+ * by parseAdvertisement() and matched to a device slot through a small open addressed hash of peer addresses
+ * instead of memcmp over the whole deviceTable.  Addresses already known to be of no use are remembered in
+ * scanRejects, so the phones and beacons that make up most of a scan cost one probe per report.
+ */
+
+/** Walks the report's AD structures once, picking out what scanCallback needs: the BT2 service UUID (16 or 128
+ * bit form), the manufacturer ID and the local name.  Malformed structures end the walk
+ */
+void BT2Reader::parseAdvertisement(const ble_gap_evt_adv_report_t * report, BT2_ADVERTISEMENT * advertisement) {
+	static const uint8_t BT2_SERVICE_UUID128[16] = {0xFB,0x34,0x9B,0x5F,0x80,0x00,0x00,0x80,0x00,0x10,0x00,0x00,0xD0,0xFF,0x00,0x00};
+	memset(advertisement, 0, sizeof(BT2_ADVERTISEMENT));
+	const uint8_t * data = report->data.p_data;
+	int length = report->data.len;
+	int index = 0;
+	while (index + 1 < length) {
+		int fieldLength = data[index];
+		if (fieldLength == 0 || index + 1 + fieldLength > length) { return; }
+		const uint8_t * field = &data[index + 2];
+		int fieldDataLength = fieldLength - 1;
+
+		switch (data[index + 1]) {
+			case BLE_GAP_AD_TYPE_16BIT_SERVICE_UUID_MORE_AVAILABLE:
+			case BLE_GAP_AD_TYPE_16BIT_SERVICE_UUID_COMPLETE:
+				for (int i = 0; i + 1 < fieldDataLength; i += 2) {
+					if (field[i] + field[i + 1] * 256 == BT2_TX_SERVICE) { advertisement->hasBT2Service = true; }
+				}
+				break;
+			case BLE_GAP_AD_TYPE_128BIT_SERVICE_UUID_MORE_AVAILABLE:
+			case BLE_GAP_AD_TYPE_128BIT_SERVICE_UUID_COMPLETE:
+				for (int i = 0; i + 15 < fieldDataLength; i += 16) {
+					if (memcmp(&field[i], BT2_SERVICE_UUID128, 16) == 0) { advertisement->hasBT2Service = true; }
+				}
+				break;
+			case BLE_GAP_AD_TYPE_MANUFACTURER_SPECIFIC_DATA:
+				if (fieldDataLength >= 2) {
+					advertisement->hasManufacturerId = true;
+					advertisement->manufacturerId = field[0] + field[1] * 256;
+				}
+				break;
+			case BLE_GAP_AD_TYPE_SHORT_LOCAL_NAME:
+			case BLE_GAP_AD_TYPE_COMPLETE_LOCAL_NAME:
+				advertisement->localNameLength = min(fieldDataLength, (int)sizeof(advertisement->localName) - 1);
+				memcpy(advertisement->localName, field, advertisement->localNameLength);
+				advertisement->localName[advertisement->localNameLength] = 0;
+				break;
+		}
+		index += fieldLength + 1;
+	}
+}
+
+uint32_t BT2Reader::getAddressHash(const uint8_t * peerAddress) {
+	uint32_t hash = 2166136261UL;
+	for (int i = 0; i < 6; i++) { hash = (hash ^ peerAddress[i]) * 16777619UL; }
+	return hash;
+}
+
+/** Rebuilt whenever a slot's peerAddress changes; with at most MAXIMUM_BT2_DEVICES entries that's cheaper than
+ * supporting deletion in the open addressed table.  A changed table may want addresses it rejected before, so
+ * scanRejects is cleared too
+ */
+void BT2Reader::rebuildAddressIndex() {
+	clearScanRejects();
+	memset(addressIndex, 0xFF, sizeof(addressIndex));
+	for (int i = 0; i < deviceTableSize; i++) {
+		if (memcmp(deviceTable[i].peerAddress, BLANK_MACID, 6) == 0) { continue; }
+		int bucket = getAddressHash(deviceTable[i].peerAddress) & (ADDRESS_INDEX_SIZE - 1);
+		while (addressIndex[bucket] != -1) { bucket = (bucket + 1) & (ADDRESS_INDEX_SIZE - 1); }
+		addressIndex[bucket] = i;
+	}
+}
+
+/** The slot holding peerAddress, or -1.  Usually a single probe
+ */
+int BT2Reader::findAddressIndex(const uint8_t * peerAddress) { return findAddressIndex(peerAddress, getAddressHash(peerAddress)); }
+
+int BT2Reader::findAddressIndex(const uint8_t * peerAddress, uint32_t addressHash) {
+	if (deviceTableSize == 0) { return -1; }
+	int bucket = addressHash & (ADDRESS_INDEX_SIZE - 1);
+	while (addressIndex[bucket] != -1) {
+		if (memcmp(deviceTable[addressIndex[bucket]].peerAddress, peerAddress, 6) == 0) { return addressIndex[bucket]; }
+		bucket = (bucket + 1) & (ADDRESS_INDEX_SIZE - 1);
+	}
+	return -1;
+}
+
+
+/** Negative cache of advertisers, direct mapped on the address hash.  Probing reads no clock: entries are aged
+ * out by service() after BT2_SCAN_REJECT_MILLIS, so a device that changes what it advertises, or a reused random
+ * address, is looked at again.  Only the hash is kept; a collision costs a BT2 at most one reject period
+ */
+boolean BT2Reader::getIsScanRejected(uint32_t addressHash) {
+	SCAN_REJECT * reject = &scanRejects[addressHash & (SCAN_REJECT_CACHE_SIZE - 1)];
+	return (reject->expiresMillis != 0 && reject->addressHash == addressHash);
+}
+
+void BT2Reader::rejectScanAddress(uint32_t addressHash) {
+	SCAN_REJECT * reject = &scanRejects[addressHash & (SCAN_REJECT_CACHE_SIZE - 1)];
+	reject->addressHash = addressHash;
+	reject->expiresMillis = (millis() + BT2_SCAN_REJECT_MILLIS) | 1;				// 0 marks an empty entry
+}
+
+void BT2Reader::clearScanRejects() {
+	memset(scanRejects, 0, sizeof(scanRejects));
+}
+
+/** Called from service(); sweeps the cache once a second */
+void BT2Reader::ageScanRejects() {
+	uint32_t now = millis();
+	if (now - scanRejectsAgedMillis < 1000) { return; }
+	scanRejectsAgedMillis = now;
+	for (int i = 0; i < SCAN_REJECT_CACHE_SIZE; i++) {
+		if (scanRejects[i].expiresMillis != 0 && (int32_t)(scanRejects[i].expiresMillis - now) <= 0) { scanRejects[i].expiresMillis = 0; }
+	}
+}
+
+/** True while some slot has no address yet, i.e. an unknown BT2 might still be claimed or matched by name */
+boolean BT2Reader::getHasOpenSlot() {
+	for (int i = 0; i < deviceTableSize; i++) {
+		if (memcmp(deviceTable[i].peerAddress, BLANK_MACID, 6) == 0) { return true; }
+	}
+	return false;
+}
@@ -0,0 +1,104 @@
+#include "BT2Reader.h"
+
+/** Binary snapshots (format in BT2Snapshot.h).  The same registers dumped through printRegister() take about 35
+ * times the bytes of a key frame, and 50 times those of a delta frame
+ */
+
+/** Writes a snapshot of every device in the table to buffer and returns its length, or 0 if it doesn't fit in
+ * size bytes (BT2_SNAPSHOT_MAXIMUM_LENGTH always does).  Each device's profile registers are sent in address
+ * order, in runs of consecutive registers, with the age of its newest frame.  With an encoder, frames are deltas
+ * against the one before, with a key frame every keyInterval frames and whenever the table or a profile changed
+ */
+int BT2Reader::encodeSnapshot(uint8_t * buffer, int size, BT2SnapshotEncoder * encoder) {
+	uint32_t now = millis();
+	boolean delta = (encoder != NULL && encoder->layoutValid && encoder->deviceCount == deviceTableSize && encoder->snapshotsSinceKey < encoder->keyInterval);
+	for (int i = 0; i < deviceTableSize && delta; i++) { delta = (encoder->profiles[i] == deviceTable[i].profile); }
+
+	int length = BT2_SNAPSHOT_HEADER_LENGTH;
+	length = putSnapshotByte(buffer, size, length, delta ? BT2_SNAPSHOT_FLAG_DELTA : 0);
+	length = putSnapshotVarint(buffer, size, length, encoder != NULL ? encoder->sequence : 0);
+	length = putSnapshotVarint(buffer, size, length, now);
+	length = putSnapshotByte(buffer, size, length, deviceTableSize);
+
+	for (int i = 0; i < deviceTableSize; i++) {
+		DEVICE * device = &deviceTable[i];
+		const BT2_REGISTER_PROFILE * profile = device->profile;
+		drainFrames(device);
+		uint32_t age = 0;														// 0 for never, else age + 1
+		for (int r = 0; r < MAXIMUM_FRAME_RUNS; r++) {
+			const FRAME_RUN * run = &device->frameRuns[r];
+			if (run->numberOfRegisters > 0 && (age == 0 || now - run->updateMillis + 1 < age)) { age = now - run->updateMillis + 1; }
+		}
+		length = putSnapshotByte(buffer, size, length, i);
+		length = putSnapshotByte(buffer, size, length, device->handle != BLE_CONN_HANDLE_INVALID ? BT2_SNAPSHOT_DEVICE_CONNECTED : 0);
+		length = putSnapshotByte(buffer, size, length, profile->modbusAddress);
+		length = putSnapshotVarint(buffer, size, length, age);
+
+		RENOGY_COMMANDS runs[MAXIMUM_PROFILE_DESCRIPTIONS];
+		int runCount = 0;
+		int registers = 0;
+		for (int d = 0; d < profile->descriptionSize && registers < BT2_SNAPSHOT_MAXIMUM_VALUES; d++) {
+			const REGISTER_DESCRIPTION * description = &profile->descriptions[d];
+			if (description->address == INVALID_REGISTER) { continue; }
+			int n = min(description->bytesUsed / 2, BT2_SNAPSHOT_MAXIMUM_VALUES - registers);
+			if (runCount > 0 && runs[runCount - 1].startRegister + runs[runCount - 1].numberOfRegisters == description->address) {
+				runs[runCount - 1].numberOfRegisters += n;
+			} else {
+				runs[runCount].startRegister = description->address;
+				runs[runCount++].numberOfRegisters = n;
+			}
+			registers += n;
+		}
+		length = putSnapshotVarint(buffer, size, length, runCount);
+
+		uint16_t * previous = (encoder != NULL ? encoder->previous[i] : NULL);
+		uint16_t runEnd = 0;
+		for (int r = 0; r < runCount; r++) {
+			length = putSnapshotVarint(buffer, size, length, runs[r].startRegister - runEnd);
+			length = putSnapshotVarint(buffer, size, length, runs[r].numberOfRegisters);
+			const uint16_t * values = &device->registerValues[getRegisterValueIndex(device, runs[r].startRegister)];	// slots follow description order
+			for (int k = 0; k < runs[r].numberOfRegisters; k++) {
+				length = putSnapshotVarint(buffer, size, length, delta ? getSnapshotZigzag((int16_t)(values[k] - *previous)) : values[k]);
+				if (previous != NULL) { *previous++ = values[k]; }
+			}
+			runEnd = runs[r].startRegister + runs[r].numberOfRegisters;
+		}
+		if (encoder != NULL) { encoder->profiles[i] = profile; }
+	}
+
+	if (length + 2 > size || length + 2 > 0xFFFF) {
+		if (encoder != NULL) { encoder->layoutValid = false; }				// previous no longer matches what the receiver has
+		return 0;
+	}
+	buffer[0] = BT2_SNAPSHOT_SYNC;
+	buffer[1] = BT2_SNAPSHOT_VERSION;
+	buffer[2] = (length + 2) & 0xFF;
+	buffer[3] = (length + 2) >> 8;
+	uint16_t checksum = updateModbusChecksum(0xFFFF, buffer, length);
+	buffer[length++] = checksum & 0xFF;
+	buffer[length++] = checksum >> 8;
+
+	if (encoder != NULL) {
+		encoder->sequence++;
+		encoder->snapshotsSinceKey = (delta ? encoder->snapshotsSinceKey + 1 : 0);
+		encoder->deviceCount = deviceTableSize;
+		encoder->layoutValid = true;
+	}
+	return length;
+}
+
+/** Stores value at buffer[length] if it fits, and returns the length either way, so an overflow is found once at
+ * the end
+ */
+int BT2Reader::putSnapshotByte(uint8_t * buffer, int size, int length, uint8_t value) {
+	if (length < size) { buffer[length] = value; }
+	return length + 1;
+}
+
+int BT2Reader::putSnapshotVarint(uint8_t * buffer, int size, int length, uint32_t value) {
+	while (value >= 0x80) {
+		length = putSnapshotByte(buffer, size, length, (value & 0x7F) | 0x80);
+		value >>= 7;
+	}
+	return putSnapshotByte(buffer, size, length, value);
+}
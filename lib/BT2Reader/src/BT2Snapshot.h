@@ -0,0 +1,124 @@
+#ifndef BT2_SNAPSHOT_H
+#define BT2_SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/**	Compact binary snapshots of every device's registers, for forwarding over a UART instead of printRegister()
+ * text.  BT2Reader::encodeSnapshot() writes one frame; BT2SnapshotDecoder turns frames back into register values
+ * on the receiving side.  This header only needs the C++ standard library, so a Linux host can build the decoder
+ * from BT2Snapshot.h and BT2SnapshotDecoder.cpp alone.
+ *
+ * Frame, version 1 (varints are unsigned LEB128, little endian otherwise):
+ *
+ *		0xB2 sync, version, length (2 bytes, whole frame including sync and CRC), flags
+ *		varint sequence, varint snapshot millis, device count
+ *		per device:	index, status, Modbus address, varint age of its newest frame in ms (0 if never read, else age + 1),
+ *					varint run count, then per run: varint gap from the previous run's end, varint register count,
+ *					and a varint per register
+ *		Modbus CRC-16 of everything before it (2 bytes)
+ *
+ * A key frame (no BT2_SNAPSHOT_FLAG_DELTA) carries each register as its raw value.  A delta frame has the same
+ * layout as the frame before it and carries each register as the zigzag encoded difference from that frame, so a
+ * value that didn't change costs one byte.  Decode a delta frame only on top of the frame with sequence - 1.
+ */
+
+#define BT2_SNAPSHOT_SYNC				0xB2
+#define BT2_SNAPSHOT_VERSION			1
+#define BT2_SNAPSHOT_HEADER_LENGTH		4			// sync, version, length
+#define BT2_SNAPSHOT_FLAG_DELTA			0x01
+#define BT2_SNAPSHOT_DEVICE_CONNECTED	0x01		// device status bits
+#define BT2_SNAPSHOT_MAXIMUM_DEVICES	8
+#define BT2_SNAPSHOT_MAXIMUM_VALUES		64			// registers sent per device; any beyond are left out
+#define BT2_SNAPSHOT_MAXIMUM_LENGTH		(BT2_SNAPSHOT_HEADER_LENGTH + 12 + BT2_SNAPSHOT_MAXIMUM_DEVICES * (13 + 7 * BT2_SNAPSHOT_MAXIMUM_VALUES) + 2)	// worst case
+#define DEFAULT_SNAPSHOT_KEY_INTERVAL	30			// delta frames between key frames
+
+#define BT2_SNAPSHOT_OK					0
+#define BT2_SNAPSHOT_INCOMPLETE			1			// not a whole frame yet
+#define BT2_SNAPSHOT_BAD_FRAME			2			// bad sync, version, length or layout
+#define BT2_SNAPSHOT_CHECKSUM_ERROR		3
+#define BT2_SNAPSHOT_NEEDS_KEY			4			// a delta frame without the frame it's relative to
+
+
+inline uint32_t getSnapshotZigzag(int32_t value) { return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31); }
+inline int32_t getSnapshotUnzigzag(uint32_t value) { return (int32_t)(value >> 1) ^ -(int32_t)(value & 0x01); }
+
+
+/** Encoder state kept between BT2Reader::encodeSnapshot() calls: the values sent last, so the next frame can be
+ * a delta, and when the next key frame is due.  Without one every frame is a key frame
+ */
+class BT2SnapshotEncoder {
+
+public:
+
+	void setKeyInterval(int snapshots) { keyInterval = snapshots < 0 ? 0 : snapshots; }
+	void requestKey() { layoutValid = false; }							// e.g. after the receiver reports a gap
+	uint32_t getSequence() { return sequence; }
+
+	uint32_t sequence = 0;													// of the next frame
+	int keyInterval = DEFAULT_SNAPSHOT_KEY_INTERVAL;
+	int snapshotsSinceKey = 0;
+	bool layoutValid = false;												// previous holds the last frame sent
+	int deviceCount = 0;
+	const void * profiles[BT2_SNAPSHOT_MAXIMUM_DEVICES];					// layout of the last frame, per device
+	uint16_t previous[BT2_SNAPSHOT_MAXIMUM_DEVICES][BT2_SNAPSHOT_MAXIMUM_VALUES];
+};
+
+
+struct BT2_SNAPSHOT_REGISTER {
+	uint16_t address;
+	uint16_t value;
+};
+
+struct BT2_SNAPSHOT_DEVICE {
+	uint8_t index;
+	uint8_t status;
+	uint8_t modbusAddress;
+	bool everRead;
+	uint32_t frameMillis;													// in the sender's millis(), if everRead
+	int registerCount;
+	BT2_SNAPSHOT_REGISTER registers[BT2_SNAPSHOT_MAXIMUM_VALUES];
+};
+
+struct BT2_SNAPSHOT {
+	uint32_t sequence;
+	uint32_t snapshotMillis;
+	uint8_t flags;
+	int deviceCount;
+	BT2_SNAPSHOT_DEVICE devices[BT2_SNAPSHOT_MAXIMUM_DEVICES];
+};
+
+
+/** Decodes frames into snapshot, which also holds the values delta frames are applied to.  decode() takes one
+ * frame; feed() takes a byte stream, e.g. straight from the serial port, finds the frames in it and skips
+ * anything that isn't one
+ */
+class BT2SnapshotDecoder {
+
+public:
+
+	int decode(const uint8_t * frame, int length);
+	int feed(const uint8_t * data, int length);
+	const BT2_SNAPSHOT * getSnapshot() { return &snapshot; }
+	bool getHasSnapshot() { return hasSnapshot; }
+	uint32_t framesDecoded = 0;
+	uint32_t framesRejected = 0;
+
+	/** Called by feed() for every frame it decodes */
+	typedef void (*snapshot_cb_t)(const BT2_SNAPSHOT * snapshot);
+	snapshot_cb_t snapshotCallback = NULL;
+
+private:
+
+	BT2_SNAPSHOT snapshot;
+	BT2_SNAPSHOT staging;
+	bool hasSnapshot = false;
+	uint8_t streamBuffer[BT2_SNAPSHOT_MAXIMUM_LENGTH];
+	int streamLength = 0;
+
+	static bool readVarint(const uint8_t * data, int end, int * offset, uint32_t * value);
+	static uint16_t getChecksum(const uint8_t * data, int length);
+};
+
+#endif
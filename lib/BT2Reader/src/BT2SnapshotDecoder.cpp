@@ -0,0 +1,133 @@
+#include "BT2Snapshot.h"
+
+/** Receiving side of BT2Snapshot.h.  Only uses the C++ standard library, so it builds on the host as it is
+ */
+
+/** Decodes one whole frame.  A key frame replaces the snapshot; a delta frame is applied to it, and only if it's
+ * the next in sequence with the same layout.  On any error the snapshot is left as it was
+ */
+int BT2SnapshotDecoder::decode(const uint8_t * frame, int length) {
+	if (length < BT2_SNAPSHOT_HEADER_LENGTH + 3) { return BT2_SNAPSHOT_INCOMPLETE; }
+	if (frame[0] != BT2_SNAPSHOT_SYNC || frame[1] != BT2_SNAPSHOT_VERSION || frame[2] + frame[3] * 256 != length) { return BT2_SNAPSHOT_BAD_FRAME; }
+	int end = length - 2;
+	if (getChecksum(frame, end) != frame[end] + frame[end + 1] * 256) { return BT2_SNAPSHOT_CHECKSUM_ERROR; }
+
+	int offset = BT2_SNAPSHOT_HEADER_LENGTH;
+	uint32_t deviceCount;
+	staging.flags = frame[offset++];
+	if (!readVarint(frame, end, &offset, &staging.sequence) || !readVarint(frame, end, &offset, &staging.snapshotMillis) || offset >= end) {
+		return BT2_SNAPSHOT_BAD_FRAME;
+	}
+	deviceCount = frame[offset++];
+	if (deviceCount > BT2_SNAPSHOT_MAXIMUM_DEVICES) { return BT2_SNAPSHOT_BAD_FRAME; }
+	bool delta = (staging.flags & BT2_SNAPSHOT_FLAG_DELTA) != 0;
+	if (delta && (!hasSnapshot || staging.sequence != snapshot.sequence + 1 || (int)deviceCount != snapshot.deviceCount)) { return BT2_SNAPSHOT_NEEDS_KEY; }
+	staging.deviceCount = deviceCount;
+
+	for (int i = 0; i < staging.deviceCount; i++) {
+		BT2_SNAPSHOT_DEVICE * device = &staging.devices[i];
+		const BT2_SNAPSHOT_DEVICE * previous = &snapshot.devices[i];
+		uint32_t age;
+		uint32_t runCount;
+		if (offset + 3 > end) { return BT2_SNAPSHOT_BAD_FRAME; }
+		device->index = frame[offset++];
+		device->status = frame[offset++];
+		device->modbusAddress = frame[offset++];
+		if (!readVarint(frame, end, &offset, &age) || !readVarint(frame, end, &offset, &runCount)) { return BT2_SNAPSHOT_BAD_FRAME; }
+		device->everRead = (age > 0);
+		device->frameMillis = (age > 0 ? staging.snapshotMillis - (age - 1) : 0);
+		device->registerCount = 0;
+
+		uint32_t address = 0;
+		for (uint32_t run = 0; run < runCount; run++) {
+			uint32_t gap;
+			uint32_t registers;
+			if (!readVarint(frame, end, &offset, &gap) || !readVarint(frame, end, &offset, &registers)) { return BT2_SNAPSHOT_BAD_FRAME; }
+			address += gap;
+			if (address + registers > 0x10000 || device->registerCount + registers > BT2_SNAPSHOT_MAXIMUM_VALUES) { return BT2_SNAPSHOT_BAD_FRAME; }
+			for (uint32_t k = 0; k < registers; k++, address++) {
+				uint32_t value;
+				if (!readVarint(frame, end, &offset, &value)) { return BT2_SNAPSHOT_BAD_FRAME; }
+				BT2_SNAPSHOT_REGISTER * entry = &device->registers[device->registerCount];
+				entry->address = address;
+				if (delta) {
+					if (device->registerCount >= previous->registerCount || previous->registers[device->registerCount].address != address) { return BT2_SNAPSHOT_NEEDS_KEY; }
+					entry->value = previous->registers[device->registerCount].value + getSnapshotUnzigzag(value);
+				} else {
+					if (value > 0xFFFF) { return BT2_SNAPSHOT_BAD_FRAME; }
+					entry->value = value;
+				}
+				device->registerCount++;
+			}
+		}
+		if (delta && (device->index != previous->index || device->registerCount != previous->registerCount)) { return BT2_SNAPSHOT_NEEDS_KEY; }
+	}
+	if (offset != end) { return BT2_SNAPSHOT_BAD_FRAME; }
+
+	memcpy(&snapshot, &staging, sizeof(snapshot));
+	hasSnapshot = true;
+	return BT2_SNAPSHOT_OK;
+}
+
+/** Appends data to the stream and decodes every whole frame in it; returns how many were decoded.  Bytes that
+ * can't start a frame, and frames that fail their CRC, are skipped one byte at a time until the next sync
+ */
+int BT2SnapshotDecoder::feed(const uint8_t * data, int length) {
+	int decoded = 0;
+	while (true) {
+		int n = (int)sizeof(streamBuffer) - streamLength;
+		n = n < length ? n : length;
+		memcpy(&streamBuffer[streamLength], data, n);
+		streamLength += n;
+		data += n;
+		length -= n;
+
+		int start = 0;
+		while (start < streamLength) {
+			if (streamBuffer[start] != BT2_SNAPSHOT_SYNC) { start++; continue; }
+			if (streamLength - start < BT2_SNAPSHOT_HEADER_LENGTH) { break; }
+			int frameLength = streamBuffer[start + 2] + streamBuffer[start + 3] * 256;
+			if (streamBuffer[start + 1] != BT2_SNAPSHOT_VERSION || frameLength < BT2_SNAPSHOT_HEADER_LENGTH + 3 || frameLength > BT2_SNAPSHOT_MAXIMUM_LENGTH) {
+				start++;
+				continue;
+			}
+			if (streamLength - start < frameLength) { break; }
+			int status = decode(&streamBuffer[start], frameLength);
+			if (status == BT2_SNAPSHOT_OK) {
+				framesDecoded++;
+				decoded++;
+				if (snapshotCallback != NULL) { snapshotCallback(&snapshot); }
+				start += frameLength;
+			} else if (status == BT2_SNAPSHOT_NEEDS_KEY) {
+				framesRejected++;											// a good frame we can't use; wait for the next key
+				start += frameLength;
+			} else {
+				start++;
+			}
+		}
+		memmove(streamBuffer, &streamBuffer[start], streamLength - start);
+		streamLength -= start;
+		if (length == 0) { break; }
+	}
+	return decoded;
+}
+
+bool BT2SnapshotDecoder::readVarint(const uint8_t * data, int end, int * offset, uint32_t * value) {
+	*value = 0;
+	for (int shift = 0; shift < 35 && *offset < end; shift += 7) {
+		uint8_t b = data[(*offset)++];
+		*value |= (uint32_t)(b & 0x7F) << shift;
+		if ((b & 0x80) == 0) { return true; }
+	}
+	return false;
+}
+
+/** Modbus CRC-16, as the BT2 frames use; bitwise, since the host has time to spare */
+uint16_t BT2SnapshotDecoder::getChecksum(const uint8_t * data, int length) {
+	uint16_t crc = 0xFFFF;
+	for (int i = 0; i < length; i++) {
+		crc ^= data[i];
+		for (int bit = 0; bit < 8; bit++) { crc = (crc & 0x0001) ? (crc >> 1) ^ 0xA001 : crc >> 1; }
+	}
+	return crc;
+}
@@ -0,0 +1,52 @@
+#include "BT2Reader.h"
+
+/** Link health instrumentation.  Everything is a fixed size counter in DEVICE::stats, updated where the event
+ * happens (notifyCallback, the frame parser, service(), the connection callbacks); getStats() copies them out
+ */
+
+/** Copies the device's counters into stats; false if index is out of range
+ */
+boolean BT2Reader::getStats(int index, BT2_STATS * stats) {
+	if (index < 0 || index >= deviceTableSize) { return false; }
+	memcpy(stats, &deviceTable[index].stats, sizeof(BT2_STATS));
+	return true;
+}
+
+void BT2Reader::resetStats(int index) {
+	if (index < 0 || index >= deviceTableSize) { return; }
+	memset(&deviceTable[index].stats, 0, sizeof(BT2_STATS));
+}
+
+/** Called from notifyCallback for every notification.  Gaps are only measured between notifications of the same
+ * response, so the BT2's think time before the first one isn't counted as a gap
+ */
+void BT2Reader::recordNotification(DEVICE * device) {
+	uint32_t now = micros();
+	BT2_STATS * stats = &device->stats;
+	stats->notifications++;
+	if (device->responseNotifications > 0) {
+		uint32_t gap = now - device->lastNotificationMicros;
+		stats->notificationGaps++;
+		stats->notificationGapTotalMicros += gap;
+		stats->notificationGapMaxMicros = max(stats->notificationGapMaxMicros, gap);
+	}
+	device->responseNotifications++;
+	device->lastNotificationMicros = now;
+	if (device->parserState == BT2_PARSER_COMPLETE) { stats->overruns++; }
+}
+
+/** Called once per frame with a good checksum
+ */
+void BT2Reader::recordFrameStats(DEVICE * device, boolean exception) {
+	BT2_STATS * stats = &device->stats;
+	uint32_t roundTrip = millis() - device->commandSentMillis;
+	int bucket = 0;
+	while (bucket < BT2_RTT_BUCKETS - 1 && roundTrip >= BT2_RTT_BUCKET_MILLIS[bucket]) { bucket++; }
+	stats->roundTripHistogram[bucket]++;
+	stats->roundTripMinMillis = (stats->framesCompleted == 0 ? roundTrip : min(stats->roundTripMinMillis, roundTrip));
+	stats->roundTripMaxMillis = max(stats->roundTripMaxMillis, roundTrip);
+	stats->roundTripTotalMillis += roundTrip;
+	stats->framesCompleted++;
+	stats->frameNotifications += device->responseNotifications;
+	if (exception) { stats->exceptions++; }
+}
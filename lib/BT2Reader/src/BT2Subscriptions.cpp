@@ -0,0 +1,176 @@
+#include "BT2Reader.h"
+
+/** Reports changes to registerAddress on device index, either by calling callback from service() or, if callback
+ * is NULL, through getNextChangedRegister().  deadband is in thousandths of the register's unit, as getScaledValue
+ * returns, so 100 on RENOGY_AUX_BATT_VOLTAGE ignores moves of less than 0.1V.  The first value read always counts
+ * as a change.  Registers that pack two values, like RENOGY_AUX_BATT_TEMPERATURE, should use a deadband of 0
+ */
+boolean BT2Reader::subscribe(int index, uint16_t registerAddress, int32_t deadband, BT2ChangeCallback callback) {
+	if (index < 0 || index >= deviceTableSize) { return false; }
+	DEVICE * device = &deviceTable[index];
+	const REGISTER_INDEX_ENTRY * entry = getRegisterIndexEntry(device, registerAddress);
+	if (entry == NULL || entry->descriptionIndex == REGISTER_INDEX_NONE) {
+		logerror("Register 0x%04X has no description, can't subscribe to it\n", registerAddress);
+		return false;
+	}
+
+	int callbackIndex = 0;
+	if (callback != NULL) {
+		while (callbackIndex < changeCallbackCount && changeCallbacks[callbackIndex] != callback) { callbackIndex++; }
+		if (callbackIndex == MAXIMUM_CHANGE_CALLBACKS) {
+			logerror("Too many change callbacks, MAXIMUM_CHANGE_CALLBACKS is %d\n", MAXIMUM_CHANGE_CALLBACKS);
+			return false;
+		}
+		if (callbackIndex == changeCallbackCount) { changeCallbacks[changeCallbackCount++] = callback; }
+	}
+
+	if (device->subscriptions == NULL) {
+		device->subscriptions = (subscriptionStorage != NULL ? &subscriptionStorage[index] : new REGISTER_SUBSCRIPTIONS);
+		memset(device->subscriptions, 0, sizeof(REGISTER_SUBSCRIPTIONS));
+	}
+	REGISTER_SUBSCRIPTIONS * subscriptions = device->subscriptions;
+	int i = entry->descriptionIndex;
+	int32_t scale = max(getRegisterMilliScale(device->profile->descriptions[i]), (int32_t)1);
+	uint32_t bit = 1UL << (i & 31);
+	subscriptions->deadbands[i] = (uint16_t)min((max(deadband, (int32_t)0) + scale - 1) / scale, (int32_t)0xFFFF);
+	subscriptions->callbacks[i] = callbackIndex;
+	subscriptions->subscribed[i / 32] |= bit;
+	subscriptions->reported[i / 32] &= ~bit;
+	subscriptions->changed[i / 32] &= ~bit;
+	if (callback != NULL) {
+		subscriptions->withCallback[i / 32] |= bit;
+	} else {
+		subscriptions->withCallback[i / 32] &= ~bit;
+	}
+	return true;
+}
+
+boolean BT2Reader::unsubscribe(int index, uint16_t registerAddress) {
+	if (index < 0 || index >= deviceTableSize || deviceTable[index].subscriptions == NULL) { return false; }
+	const REGISTER_INDEX_ENTRY * entry = getRegisterIndexEntry(&deviceTable[index], registerAddress);
+	if (entry == NULL || entry->descriptionIndex == REGISTER_INDEX_NONE) { return false; }
+	REGISTER_SUBSCRIPTIONS * subscriptions = deviceTable[index].subscriptions;
+	int i = entry->descriptionIndex;
+	uint32_t bit = 1UL << (i & 31);
+	boolean wasSubscribed = (subscriptions->subscribed[i / 32] & bit) != 0;
+	subscriptions->subscribed[i / 32] &= ~bit;
+	subscriptions->changed[i / 32] &= ~bit;
+	subscriptions->withCallback[i / 32] &= ~bit;
+	return wasSubscribed;
+}
+
+/** True if a subscribed register has changed since it was last reported; reporting it clears the flag
+ */
+boolean BT2Reader::getIsRegisterChanged(int index, uint16_t registerAddress) {
+	if (index < 0 || index >= deviceTableSize || deviceTable[index].subscriptions == NULL) { return false; }
+	drainFrames(&deviceTable[index]);
+	const REGISTER_INDEX_ENTRY * entry = getRegisterIndexEntry(&deviceTable[index], registerAddress);
+	if (entry == NULL || entry->descriptionIndex == REGISTER_INDEX_NONE) { return false; }
+	REGISTER_SUBSCRIPTIONS * subscriptions = deviceTable[index].subscriptions;
+	int i = entry->descriptionIndex;
+	uint32_t bit = 1UL << (i & 31);
+	if ((subscriptions->changed[i / 32] & bit) == 0) { return false; }
+	subscriptions->changed[i / 32] &= ~bit;
+	return true;
+}
+
+/** The address of the next changed register on device index, clearing its flag, or -1 if nothing has changed.
+ * Call it in a loop until -1 to publish just what moved
+ */
+int BT2Reader::getNextChangedRegister(int index) {
+	if (index < 0 || index >= deviceTableSize || deviceTable[index].subscriptions == NULL) { return -1; }
+	drainFrames(&deviceTable[index]);
+	REGISTER_SUBSCRIPTIONS * subscriptions = deviceTable[index].subscriptions;
+	for (int word = 0; word < REGISTER_MASK_WORDS; word++) {
+		uint32_t pending = subscriptions->changed[word] & ~subscriptions->withCallback[word];
+		if (pending == 0) { continue; }
+		int bit = __builtin_ctz(pending);
+		subscriptions->changed[word] &= ~(1UL << bit);
+		return deviceTable[index].profile->descriptions[word * 32 + bit].address;
+	}
+	return -1;
+}
+
+/** Called by processDataReceived for every good frame.  Walks only the subscribed registers, a word at a time
+ */
+void BT2Reader::updateSubscriptions(DEVICE * device, uint16_t startRegister, int numberOfRegisters) {
+	REGISTER_SUBSCRIPTIONS * subscriptions = device->subscriptions;
+	for (int word = 0; word < REGISTER_MASK_WORDS; word++) {
+		uint32_t pending = subscriptions->subscribed[word];
+		while (pending != 0) {
+			int bit = __builtin_ctz(pending);
+			pending &= pending - 1;
+			int i = word * 32 + bit;
+			const REGISTER_DESCRIPTION & description = device->profile->descriptions[i];
+			if ((uint16_t)(description.address - startRegister) >= numberOfRegisters) { continue; }
+
+			uint32_t value = getSubscriptionValue(device, i);
+			uint32_t reportedValue = subscriptions->reportedValues[i];
+			int64_t difference = getIsRegisterSigned(description.type) ? (int64_t)(int16_t)value - (int16_t)reportedValue : (int64_t)value - reportedValue;
+			if (difference < 0) { difference = -difference; }
+			boolean reported = (subscriptions->reported[word] & (1UL << bit)) != 0;
+			if (reported && (difference == 0 || difference < subscriptions->deadbands[i])) { continue; }
+			subscriptions->reportedValues[i] = value;
+			subscriptions->reported[word] |= 1UL << bit;
+			subscriptions->changed[word] |= 1UL << bit;
+		}
+	}
+}
+
+/** The register's value for change detection: the value itself for one or two registers, a hash of the
+ * registers for longer ones like the product model, where only "changed or not" means anything
+ */
+uint32_t BT2Reader::getSubscriptionValue(DEVICE * device, int descriptionIndex) {
+	const REGISTER_DESCRIPTION & description = device->profile->descriptions[descriptionIndex];
+	int valueIndex = getRegisterIndexEntry(device, description.address)->valueIndex;
+	if (description.bytesUsed <= 2) { return device->registerValues[valueIndex]; }
+	if (description.bytesUsed == 4) { return ((uint32_t)device->registerValues[valueIndex] << 16) | device->registerValues[valueIndex + 1]; }
+	uint32_t hash = 2166136261UL;
+	for (int k = 0; k < description.bytesUsed / 2; k++) { hash = (hash ^ device->registerValues[valueIndex + k]) * 16777619UL; }
+	return hash;
+}
+
+/** Runs the change callbacks from service(), so they're called in loop() context rather than the BLE task's
+ */
+void BT2Reader::dispatchChanges(int index) {
+	REGISTER_SUBSCRIPTIONS * subscriptions = deviceTable[index].subscriptions;
+	if (subscriptions == NULL) { return; }
+	for (int word = 0; word < REGISTER_MASK_WORDS; word++) {
+		uint32_t pending = subscriptions->changed[word] & subscriptions->withCallback[word];
+		while (pending != 0) {
+			int bit = __builtin_ctz(pending);
+			pending &= pending - 1;
+			int i = word * 32 + bit;
+			subscriptions->changed[word] &= ~(1UL << bit);
+			changeCallbacks[subscriptions->callbacks[i]](index, deviceTable[index].profile->descriptions[i].address);
+		}
+	}
+}
+
+/** Called by setRegisterProfile once device->profile is the new one.  Each subscription moves to the description
+ * with the same address, keeping its callback and its deadband in thousandths; one the new profile doesn't describe
+ * is dropped.  Values were cleared, so the first read in the new profile counts as a change
+ */
+void BT2Reader::remapSubscriptions(DEVICE * device, const BT2_REGISTER_PROFILE * previousProfile) {
+	REGISTER_SUBSCRIPTIONS previous = *device->subscriptions;
+	REGISTER_SUBSCRIPTIONS * subscriptions = device->subscriptions;
+	memset(subscriptions, 0, sizeof(REGISTER_SUBSCRIPTIONS));
+	for (int word = 0; word < REGISTER_MASK_WORDS; word++) {
+		uint32_t pending = previous.subscribed[word];
+		while (pending != 0) {
+			int bit = __builtin_ctz(pending);
+			pending &= pending - 1;
+			int previousIndex = word * 32 + bit;
+			const REGISTER_DESCRIPTION & description = previousProfile->descriptions[previousIndex];
+			const REGISTER_INDEX_ENTRY * entry = getRegisterIndexEntry(device, description.address);
+			if (entry == NULL || entry->descriptionIndex == REGISTER_INDEX_NONE) { continue; }
+			int i = entry->descriptionIndex;
+			int32_t deadband = previous.deadbands[previousIndex] * getRegisterMilliScale(description);
+			int32_t scale = max(getRegisterMilliScale(device->profile->descriptions[i]), (int32_t)1);
+			subscriptions->deadbands[i] = (uint16_t)min((deadband + scale - 1) / scale, (int32_t)0xFFFF);
+			subscriptions->callbacks[i] = previous.callbacks[previousIndex];
+			subscriptions->subscribed[i / 32] |= 1UL << (i & 31);
+			if ((previous.withCallback[word] & (1UL << bit)) != 0) { subscriptions->withCallback[i / 32] |= 1UL << (i & 31); }
+		}
+	}
+}
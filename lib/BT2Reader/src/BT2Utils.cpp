@@ -15,30 +15,44 @@ void BT2Reader::printUuid(uint8_t * data, int datalen) {
 	Serial.println();
 }
 
+/** For a whole frame in data, read or exception; the frame parser checks its running CRC instead
+ */
 boolean BT2Reader::getIsReceivedDataValid(uint8_t * data) {
 	return (getProvidedModbusChecksum(data) == getCalculatedModbusChecksum(data));
 }
 
+/** Uses the CRC accumulated by appendRenogyPacket, so only valid once the whole frame has arrived
+ */
+boolean BT2Reader::getIsReceivedDataValid(DEVICE * device) {
+	if (device->checksumLength != getExpectedLength(device->dataReceived) - 2) { return false; }
+	return (getProvidedModbusChecksum(device->dataReceived) == device->runningChecksum);
+}
+
 uint16_t BT2Reader::getProvidedModbusChecksum(uint8_t * data) {
-	int checksumIndex = (int)((data[2]) + 3);
+	int checksumIndex = getExpectedLength(data) - 2;
 	return (data[checksumIndex] + data[checksumIndex + 1] * 256);
 }
 
 uint16_t BT2Reader::getCalculatedModbusChecksum(uint8_t * data) {
-	return (getCalculatedModbusChecksum(data, 0, data[2] + 3));
+	return (getCalculatedModbusChecksum(data, 0, getExpectedLength(data) - 2));
 }
 
 
 uint16_t BT2Reader::getCalculatedModbusChecksum(uint8_t * data, int start, int end) {	
-	uint8_t xxor = 0;
-	uint16_t crc = 0xFFFF;
-	for (int i = start; i < end; i++) {
-		xxor = data[i] ^ crc;
-		crc >>= 8;
-		crc ^= MODBUS_TABLE_A001[xxor & 0xFF];
+	return (updateModbusChecksum(0xFFFF, &data[start], end - start));
+}
+
+/** Folds len more bytes into a running Modbus CRC (start with 0xFFFF), four bytes at a time
+ */
+uint16_t BT2Reader::updateModbusChecksum(uint16_t crc, const uint8_t * data, int len) {
+	const uint16_t (* table)[256] = MODBUS_SLICING_A001.table;
+	int i = 0;
+	for (; i + 4 <= len; i += 4) {
+		crc ^= data[i] | (data[i + 1] << 8);
+		crc = table[3][crc & 0xFF] ^ table[2][crc >> 8] ^ table[1][data[i + 2]] ^ table[0][data[i + 3]];
+	}
+	for (; i < len; i++) {
+		crc = (crc >> 8) ^ table[0][(crc ^ data[i]) & 0xFF];
 	}
 	return crc;
 }
-
-
-
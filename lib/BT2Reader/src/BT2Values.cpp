@@ -0,0 +1,108 @@
+#include "BT2Reader.h"
+
+/** Typed accessors.  Scaled values are fixed point, in thousandths of the register's unit (mV, mA), using the
+ * scale from the device's profile, so reading one is an index lookup and an integer multiply with no float maths.
+ * They saturate at the int32_t limits; getRawValue() gives a 4 byte counter in full.
+ * The product model is decoded once and cached until a frame containing it arrives.
+ */
+
+int32_t BT2Reader::getScaledValue(int index, uint16_t registerAddress) { return (getScaledValue(index, registerAddress, 0xFF)); }
+
+/** Returns 0 if registerAddress isn't a RENOGY_VOLTS register
+ */
+int32_t BT2Reader::getMillivolts(int index, uint16_t registerAddress) { return (getScaledValue(index, registerAddress, RENOGY_VOLTS)); }
+
+/** Returns 0 if registerAddress isn't a RENOGY_AMPS register; a signed one, like RENOGY_BATTERY_CURRENT, is negative
+ * while discharging
+ */
+int32_t BT2Reader::getMilliamps(int index, uint16_t registerAddress) { return (getScaledValue(index, registerAddress, RENOGY_AMPS)); }
+
+/** One index lookup gives both the value slot and the description holding the scale and type; type 0xFF accepts any,
+ * and RENOGY_SIGNED_FLAG doesn't count, so signed and unsigned amps are both RENOGY_AMPS
+ */
+int32_t BT2Reader::getScaledValue(int index, uint16_t registerAddress, uint8_t type) {
+	if (index < 0 || index >= deviceTableSize) { return 0; }
+	DEVICE * device = &deviceTable[index];
+	drainFrames(device);
+	const REGISTER_INDEX_ENTRY * entry = getRegisterIndexEntry(device, registerAddress);
+	if (entry == NULL || entry->valueIndex == REGISTER_INDEX_NONE || entry->descriptionIndex == REGISTER_INDEX_NONE) { return 0; }
+	const REGISTER_DESCRIPTION * description = &device->profile->descriptions[entry->descriptionIndex];
+	if (type != 0xFF && getRegisterUnit(description->type) != type) { return 0; }
+	return (getSaturatedMilli(getRawValue(*description, &device->registerValues[entry->valueIndex]) * getRegisterMilliScale(*description)));
+}
+
+/** The register unscaled, in the device's profile: a 4 byte counter like RENOGY_TOTAL_GENERATION in full, where
+ * getScaledValue would saturate.  Returns 0 if the profile doesn't describe registerAddress
+ */
+int64_t BT2Reader::getRawValue(int index, uint16_t registerAddress) {
+	if (index < 0 || index >= deviceTableSize) { return 0; }
+	DEVICE * device = &deviceTable[index];
+	drainFrames(device);
+	const REGISTER_INDEX_ENTRY * entry = getRegisterIndexEntry(device, registerAddress);
+	if (entry == NULL || entry->valueIndex == REGISTER_INDEX_NONE || entry->descriptionIndex == REGISTER_INDEX_NONE) { return 0; }
+	return (getRawValue(device->profile->descriptions[entry->descriptionIndex], &device->registerValues[entry->valueIndex]));
+}
+
+/** The register as a number: sign extended for RENOGY_SIGNED and RENOGY_SIGNED_FLAG, and both registers, high word first, for a 4 byte
+ * value, which is unsigned
+ */
+int64_t BT2Reader::getRawValue(const REGISTER_DESCRIPTION & description, const uint16_t * values) {
+	if (getIsRegisterSigned(description.type)) { return (int16_t)values[0]; }
+	if (description.bytesUsed == 4) { return (((uint32_t)values[0] << 16) | values[1]); }
+	return values[0];
+}
+
+/** For the power registers (RENOGY_ALTERNATOR_POWER, RENOGY_SOLAR_POWER, RENOGY_TODAY_HIGHEST_POWER), which are
+ * reported in whole watts
+ */
+int32_t BT2Reader::getWatts(int index, uint16_t registerAddress) {
+	return (getScaledValue(index, registerAddress) / 1000);
+}
+
+float BT2Reader::getRegisterAsFloat(int index, uint16_t registerAddress) {
+	return (getScaledValue(index, registerAddress) * 0.001f);
+}
+
+/** Decodes RENOGY_AUX_BATT_TEMPERATURE: the low byte is the aux battery and the high byte the controller, each
+ * sign and magnitude.  Returns false if the register has never been read
+ */
+boolean BT2Reader::getTemperatures(int index, int8_t * auxBatteryCelsius, int8_t * controllerCelsius) {
+	if (index < 0 || index >= deviceTableSize) { return false; }
+	drainFrames(&deviceTable[index]);
+	int valueIndex = getRegisterValueIndex(&deviceTable[index], RENOGY_AUX_BATT_TEMPERATURE);
+	if (valueIndex < 0) { return false; }									// not a charge controller
+	uint16_t value = deviceTable[index].registerValues[valueIndex];
+	uint8_t lsb = value & 0xFF;
+	uint8_t msb = (value >> 8) & 0xFF;
+	*auxBatteryCelsius = (lsb & 0x80) > 0 ? -(lsb & 0x7F) : (lsb & 0x7F);
+	*controllerCelsius = (msb & 0x80) > 0 ? -(msb & 0x7F) : (msb & 0x7F);
+	return (getIsRegisterReceived(&deviceTable[index], RENOGY_AUX_BATT_TEMPERATURE));
+}
+
+/** The 16 character model string from RENOGY_PRODUCT_MODEL, trimmed; empty if it hasn't been read
+ */
+const char * BT2Reader::getProductModel(int index) {
+	if (index < 0 || index >= deviceTableSize) { return ""; }
+	DEVICE * device = &deviceTable[index];
+	drainFrames(device);
+	if (device->productModelDecoded) { return device->productModel; }
+
+	constexpr int length = registerDescription[findRegisterDescriptionIndex(RENOGY_PRODUCT_MODEL)].bytesUsed;
+	static_assert(length < sizeof(device->productModel), "productModel buffer too small");
+	int valueIndex = getRegisterValueIndex(device, RENOGY_PRODUCT_MODEL);
+	if (valueIndex < 0) { return ""; }									// the profile has no product model
+
+	int start = 0;
+	int end = 0;
+	for (int i = 0; i < length; i++) {
+		uint16_t value = device->registerValues[valueIndex + i / 2];
+		char c = (char)((i & 0x01) == 0 ? (value >> 8) & 0xFF : value & 0xFF);
+		device->productModel[i] = (c >= 32 && c < 127) ? c : ' ';
+		if (device->productModel[i] == ' ' && start == i) { start++; }
+		if (device->productModel[i] != ' ') { end = i + 1; }
+	}
+	memmove(device->productModel, &device->productModel[start], max(0, end - start));
+	device->productModel[max(0, end - start)] = 0;
+	device->productModelDecoded = true;
+	return device->productModel;
+}
@@ -0,0 +1,57 @@
+#ifndef BLUEFRUIT_NATIVE_LITTLEFS_H
+#define BLUEFRUIT_NATIVE_LITTLEFS_H
+
+/**	Host stand-in for Adafruit_LittleFS.  Files live under a directory on the PC (nativeSetRoot(), "./.internalfs"
+ * by default) so code written against InternalFS runs unchanged in the native build.
+ */
+
+#include "Arduino.h"
+
+#define FILE_O_READ		0
+#define FILE_O_WRITE	1
+
+namespace Adafruit_LittleFS_Namespace {
+
+	class Adafruit_LittleFS;
+
+	class File {
+
+	public:
+
+		File(Adafruit_LittleFS & fs) : fileSystem(&fs) {}
+		~File() { close(); }
+
+		boolean open(const char * filepath, uint8_t mode);
+		int read(void * buffer, uint16_t nbyte);
+		size_t write(const uint8_t * buffer, size_t size);
+		uint32_t size();
+		void close();
+		operator bool() { return file != NULL; }
+
+	private:
+
+		Adafruit_LittleFS * fileSystem;
+		FILE * file = NULL;
+	};
+
+
+	class Adafruit_LittleFS {
+
+	public:
+
+		boolean begin();
+		boolean exists(const char * filepath);
+		boolean mkdir(const char * filepath);
+		boolean remove(const char * filepath);
+
+		/** Native only: the directory standing in for the flash file system */
+		void nativeSetRoot(const char * directory);
+		void nativeGetPath(const char * filepath, char * path, size_t size);
+
+	private:
+
+		char root[128] = "./.internalfs";
+	};
+}
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef BLUEFRUIT_NATIVE_ARDUINO_H
+#define BLUEFRUIT_NATIVE_ARDUINO_H
+
+/**	Minimal host (Linux/macOS) stand-in for the parts of the Arduino core used by BT2Reader.
+ * Only used by the [env:native] PlatformIO environment so the library can be benchmarked
+ * without a Feather or a BT-2.  None of this is compiled for the nrf52 targets.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <algorithm>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+using std::min;
+using std::max;
+
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+
+/** Native only: offsets millis()/micros() so time dependent code can be driven from a benchmark */
+void nativeAdvanceMillis(uint32_t ms);
+
+
+class NativeSerial {
+
+public:
+
+	void begin(uint32_t baud) { (void)baud; }
+	operator bool() { return true; }
+
+	size_t write(uint8_t c);
+	size_t write(const uint8_t * buffer, size_t size);
+	size_t write(const char * buffer, size_t size) { return write((const uint8_t *)buffer, size); }
+
+	size_t print(char c) { return write((uint8_t)c); }
+	size_t print(const char * s) { return write((const uint8_t *)s, strlen(s)); }
+	size_t print(int i) { return printf("%d", i); }
+	size_t print(unsigned int i) { return printf("%u", i); }
+	size_t print(long i) { return printf("%ld", i); }
+	size_t print(unsigned long i) { return printf("%lu", i); }
+	size_t print(double d) { return printf("%.2f", d); }
+
+	size_t println() { return write((const uint8_t *)"\r\n", 2); }
+	template <typename T> size_t println(T t) { size_t n = print(t); return n + println(); }
+
+	size_t printf(const char * format, ...) __attribute__((format(printf, 2, 3)));
+	void flush() { if (output != NULL) { fflush(output); } }
+
+	/** Native only: redirect output (NULL discards it); bytesWritten and writeCalls keep counting either way */
+	void setOutput(FILE * stream) { output = stream; }
+	uint32_t bytesWritten = 0;
+	uint32_t writeCalls = 0;											// each one a separate UART transfer on the device
+
+private:
+
+	FILE * output = stdout;
+};
+
+extern NativeSerial Serial;
+
+#endif
@@ -0,0 +1,200 @@
+#include "bluefruit.h"
+#include <chrono>
+#include <thread>
+
+NativeSerial Serial;
+AdafruitBluefruit Bluefruit;
+BLEClientCharacteristic::native_write_cb_t BLEClientCharacteristic::nativeWriteHook = NULL;
+BLEClientService * BLEClientService::lastService = NULL;
+
+static const std::chrono::steady_clock::time_point NATIVE_START_TIME = std::chrono::steady_clock::now();
+static uint32_t nativeMillisOffset = 0;
+
+
+uint32_t millis() {
+	auto elapsed = std::chrono::steady_clock::now() - NATIVE_START_TIME;
+	return (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() + nativeMillisOffset;
+}
+
+uint32_t micros() {
+	auto elapsed = std::chrono::steady_clock::now() - NATIVE_START_TIME;
+	return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count() + nativeMillisOffset * 1000;
+}
+
+void delay(uint32_t ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+
+void nativeAdvanceMillis(uint32_t ms) { nativeMillisOffset += ms; }
+
+
+size_t NativeSerial::write(uint8_t c) {
+	bytesWritten++;
+	writeCalls++;
+	if (output != NULL) { fputc(c, output); }
+	return 1;
+}
+
+size_t NativeSerial::write(const uint8_t * buffer, size_t size) {
+	bytesWritten += size;
+	writeCalls++;
+	if (output != NULL) { fwrite(buffer, 1, size, output); }
+	return size;
+}
+
+size_t NativeSerial::printf(const char * format, ...) {
+	char buffer[256];
+	va_list args;
+	va_start(args, format);
+	int len = vsnprintf(buffer, sizeof(buffer), format, args);
+	va_end(args);
+	if (len < 0) { return 0; }
+	return write((const uint8_t *)buffer, min((size_t)len, sizeof(buffer) - 1));
+}
+
+
+/** Parses "0000ffd0-0000-1000-8000-00805f9b34fb" style strings, most significant byte first */
+BLEUuid::BLEUuid(const char * uuid128String) {
+	static const uint8_t BASE_UUID[16] = {0xFB,0x34,0x9B,0x5F,0x80,0x00,0x00,0x80,0x00,0x10,0x00,0x00,0x00,0x00,0x00,0x00};
+	int byteIndex = 15;
+	for (const char * c = uuid128String; *c != 0 && byteIndex >= 0; c++) {
+		if (*c == '-') { continue; }
+		char hex[3] = { c[0], c[1], 0 };
+		_uuid128[byteIndex--] = (uint8_t)strtol(hex, NULL, 16);
+		c++;
+	}
+	is128 = true;
+	if (memcmp(_uuid128, BASE_UUID, 12) == 0 && _uuid128[14] == 0 && _uuid128[15] == 0) {
+		uuid16 = _uuid128[12] + _uuid128[13] * 256;
+	}
+}
+
+BLEUuid::BLEUuid(uint16_t uuid) {
+	memset(_uuid128, 0, 16);
+	uuid16 = uuid;
+}
+
+boolean BLEUuid::operator==(const BLEUuid & other) const {
+	if (uuid16 != 0 && uuid16 == other.uuid16) { return true; }
+	return is128 && other.is128 && memcmp(_uuid128, other._uuid128, 16) == 0;
+}
+
+
+boolean BLEClientService::discover(uint16_t connectionHandle) {
+	Bluefruit.nativeRoundTrip();
+	if (!Bluefruit.nativeDiscoverySucceeds || Bluefruit.Connection(connectionHandle) == NULL) { return false; }
+	_conn_hdl = connectionHandle;
+	return true;
+}
+
+/** Simulated handles: the low byte of the 16-bit UUID, plus nativeHandleOffset, with the CCCD straight after */
+boolean BLEClientCharacteristic::discover() {
+	Bluefruit.nativeRoundTrip();
+	Bluefruit.nativeRoundTrip();
+	if (!Bluefruit.nativeDiscoverySucceeds) { return false; }
+	memset(&_chr, 0, sizeof(_chr));
+	_chr.uuid.uuid = uuid.uuid16;
+	_chr.char_props.write_wo_resp = 1;
+	_chr.char_props.notify = 1;
+	_chr.handle_value = (uuid.uuid16 & 0xFF) + Bluefruit.nativeHandleOffset;
+	_chr.handle_decl = _chr.handle_value - 1;
+	return true;
+}
+
+boolean BLEClientCharacteristic::enableNotify() {
+	Bluefruit.nativeRoundTrip();
+	return (connHandle() != BLE_CONN_HANDLE_INVALID && _chr.handle_value != 0);
+}
+
+uint16_t BLEClientCharacteristic::write(const void * data, uint16_t len) {
+	if (connHandle() == BLE_CONN_HANDLE_INVALID || _chr.handle_value == 0) { return 0; }
+	if (nativeWriteHook != NULL) { nativeWriteHook(this, (const uint8_t *)data, len); }
+	return len;
+}
+
+uint32_t sd_ble_gattc_write(uint16_t conn_handle, const ble_gattc_write_params_t * p_write_params) {
+	(void)p_write_params;
+	if (Bluefruit.Connection(conn_handle) == NULL) { return NRF_ERROR_INVALID_STATE; }
+	Bluefruit.nativeGattWrites++;
+	return NRF_SUCCESS;
+}
+
+
+boolean BLEConnection::getPeerName(char * name, uint16_t bufsize) {
+	if (bufsize == 0) { return false; }
+	strncpy(name, peerName, bufsize - 1);
+	name[bufsize - 1] = 0;
+	return true;
+}
+
+boolean BLEConnection::disconnect() { return Bluefruit.disconnect(handle); }
+
+
+uint8_t BLEScanner::parseReportByType(const ble_gap_evt_adv_report_t * report, uint8_t type, uint8_t * buffer, uint8_t bufsize) {
+	const uint8_t * data = report->data.p_data;
+	int index = 0;
+	while (index + 1 < report->data.len) {
+		uint8_t fieldLength = data[index];
+		if (fieldLength == 0 || index + 1 + fieldLength > report->data.len) { return 0; }
+		if (data[index + 1] == type) {
+			uint8_t len = min((uint8_t)(fieldLength - 1), bufsize);
+			memcpy(buffer, &data[index + 2], len);
+			return len;
+		}
+		index += fieldLength + 1;
+	}
+	return 0;
+}
+
+boolean BLEScanner::checkReportForUuid(const ble_gap_evt_adv_report_t * report, BLEUuid bleuuid) {
+	uint8_t buffer[31];
+	if (bleuuid.uuid16 != 0) {
+		const uint8_t types[2] = { BLE_GAP_AD_TYPE_16BIT_SERVICE_UUID_COMPLETE, BLE_GAP_AD_TYPE_16BIT_SERVICE_UUID_MORE_AVAILABLE };
+		for (int t = 0; t < 2; t++) {
+			int len = parseReportByType(report, types[t], buffer, sizeof(buffer));
+			for (int i = 0; i + 1 < len; i += 2) {
+				if (buffer[i] + buffer[i + 1] * 256 == bleuuid.uuid16) { return true; }
+			}
+		}
+	}
+	if (bleuuid.is128) {
+		const uint8_t types[2] = { BLE_GAP_AD_TYPE_128BIT_SERVICE_UUID_COMPLETE, BLE_GAP_AD_TYPE_128BIT_SERVICE_UUID_MORE_AVAILABLE };
+		for (int t = 0; t < 2; t++) {
+			int len = parseReportByType(report, types[t], buffer, sizeof(buffer));
+			for (int i = 0; i + 15 < len; i += 16) {
+				if (memcmp(&buffer[i], bleuuid._uuid128, 16) == 0) { return true; }
+			}
+		}
+	}
+	return false;
+}
+
+
+boolean BLECentral::connect(const ble_gap_evt_adv_report_t * report) {
+	(void)report;
+	connectRequests++;
+	return true;
+}
+
+
+BLEConnection * AdafruitBluefruit::Connection(uint16_t connectionHandle) {
+	if (connectionHandle >= BLE_MAX_CONNECTION) { return NULL; }
+	if (connections[connectionHandle].handle != connectionHandle) { return NULL; }
+	return &connections[connectionHandle];
+}
+
+boolean AdafruitBluefruit::disconnect(uint16_t connectionHandle) {
+	BLEConnection * connection = Connection(connectionHandle);
+	if (connection == NULL) { return false; }
+	connection->handle = BLE_CONN_HANDLE_INVALID;
+	return true;
+}
+
+BLEConnection * AdafruitBluefruit::nativeConnect(uint16_t connectionHandle, const uint8_t * peerAddress, const char * peerName) {
+	if (connectionHandle >= BLE_MAX_CONNECTION) { return NULL; }
+	BLEConnection * connection = &connections[connectionHandle];
+	connection->handle = connectionHandle;
+	memset(&connection->peerAddr, 0, sizeof(connection->peerAddr));
+	memcpy(connection->peerAddr.addr, peerAddress, 6);
+	strncpy(connection->peerName, peerName, sizeof(connection->peerName) - 1);
+	connection->peerName[sizeof(connection->peerName) - 1] = 0;
+	return connection;
+}
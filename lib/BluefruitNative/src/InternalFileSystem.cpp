@@ -0,0 +1,76 @@
+#include "InternalFileSystem.h"
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace Adafruit_LittleFS_Namespace;
+
+Adafruit_LittleFS InternalFS;
+
+
+boolean Adafruit_LittleFS::begin() {
+	::mkdir(root, 0755);
+	struct stat info;
+	return (stat(root, &info) == 0 && S_ISDIR(info.st_mode));
+}
+
+boolean Adafruit_LittleFS::exists(const char * filepath) {
+	char path[256];
+	nativeGetPath(filepath, path, sizeof(path));
+	struct stat info;
+	return (stat(path, &info) == 0);
+}
+
+boolean Adafruit_LittleFS::mkdir(const char * filepath) {
+	char path[256];
+	nativeGetPath(filepath, path, sizeof(path));
+	return (::mkdir(path, 0755) == 0 || exists(filepath));
+}
+
+boolean Adafruit_LittleFS::remove(const char * filepath) {
+	char path[256];
+	nativeGetPath(filepath, path, sizeof(path));
+	return (unlink(path) == 0);
+}
+
+void Adafruit_LittleFS::nativeSetRoot(const char * directory) {
+	strncpy(root, directory, sizeof(root) - 1);
+	root[sizeof(root) - 1] = 0;
+}
+
+void Adafruit_LittleFS::nativeGetPath(const char * filepath, char * path, size_t size) {
+	snprintf(path, size, "%s%s%s", root, filepath[0] == '/' ? "" : "/", filepath);
+}
+
+
+/** As LittleFS: FILE_O_WRITE creates the file or appends to it */
+boolean File::open(const char * filepath, uint8_t mode) {
+	close();
+	char path[256];
+	fileSystem->nativeGetPath(filepath, path, sizeof(path));
+	file = fopen(path, mode == FILE_O_WRITE ? "ab" : "rb");
+	return (file != NULL);
+}
+
+int File::read(void * buffer, uint16_t nbyte) {
+	if (file == NULL) { return -1; }
+	return (int)fread(buffer, 1, nbyte, file);
+}
+
+size_t File::write(const uint8_t * buffer, size_t size) {
+	if (file == NULL) { return 0; }
+	return fwrite(buffer, 1, size, file);
+}
+
+uint32_t File::size() {
+	if (file == NULL) { return 0; }
+	long position = ftell(file);
+	fseek(file, 0, SEEK_END);
+	long length = ftell(file);
+	fseek(file, position, SEEK_SET);
+	return (uint32_t)length;
+}
+
+void File::close() {
+	if (file != NULL) { fclose(file); }
+	file = NULL;
+}
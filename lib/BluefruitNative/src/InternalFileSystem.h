@@ -0,0 +1,8 @@
+#ifndef BLUEFRUIT_NATIVE_INTERNAL_FILE_SYSTEM_H
+#define BLUEFRUIT_NATIVE_INTERNAL_FILE_SYSTEM_H
+
+#include "Adafruit_LittleFS.h"
+
+extern Adafruit_LittleFS_Namespace::Adafruit_LittleFS InternalFS;
+
+#endif
@@ -0,0 +1,253 @@
+#ifndef BLUEFRUIT_NATIVE_H
+#define BLUEFRUIT_NATIVE_H
+
+/**	Minimal host stand-in for Adafruit's Bluefruit nRF52 library.  It models just enough of the
+ * Scanner / Central / client service and characteristic API for BT2Reader to compile and run on a PC.
+ * There is no radio: connections are created with Bluefruit.nativeConnect() and notifications are
+ * injected by calling BT2Reader::notifyCallback directly.  Writes to characteristics can be observed
+ * through BLEClientCharacteristic::nativeWriteHook.
+ */
+
+#include "Arduino.h"
+
+#define NRF_SUCCESS										0
+#define NRF_ERROR_INVALID_STATE							8
+#define BLE_CONN_HANDLE_INVALID							0xFFFF
+#define BLE_MAX_CONNECTION								20
+
+#define BLE_GAP_AD_TYPE_FLAGS							0x01
+#define BLE_GAP_AD_TYPE_16BIT_SERVICE_UUID_MORE_AVAILABLE	0x02
+#define BLE_GAP_AD_TYPE_16BIT_SERVICE_UUID_COMPLETE		0x03
+#define BLE_GAP_AD_TYPE_128BIT_SERVICE_UUID_MORE_AVAILABLE	0x06
+#define BLE_GAP_AD_TYPE_128BIT_SERVICE_UUID_COMPLETE	0x07
+#define BLE_GAP_AD_TYPE_SHORT_LOCAL_NAME				0x08
+#define BLE_GAP_AD_TYPE_COMPLETE_LOCAL_NAME				0x09
+#define BLE_GAP_AD_TYPE_MANUFACTURER_SPECIFIC_DATA		0xFF
+
+#define BLE_GATT_OP_WRITE_REQ							0x01
+#define BLE_GATT_OP_WRITE_CMD							0x02
+
+struct ble_gap_addr_t {
+	uint8_t addr_id_peer : 1;
+	uint8_t addr_type : 7;
+	uint8_t addr[6];
+};
+
+struct ble_data_t {
+	uint8_t * p_data;
+	uint16_t len;
+};
+
+struct ble_gap_adv_report_type_t {
+	uint16_t connectable : 1;
+	uint16_t scannable : 1;
+	uint16_t directed : 1;
+	uint16_t scan_response : 1;
+	uint16_t extended_pdu : 1;
+	uint16_t status : 2;
+	uint16_t reserved : 9;
+};
+
+struct ble_gap_evt_adv_report_t {
+	ble_gap_adv_report_type_t type;
+	ble_gap_addr_t peer_addr;
+	ble_gap_addr_t direct_addr;
+	int8_t rssi;
+	ble_data_t data;
+};
+
+struct ble_uuid_t {
+	uint16_t uuid;
+	uint8_t type;
+};
+
+struct ble_gatt_char_props_t {
+	uint8_t broadcast : 1;
+	uint8_t read : 1;
+	uint8_t write_wo_resp : 1;
+	uint8_t write : 1;
+	uint8_t notify : 1;
+	uint8_t indicate : 1;
+	uint8_t auth_signed_wr : 1;
+};
+
+struct ble_gatt_char_ext_props_t {
+	uint8_t reliable_wr : 1;
+	uint8_t wr_aux : 1;
+};
+
+struct ble_gattc_char_t {
+	ble_uuid_t uuid;
+	ble_gatt_char_props_t char_props;
+	ble_gatt_char_ext_props_t char_ext_props;
+	uint16_t handle_decl;
+	uint16_t handle_value;
+};
+
+struct ble_gattc_write_params_t {
+	uint8_t write_op;
+	uint8_t flags;
+	uint16_t handle;
+	uint16_t offset;
+	uint16_t len;
+	const uint8_t * p_value;
+};
+
+/** SoftDevice GATT client write.  Native: succeeds if the connection exists and counts the write */
+uint32_t sd_ble_gattc_write(uint16_t conn_handle, const ble_gattc_write_params_t * p_write_params);
+
+
+class BLEUuid {
+
+public:
+
+	BLEUuid(uint16_t uuid16);
+	BLEUuid(const char * uuid128String);
+	boolean operator==(const BLEUuid & other) const;
+
+	uint16_t uuid16 = 0;						// 16-bit alias, 0 if not on the Bluetooth base UUID
+	uint8_t _uuid128[16];						// little endian, as the SoftDevice stores it
+	boolean is128 = false;
+};
+
+
+class BLEClientService {
+
+public:
+
+	BLEClientService(BLEUuid bleuuid) : uuid(bleuuid) {}
+	boolean begin() { lastService = this; return true; }
+	boolean discover(uint16_t connectionHandle);
+	uint16_t connHandle() { return _conn_hdl; }
+
+	BLEUuid uuid;
+	static BLEClientService * lastService;					// what BLEClientCharacteristic::begin() attaches to
+
+protected:
+
+	uint16_t _conn_hdl = BLE_CONN_HANDLE_INVALID;
+};
+
+
+class BLEClientCharacteristic {
+
+public:
+
+	typedef void (*notify_cb_t)(BLEClientCharacteristic * chr, uint8_t * data, uint16_t len);
+	typedef void (*native_write_cb_t)(BLEClientCharacteristic * chr, const uint8_t * data, uint16_t len);
+
+	BLEClientCharacteristic(BLEUuid bleuuid) : uuid(bleuuid) { memset(&_chr, 0, sizeof(_chr)); }
+	void begin(BLEClientService * parentService = NULL) { _service = parentService != NULL ? parentService : BLEClientService::lastService; }
+	boolean discover();
+	boolean enableNotify();
+	void setNotifyCallback(notify_cb_t fp, boolean useAdaCallback = true) { (void)useAdaCallback; notifyCallback = fp; }
+	uint16_t write(const void * data, uint16_t len);
+	uint16_t connHandle() { return _service != NULL ? _service->connHandle() : BLE_CONN_HANDLE_INVALID; }
+	uint16_t valueHandle() { return _chr.handle_value; }
+	uint8_t properties() { uint8_t props; memcpy(&props, &_chr.char_props, 1); return props; }
+	void _assign(ble_gattc_char_t * gattc_chr) { _chr = *gattc_chr; }
+
+	BLEUuid uuid;
+	notify_cb_t notifyCallback = NULL;
+
+	/** Native only: called for every write, e.g. to capture read commands sent to the BT2 */
+	static native_write_cb_t nativeWriteHook;
+
+private:
+
+	ble_gattc_char_t _chr;
+	BLEClientService * _service = NULL;
+};
+
+
+class BLEConnection {
+
+public:
+
+	ble_gap_addr_t getPeerAddr() { return peerAddr; }
+	boolean getPeerName(char * name, uint16_t bufsize);
+	boolean disconnect();
+	boolean connected() { return handle != BLE_CONN_HANDLE_INVALID; }
+
+	uint16_t handle = BLE_CONN_HANDLE_INVALID;
+	ble_gap_addr_t peerAddr;
+	char peerName[32];
+};
+
+
+class BLEScanner {
+
+public:
+
+	typedef void (*rx_callback_t)(ble_gap_evt_adv_report_t * report);
+
+	void setRxCallback(rx_callback_t fp) { rxCallback = fp; }
+	void restartOnDisconnect(boolean enable) { (void)enable; }
+	void setInterval(uint16_t interval, uint16_t window) { (void)interval; (void)window; }
+	void useActiveScan(boolean enable) { (void)enable; }
+	boolean start(uint16_t timeout = 0) { (void)timeout; return true; }
+	boolean stop() { return true; }
+	void resume() {}
+
+	uint8_t parseReportByType(const ble_gap_evt_adv_report_t * report, uint8_t type, uint8_t * buffer, uint8_t bufsize = 31);
+	boolean checkReportForUuid(const ble_gap_evt_adv_report_t * report, BLEUuid bleuuid);
+	boolean checkReportForService(const ble_gap_evt_adv_report_t * report, BLEClientService & service) { return checkReportForUuid(report, service.uuid); }
+
+	rx_callback_t rxCallback = NULL;
+};
+
+
+class BLECentral {
+
+public:
+
+	typedef void (*connect_callback_t)(uint16_t connectionHandle);
+	typedef void (*disconnect_callback_t)(uint16_t connectionHandle, uint8_t reason);
+
+	void setConnectCallback(connect_callback_t fp) { connectCallback = fp; }
+	void setDisconnectCallback(disconnect_callback_t fp) { disconnectCallback = fp; }
+	boolean connect(const ble_gap_evt_adv_report_t * report);
+
+	connect_callback_t connectCallback = NULL;
+	disconnect_callback_t disconnectCallback = NULL;
+	uint32_t connectRequests = 0;				// native only: number of connect() calls made
+};
+
+
+class AdafruitBluefruit {
+
+public:
+
+	boolean begin(uint8_t prphCount = 1, uint8_t centralCount = 0) { (void)prphCount; (void)centralCount; return true; }
+	void setName(const char * name) { (void)name; }
+	void setConnLedInterval(uint32_t ms) { (void)ms; }
+	BLEConnection * Connection(uint16_t connectionHandle);
+	boolean disconnect(uint16_t connectionHandle);
+
+	/** Native only: creates a connection to a simulated peer; the caller then runs its connectCallback */
+	BLEConnection * nativeConnect(uint16_t connectionHandle, const uint8_t * peerAddress, const char * peerName);
+
+	/** Native only: when false, discover() fails for every service and characteristic */
+	boolean nativeDiscoverySucceeds = true;
+
+	/** Native only: millis() advanced per GATT round trip, to model discovery cost on a real link.  Service
+	 * discovery is one round trip, characteristic discovery two (characteristic and CCCD), enableNotify one */
+	uint32_t nativeRoundTripMillis = 0;
+	uint32_t nativeRoundTrips = 0;
+
+	/** Native only: added to every attribute handle discovery reports, to model a peer whose GATT table changed */
+	uint16_t nativeHandleOffset = 0;
+	uint32_t nativeGattWrites = 0;
+	void nativeRoundTrip() { nativeRoundTrips++; nativeAdvanceMillis(nativeRoundTripMillis); }
+
+	BLEScanner Scanner;
+	BLECentral Central;
+
+private:
+
+	BLEConnection connections[BLE_MAX_CONNECTION];
+};
+
+extern AdafruitBluefruit Bluefruit;
+
+#endif
@@ -18,7 +18,9 @@
 const char RENOGY_DEVICE_NAME[] = "BT-TH-EA75B18F";
 uint16_t myConnectionHandle = BLE_CONN_HANDLE_INVALID;
 BT2Reader bt2Reader;
+BT2ReadPlan readPlan;
 int ticker = 0;
+uint32_t lastRefreshMillis = 0;
 
 
 void setup() {
@@ -33,6 +35,10 @@ void setup() {
 	//bt2Reader.addTargetBT2Device((char *)(RENOGY_DEVICE_NAME));
 	bt2Reader.setLoggingLevel(BT2READER_ERRORS_ONLY);
 	bt2Reader.begin();
+
+	readPlan.addRegisterMap();									// or addRegisters(startRegister, numberOfRegisters) for just the ones you need
+	readPlan.build();
+	Serial.printf("Read plan needs %d commands for a full refresh\n", readPlan.getCommandCount());
 	
 
 	Bluefruit.setConnLedInterval(250);
@@ -96,47 +102,41 @@ void disconnectCallback(uint16_t connectionHandle, uint8_t reason) {
 	// other disconnection callback code here
 }
 
+/** Runs in loop() context from bt2Reader.service() once a queued read completes, fails or times out
+ */
+void readCompleteCallback(int deviceIndex, const BT2_REQUEST * request) {
+	if (request->status != BT2_REQUEST_COMPLETE) {
+		Serial.printf("Read of registers 0x%04X - 0x%04X failed, status %d\n", 
+			request->startRegister, request->startRegister + request->numberOfRegisters - 1, request->status);
+		return;
+	}
+	Serial.printf("Received response for %d registers 0x%04X - 0x%04X in %dms: ", 
+			request->numberOfRegisters,
+			request->startRegister,
+			request->startRegister + request->numberOfRegisters - 1,
+			(millis() - request->sentMillis)
+	);
+	bt2Reader.printHex(bt2Reader.getDevice(deviceIndex)->dataReceived, bt2Reader.getDevice(deviceIndex)->dataReceivedLength, false);
+
+	for (int i = 0; i < request->numberOfRegisters; i++) {
+		bt2Reader.printRegister(myConnectionHandle, request->startRegister + i);
+	}
+}
+
 void loop() {
-	
-	Serial.printf("Tick %03d: \n",ticker);
 
-	if (myConnectionHandle != BLE_CONN_HANDLE_INVALID) {
-	
-		int commandSequenceToSend = (ticker % 8);	
-		uint16_t startRegister = bt2Commands[commandSequenceToSend].startRegister;
-		uint16_t numberOfRegisters = bt2Commands[commandSequenceToSend].numberOfRegisters;
-		uint32_t sendReadCommandTime = millis();
-		bt2Reader.sendReadCommand(myConnectionHandle, startRegister, numberOfRegisters);
-
-		while (!bt2Reader.getIsNewDataAvailable(myConnectionHandle) && (millis() - sendReadCommandTime < 5000)) {
-			delay(2);
-		}
+	bt2Reader.service();										// sends queued reads and runs callbacks; never blocks
 
-		if (millis() - sendReadCommandTime >= 5000) {
-			Serial.println("Timeout error; did not receive response from BT2 within 5 seconds");
-		} else {
-			Serial.printf("Received response for %d registers 0x%04X - 0x%04X in %dms: ", 
-					numberOfRegisters,
-					startRegister,
-					startRegister + numberOfRegisters - 1,
-					(millis() - sendReadCommandTime)
-			);
-			bt2Reader.printHex(bt2Reader.getDevice(myConnectionHandle)->dataReceived, bt2Reader.getDevice(myConnectionHandle)->dataReceivedLength, false);
-
-			
-			for (int i = 0; i < numberOfRegisters; i++) {
-				Serial.printf("Register 0x%04X contains %d\n",
-					startRegister + i,
-					bt2Reader.getRegister(myConnectionHandle, startRegister + i)->value
-				);
-			}
-
-			for (int i = 0; i < numberOfRegisters; i++) {
-				bt2Reader.printRegister(myConnectionHandle, startRegister + i);
-			}
+	if (myConnectionHandle != BLE_CONN_HANDLE_INVALID && millis() - lastRefreshMillis >= 5000
+			&& bt2Reader.getQueuedRequestCount(bt2Reader.getDeviceIndex(myConnectionHandle)) == 0) {
+		Serial.printf("Tick %03d: \n",ticker++);
+		for (int i = 0; i < readPlan.getCommandCount(); i++) {
+			const RENOGY_COMMANDS * command = readPlan.getCommand(i);
+			bt2Reader.queueReadCommand(myConnectionHandle, command->startRegister, command->numberOfRegisters, readCompleteCallback);
 		}
-		ticker++;
+		lastRefreshMillis = millis();
+		if (ticker % 12 == 0) { bt2Reader.printStats(bt2Reader.getDeviceIndex(myConnectionHandle)); }	// once a minute
 	}
-	
-	delay(5000);
+
+	// the rest of loop() is free for other work
 }
\ No newline at end of file